@@ -0,0 +1,70 @@
+/*
+ * LTO.h 2025
+ *
+ * link time optimization of avsi bitcode
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CART_LTO_H
+#define CART_LTO_H
+
+#include <string>
+#include <vector>
+
+namespace cart {
+    using std::string;
+    using std::vector;
+
+    enum LTOMode {
+        LTO_NONE,
+        // link all modules into one and optimize it
+        LTO_FULL,
+        // optimize modules in parallel, importing functions by summaries
+        LTO_THIN
+    };
+
+    struct LTOConfig {
+        // -O<opt_level>, -Os sets size_level 1 and -Oz sets 2
+        int opt_level = 0;
+        int size_level = 0;
+        bool pic = false;
+        // symbols not in the list get internal linkage, no internalizing if empty
+        vector<string> preserve;
+    };
+
+    bool lto_parse_mode(const string &mode, LTOMode &lto);
+
+    void lto_parse_flag(const string &flag, LTOConfig &config);
+
+    void lto_compile(const vector<string> &bitcodes, const string &output, const LTOConfig &config);
+
+    void thinlto_compile(
+            const vector<string> &bitcodes,
+            const string &output_prefix,
+            const string &cache_dir,
+            const LTOConfig &config,
+            vector<string> &objs);
+}
+
+#endif //CART_LTO_H
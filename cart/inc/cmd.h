@@ -28,6 +28,7 @@
 #define AVSI2_CMD_H
 
 #include "Gnu.h"
+#include "LTO.h"
 #include "../inc/tomlcpp.hpp"
 
 extern bool opt_help;
@@ -39,7 +40,9 @@ namespace cart {
             string name,
             toml::Array *ccflags,
             toml::Array *ldflags,
-            bool nostd);
+            bool nostd,
+            LTOMode lto,
+            vector<string> extra_flags = {});
 
     void build_bin(
             shared_ptr<toml::Table> table,
@@ -44,7 +44,9 @@ static const char *template_lib_bin =
         R"(entry = "main.sl")" "\n"
         R"(ccflags = ["-O", "-W"])" "\n"
         R"(ldflags = ["-lm"])" "\n"
-        R"(nostd = false)" "\n";
+        R"(nostd = false)" "\n"
+        R"(lto = false)" "\n"
+        R"(pgo_args = [])" "\n";
 
 /**
  * template_lib_bin_removed
@@ -56,7 +58,9 @@ static const char *template_lib_bin_removed =
         R"(#entry = "main.sl")" "\n"
         R"(#ccflags = ["-O", "-W"])" "\n"
         R"(#ldflags = ["-lm"])" "\n"
-        R"(#nostd = false)" "\n";
+        R"(#nostd = false)" "\n"
+        R"(#lto = false)" "\n"
+        R"(#pgo_args = [])" "\n";
 
 /**
  * template_lib
@@ -72,7 +76,8 @@ static const char *template_lib_lib =
         R"(############################################################)" "\n"
         R"(name = "%s")" "\n"
         R"(ccflags = ["-O", "-W"])" "\n"
-        R"(nostd = false)" "\n";
+        R"(nostd = false)" "\n"
+        R"(lto = false)" "\n";
 
 /**
  * template_lib_lib_removed
@@ -88,7 +93,8 @@ static const char *template_lib_lib_removed =
         R"(#############################################################)" "\n"
         R"(#name = "%s")" "\n"
         R"(#ccflags = ["-O", "-W"])" "\n"
-        R"(#nostd = false)" "\n";
+        R"(#nostd = false)" "\n"
+        R"(#lto = false)" "\n";
 
 /*******************************************************
  *                     main.sl                         *
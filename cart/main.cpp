@@ -59,6 +59,8 @@ static struct option long_options[] = {
         {"lib", no_argument, NULL, 100},
         {"bin", no_argument, NULL, 110},
         {"bins", no_argument, NULL, 120},
+        {"lto", optional_argument, NULL, 130},
+        {"pgo", no_argument, NULL, 140},
         {0, 0, 0,                      0}
 };
 
@@ -67,6 +69,8 @@ bool opt_verbose = false;
 bool opt_lib = false;
 bool opt_bin = false;
 bool opt_bins = false;
+cart::LTOMode opt_lto = cart::LTO_NONE;
+bool opt_pgo = false;
 
 void printHelp(void) {
     string version = "cart " "0.0.1";
@@ -106,6 +110,16 @@ void getOption(int argc, char **argv) {
             case 120:
                 opt_bins = true;
                 break;
+            case 130:
+                opt_lto = cart::LTO_FULL;
+                if (optarg && !cart::lto_parse_mode(optarg, opt_lto)) {
+                    cout << "cart: unknown lto mode: " << optarg << endl;
+                    exit(-1);
+                }
+                break;
+            case 140:
+                opt_pgo = true;
+                break;
             default:
                 printf("error: unsupported option");
                 break;
@@ -0,0 +1,338 @@
+/*
+ * LTO.cpp 2025
+ *
+ * link time optimization of avsi bitcode
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../inc/LTO.h"
+
+#include <iostream>
+#include <mutex>
+#include <set>
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+
+#if (LLVM_VERSION_MAJOR >= 14)
+
+#include "llvm/MC/TargetRegistry.h"
+
+#else
+#include "llvm/Support/TargetRegistry.h"
+#endif
+
+extern bool opt_verbose;
+
+namespace cart {
+    using namespace llvm;
+    using namespace std;
+
+    /**
+     * @description:    parse mode of --lto=<mode> or lto = "<mode>"
+     * @param:          mode: full or thin
+     * @param:          lto: parsed mode
+     * @return:         false if mode is unknown
+     */
+    bool lto_parse_mode(const string &mode, LTOMode &lto) {
+        if (mode == "full") lto = LTO_FULL;
+        else if (mode == "thin") lto = LTO_THIN;
+        else return false;
+        return true;
+    }
+
+    /**
+     * @description:    read optimization flags passed to avsi, the link time
+     *                  optimizer runs at the same level
+     * @param:          flag: one of ccflags
+     * @param:          config: lto config to update
+     * @return:         none
+     */
+    void lto_parse_flag(const string &flag, LTOConfig &config) {
+        string level;
+        if (flag.rfind("-O", 0) == 0) {
+            level = flag.substr(2);
+        } else if (flag.rfind("--optimize", 0) == 0) {
+            level = flag.size() > 11 ? flag.substr(11) : "";
+        } else {
+            if (flag == "-fpic") config.pic = true;
+            return;
+        }
+
+        if (level.empty()) {
+            config.opt_level = 2;
+            config.size_level = 0;
+        } else if (level == "s" || level == "z") {
+            config.opt_level = 2;
+            config.size_level = level == "s" ? 1 : 2;
+        } else if (level.size() == 1 && level[0] >= '0' && level[0] <= '3') {
+            config.opt_level = level[0] - '0';
+            config.size_level = 0;
+        }
+    }
+
+    static TargetMachine *lto_machine_init(const LTOConfig &config) {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser();
+
+        auto TargetTriple = sys::getDefaultTargetTriple();
+        string Error;
+        auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
+        if (!Target) {
+            cout << "cart: " << Error << endl;
+            exit(-1);
+        }
+
+        TargetOptions opt;
+        auto RM = Optional<Reloc::Model>(config.pic ? Reloc::PIC_ : Reloc::Static);
+        auto OL = CodeGenOpt::Default;
+        if (config.opt_level == 0) OL = CodeGenOpt::None;
+        else if (config.opt_level == 1) OL = CodeGenOpt::Less;
+        else if (config.opt_level == 3) OL = CodeGenOpt::Aggressive;
+        return Target->createTargetMachine(TargetTriple, "generic", "", opt, RM, None, OL);
+    }
+
+    /**
+     * @description:    link bitcode of all modules into one module, run the
+     *                  link time optimization pipeline and emit one object
+     * @param:          bitcodes: .bc files emitted by avsi --lto
+     * @param:          output: object file
+     * @param:          config: optimization level and symbols to export
+     * @return:         none
+     */
+    void lto_compile(const vector<string> &bitcodes, const string &output, const LTOConfig &config) {
+        LLVMContext context;
+        auto merged = make_unique<Module>("ld-temp.o", context);
+        Linker linker(*merged);
+
+        for (auto &file: bitcodes) {
+            if (opt_verbose) cout << "lto: link " << file << endl;
+
+            SMDiagnostic err;
+            auto mod = parseIRFile(file, err, context);
+            if (!mod) {
+                cout << "cart: failed to load " << file << ": " << err.getMessage().str() << endl;
+                exit(-1);
+            }
+            if (linker.linkInModule(std::move(mod))) {
+                cout << "cart: failed to link " << file << endl;
+                exit(-1);
+            }
+        }
+
+        auto TM = unique_ptr<TargetMachine>(lto_machine_init(config));
+        merged->setTargetTriple(TM->getTargetTriple().str());
+        merged->setDataLayout(TM->createDataLayout());
+
+        // only entry and exported symbols are visible to the system linker,
+        // everything else may be inlined into its callers and dropped
+        if (!config.preserve.empty()) {
+            set<string> preserve(config.preserve.begin(), config.preserve.end());
+            internalizeModule(*merged, [&](const GlobalValue &gv) {
+                return preserve.count(gv.getName().str()) != 0;
+            });
+        }
+
+        OptimizationLevel level = OptimizationLevel::O0;
+        if (config.size_level == 1) level = OptimizationLevel::Os;
+        else if (config.size_level == 2) level = OptimizationLevel::Oz;
+        else if (config.opt_level == 1) level = OptimizationLevel::O1;
+        else if (config.opt_level == 2) level = OptimizationLevel::O2;
+        else if (config.opt_level == 3) level = OptimizationLevel::O3;
+
+        PipelineTuningOptions PTO;
+        PTO.LoopUnrolling = level.getSpeedupLevel() > 1;
+        PTO.LoopInterleaving = level.getSpeedupLevel() > 1;
+        PTO.LoopVectorization = level.getSpeedupLevel() > 1 && level.getSizeLevel() < 2;
+        PTO.SLPVectorization = level.getSpeedupLevel() > 1 && level.getSizeLevel() < 2;
+
+        LoopAnalysisManager LAM;
+        FunctionAnalysisManager FAM;
+        CGSCCAnalysisManager CGAM;
+        ModuleAnalysisManager MAM;
+
+        PassBuilder PB(TM.get(), PTO);
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        ModulePassManager MPM = level == OptimizationLevel::O0
+                                ? PB.buildO0DefaultPipeline(level)
+                                : PB.buildLTODefaultPipeline(level, nullptr);
+        MPM.run(*merged, MAM);
+
+        std::error_code EC;
+        raw_fd_ostream dest(output, EC, sys::fs::OF_None);
+        if (EC) {
+            cout << "cart: could not open file " << output << ": " << EC.message() << endl;
+            exit(-1);
+        }
+
+        legacy::PassManager pass;
+        if (TM->addPassesToEmitFile(pass, dest, nullptr, CGFT_ObjectFile)) {
+            cout << "cart: target machine can't emit object file" << endl;
+            exit(-1);
+        }
+        pass.run(*merged);
+        dest.flush();
+    }
+
+    /**
+     * @description:    ThinLTO. modules are optimized and compiled in parallel,
+     *                  functions are imported across modules by the summaries
+     *                  in bitcode. modules without summary, e.g. std built
+     *                  without --lto=thin, are merged and optimized as full lto
+     * @param:          bitcodes: .bc files emitted by avsi --lto=thin
+     * @param:          output_prefix: object of task i is <prefix>.lto.<i>.o
+     * @param:          cache_dir: backend outputs keyed by module hash, import
+     *                  list and options. unchanged modules skip the backend
+     * @param:          config: optimization level and symbols to export
+     * @param:          objs: objects to link
+     * @return:         none
+     */
+    void thinlto_compile(
+            const vector<string> &bitcodes,
+            const string &output_prefix,
+            const string &cache_dir,
+            const LTOConfig &config,
+            vector<string> &objs) {
+        auto TM = unique_ptr<TargetMachine>(lto_machine_init(config));
+
+        lto::Config conf;
+        conf.CPU = "generic";
+        conf.RelocModel = config.pic ? Reloc::PIC_ : Reloc::Static;
+        conf.CGOptLevel = TM->getOptLevel();
+        conf.OptLevel = config.opt_level;
+        conf.PTO.LoopUnrolling = config.opt_level > 1;
+        conf.PTO.LoopInterleaving = config.opt_level > 1;
+        conf.PTO.LoopVectorization = config.opt_level > 1 && config.size_level < 2;
+        conf.PTO.SLPVectorization = config.opt_level > 1 && config.size_level < 2;
+        conf.DefaultTriple = TM->getTargetTriple().str();
+
+        lto::LTO lto(std::move(conf), lto::createInProcessThinBackend(heavyweight_hardware_concurrency()));
+
+        // buffers are referenced by input files until lto finishes
+        vector<unique_ptr<MemoryBuffer>> buffers;
+        set<string> preserve(config.preserve.begin(), config.preserve.end());
+        set<string> defined;
+
+        for (auto &file: bitcodes) {
+            if (opt_verbose) cout << "thinlto: add " << file << endl;
+
+            auto mbuf = MemoryBuffer::getFile(file);
+            if (!mbuf) {
+                cout << "cart: failed to load " << file << ": " << mbuf.getError().message() << endl;
+                exit(-1);
+            }
+            buffers.push_back(std::move(*mbuf));
+
+            auto input = lto::InputFile::create(buffers.back()->getMemBufferRef());
+            if (!input) {
+                cout << "cart: failed to load " << file << ": " << toString(input.takeError()) << endl;
+                exit(-1);
+            }
+
+            vector<lto::SymbolResolution> resolutions;
+            for (auto &sym: (*input)->symbols()) {
+                lto::SymbolResolution r;
+                if (!sym.isUndefined()) {
+                    string name = sym.getName().str();
+                    r.Prevailing = defined.insert(name).second;
+                    r.FinalDefinitionInLinkageUnit = r.Prevailing && !config.pic;
+                    r.VisibleToRegularObj = preserve.empty() || preserve.count(name) != 0;
+                }
+                resolutions.push_back(r);
+            }
+
+            if (auto err = lto.add(std::move(*input), resolutions)) {
+                cout << "cart: failed to add " << file << ": " << toString(std::move(err)) << endl;
+                exit(-1);
+            }
+        }
+
+        vector<string> outputs(lto.getMaxTasks());
+        std::mutex outputs_lock;
+        auto object_file = [&](unsigned task) {
+            return output_prefix + ".lto." + to_string(task) + ".o";
+        };
+
+        auto add_stream = [&](size_t task) -> Expected<unique_ptr<CachedFileStream>> {
+            std::error_code EC;
+            auto dest = make_unique<raw_fd_ostream>(object_file(task), EC, sys::fs::OF_None);
+            if (EC) return errorCodeToError(EC);
+            {
+                std::lock_guard<std::mutex> guard(outputs_lock);
+                outputs[task] = object_file(task);
+            }
+            return make_unique<CachedFileStream>(std::move(dest));
+        };
+
+        // a cache hit gives the object stored by an earlier build
+        auto add_buffer = [&](size_t task, unique_ptr<MemoryBuffer> mbuf) {
+            std::error_code EC;
+            raw_fd_ostream dest(object_file(task), EC, sys::fs::OF_None);
+            if (EC) return;
+            dest << mbuf->getBuffer();
+            std::lock_guard<std::mutex> guard(outputs_lock);
+            outputs[task] = object_file(task);
+        };
+
+        auto cache = localCache("ThinLTO", "thinlto", cache_dir, add_buffer);
+        if (!cache) {
+            cout << "cart: failed to open cache " << cache_dir << ": " << toString(cache.takeError()) << endl;
+            exit(-1);
+        }
+
+        if (auto err = lto.run(add_stream, *cache)) {
+            cout << "cart: link time optimization failed: " << toString(std::move(err)) << endl;
+            exit(-1);
+        }
+
+        auto policy = parseCachePruningPolicy("");
+        if (policy) pruneCache(cache_dir, *policy);
+        else consumeError(policy.takeError());
+
+        for (auto &i: outputs) {
+            if (!i.empty()) objs.push_back(i);
+        }
+    }
+}
@@ -51,6 +51,8 @@ extern bool opt_verbose;
 extern bool opt_lib;
 extern bool opt_bin;
 extern bool opt_bins;
+extern cart::LTOMode opt_lto;
+extern bool opt_pgo;
 
 const static char *help_new =
         R"(cart new)"
@@ -100,6 +102,14 @@ const static char *help_build =
         R"(            --bin <name>...  Build only the specified binary)"
         "\n"
         R"(            --bins           Build all binaries)"
+        "\n"
+        R"(            --lto[=<mode>]   Link time optimize all modules and std,)"
+        "\n"
+        R"(                             mode is full (default) or thin)"
+        "\n"
+        R"(            --pgo            Build binaries with profile guided optimization:)"
+        "\n"
+        R"(                             build instrumented, run with pgo_args and rebuild)"
         "\n";
 
 const static char *help_clean =
@@ -126,7 +136,7 @@ namespace cart {
     vector<string> INCLUDE_PATH;
     vector<string> LIBRARY_PATH;
 
-    void searchObjs(vector<string> &objs) {
+    void searchObjs(vector<string> &objs, char const *ext = ".o") {
         filesystem::path current_dir = filesystem::current_path();
         filesystem::path build_path = current_dir.string() + SYSTEM_PATH_DIVIDER + "build";
 
@@ -141,7 +151,8 @@ namespace cart {
                     searchq.push(p);
                 } else {
                     StringRef base = basename(p.c_str());
-                    if (base.endswith(".o")) {
+                    // objects of link time optimization are used only in lto build
+                    if (base.endswith(ext) && !base.contains(".lto.")) {
                         objs.push_back(p.c_str());
                     }
                 }
@@ -149,18 +160,113 @@ namespace cart {
         }
     }
 
+    /**
+     * @description:    search bitcode of std in include paths, the first
+     *                  std found is used, as avsi does
+     * @param:          bitcodes: list to append to
+     * @return:         none
+     */
+    void searchStdBitcodes(vector<string> &bitcodes) {
+        vector<string> paths = INCLUDE_PATH;
+        paths.emplace_back("/usr/include/avsi");
+
+        for (auto &i: paths) {
+            filesystem::path std_path = i + SYSTEM_PATH_DIVIDER + "std";
+            if (!filesystem::is_directory(std_path)) continue;
+
+            for (auto &content: filesystem::recursive_directory_iterator(std_path)) {
+                if (StringRef(content.path().c_str()).endswith(".bc")) {
+                    bitcodes.push_back(content.path().string());
+                }
+            }
+            return;
+        }
+        cout << __COLOR_YELLOW "cart: bitcode of std not found, std is linked without lto" __COLOR_RESET << endl;
+    }
+
+    /**
+     * @description:    get lto mode of a target, --lto overrides Cart.toml
+     * @param:          table: [[lib.bin]] or [lib.lib]
+     * @return:         lto mode
+     */
+    LTOMode getLTOMode(const toml::Table &table) {
+        if (opt_lto != LTO_NONE) return opt_lto;
+
+        auto lto_bool = table.getBool("lto");
+        if (lto_bool.first) return lto_bool.second ? LTO_FULL : LTO_NONE;
+
+        LTOMode lto = LTO_NONE;
+        auto lto_mode = table.getString("lto");
+        if (lto_mode.first && !lto_parse_mode(lto_mode.second, lto)) {
+            cout << "cart: unknown lto mode: " << lto_mode.second << endl;
+            exit(-1);
+        }
+        return lto;
+    }
+
+    /**
+     * @description:    link bitcode emitted by avsi --lto into objects
+     * @param:          output_prefix: objects are named <prefix>.lto[.<task>].o
+     * @param:          ccflags: flags passed to avsi, to get optimization level
+     * @param:          with_std: link bitcode of std too
+     * @param:          preserve: exported symbols, others are internalized
+     * @param:          lto: full lto makes one object, thin lto one per module
+     * @param:          objs: objects to link
+     * @return:         none
+     */
+    void link_bitcodes(
+            string output_prefix,
+            toml::Array *ccflags,
+            bool with_std,
+            vector<string> preserve,
+            LTOMode lto,
+            vector<string> &objs) {
+        vector<string> bitcodes;
+        searchObjs(bitcodes, ".bc");
+        if (with_std) searchStdBitcodes(bitcodes);
+
+        LTOConfig config;
+        if (ccflags) {
+            for (int i = 0;; i++) {
+                auto flag = ccflags->getString(i);
+                if (!flag.first)
+                    break;
+                lto_parse_flag(flag.second, config);
+            }
+        }
+        config.preserve = preserve;
+
+        cout << __COLOR_GREEN "link time optimization" __COLOR_RESET << endl;
+        if (lto == LTO_THIN) {
+            string cache_dir = "build" SYSTEM_PATH_DIVIDER ".thinlto-cache";
+            thinlto_compile(bitcodes, output_prefix, cache_dir, config, objs);
+        } else {
+            lto_compile(bitcodes, output_prefix + ".lto.o", config);
+            objs.push_back(output_prefix + ".lto.o");
+        }
+    }
+
     void build_objs(
             string entry_file,
             string name,
             toml::Array *ccflags,
             toml::Array *ldflags,
-            bool nostd) {
+            bool nostd,
+            LTOMode lto,
+            vector<string> extra_flags) {
         vector<string> avsiargs = {
                 "avsi",
                 entry_file,
                 "--package-name",
                 name};
 
+        for (auto &i: extra_flags) {
+            avsiargs.push_back(i);
+        }
+
+        if (lto == LTO_FULL) avsiargs.push_back("--lto");
+        else if (lto == LTO_THIN) avsiargs.push_back("--lto=thin");
+
         for (auto i: INCLUDE_PATH) {
             avsiargs.push_back("-I");
             avsiargs.push_back(i);
@@ -214,6 +320,61 @@ namespace cart {
         }
     }
 
+    /**
+     * @description:    run an instrumented binary to collect profile
+     * @param:          name: binary name
+     * @param:          pgo_args: arguments of training run
+     * @param:          profile: profile file to write
+     * @return:         none
+     */
+    void run_training(string name, toml::Array *pgo_args, string profile) {
+        vector<string> runargs = {"build" SYSTEM_PATH_DIVIDER + name};
+        if (pgo_args) {
+            for (int i = 0;; i++) {
+                auto arg = pgo_args->getString(i);
+                if (!arg.first)
+                    break;
+                runargs.push_back(arg.second);
+            }
+        }
+
+        auto training = fork();
+        int status = 0;
+        if (training == -1) {
+            cout << "cart: failed to run " << name << endl;
+            exit(-1);
+        } else if (training > 0) {
+            int stat = wait(&status);
+            if (stat == -1) {
+                cout << "cart: failed to run " << name << endl;
+                exit(-1);
+            }
+            if (!filesystem::exists(profile)) {
+                cout << "cart: training run of " << name << " wrote no profile. code: " << status << endl;
+                exit(-1);
+            }
+        } else {
+            cout << __COLOR_GREEN "run training" __COLOR_RESET << endl;
+
+            vector<char const *> args;
+            for (auto &i: runargs) {
+                args.push_back(i.c_str());
+            }
+
+            if (opt_verbose) {
+                for (auto i: args) {
+                    cout << i << " ";
+                }
+                cout << endl;
+            }
+
+            args.push_back((char const *) 0);
+            setenv("AVSI_PROFILE_FILE", profile.c_str(), 1);
+            execv(args[0], (char *const *) args.data());
+            exit(-1);
+        }
+    }
+
     void exec_new(int argc, char **argv, int ind) {
         filesystem::path current_dir = filesystem::current_path();
 
@@ -482,14 +643,20 @@ namespace cart {
 
         auto link = [&](
                 string name,
+                toml::Array *ccflags,
                 toml::Array *ldflags,
-                bool nostd) -> void {
+                bool nostd,
+                LTOMode lto) -> void {
             vector<string> ldargs;
             vector<string> ldf;
             vector<string> libpaths;
             vector<string> objs;
 
-            searchObjs(objs);
+            if (lto != LTO_NONE) {
+                link_bitcodes("build" SYSTEM_PATH_DIVIDER + name, ccflags, !nostd, {"main"}, lto, objs);
+            } else {
+                searchObjs(objs);
+            }
 
             for (auto i: LIBRARY_PATH) {
                 libpaths.push_back(i);
@@ -573,18 +740,32 @@ namespace cart {
                 cout << "cart: missing name at [[lib.bin]]" << endl;
                 exit(-1);
             }
+            auto lto = getLTOMode(table_bin);
+
             auto ccflags = table_bin.getArray("ccflags").release();
             auto ldflags = table_bin.getArray("ldflags").release();
+            auto pgo_args = table_bin.getArray("pgo_args").release();
 
-            if (argc != -1) {
-                if (targets.find(name.second) != targets.end()) {
-                    build_objs(entry.second, name.second, ccflags, ldflags, nostd.second);
-                    link(name.second, ldflags, nostd.second);
-                }
-            } else {
-                build_objs(entry.second, name.second, ccflags, ldflags, nostd.second);
-                link(name.second, ldflags, nostd.second);
+            if (argc != -1 && targets.find(name.second) == targets.end()) continue;
+
+            if (!opt_pgo) {
+                build_objs(entry.second, name.second, ccflags, ldflags, nostd.second, lto);
+                link(name.second, ccflags, ldflags, nostd.second, lto);
+                continue;
             }
+
+            // instrumented build, training run, then build with the profile
+            string profile = filesystem::absolute(
+                    "build" SYSTEM_PATH_DIVIDER + name.second + ".avsiprof").string();
+            filesystem::remove(profile);
+
+            build_objs(entry.second, name.second, ccflags, ldflags, nostd.second, lto,
+                       {"-fprofile-generate=" + profile});
+            link(name.second, ccflags, ldflags, nostd.second, lto);
+            run_training(name.second, pgo_args, profile);
+            build_objs(entry.second, name.second, ccflags, ldflags, nostd.second, lto,
+                       {"-fprofile-use=" + profile});
+            link(name.second, ccflags, ldflags, nostd.second, lto);
         }
     }
 
@@ -601,18 +782,24 @@ namespace cart {
         if (!nostd.first) {
             nostd.second = false;
         }
+        auto lto = getLTOMode(*table_lib_lib);
         string entry = "lib.sl";
 
         auto ccflags = table_lib_lib->getArray("ccflags").release();
         auto ldflags = table_lib_lib->getArray("ldflags").release();
 
-        build_objs(entry, name.second, ccflags, ldflags, nostd.second);
+        build_objs(entry, name.second, ccflags, ldflags, nostd.second, lto);
 
         vector<string> arargs;
         vector<string> arf;
         vector<string> objs;
 
-        searchObjs(objs);
+        if (lto != LTO_NONE) {
+            // std is not merged into a library, programs using it link their own
+            link_bitcodes("build" SYSTEM_PATH_DIVIDER "lib" + name.second, ccflags, false, {}, lto, objs);
+        } else {
+            searchObjs(objs);
+        }
 
         arargs.push_back("-r");
         arargs.push_back("build" SYSTEM_PATH_DIVIDER "lib" + name.second + ".a");
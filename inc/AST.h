@@ -33,8 +33,10 @@
 
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
@@ -53,6 +55,7 @@
 #include "Exception.h"
 #include "Token.h"
 #include "SymbolTable.h"
+#include "TypeTable.h"
 #include <typeinfo>
 #include <utility>
 #include <vector>
@@ -102,29 +105,104 @@ namespace AVSI {
     /*******************************************************
      *                      structure                      *
      *******************************************************/
+    struct StructMember {
+        int index;
+        // offset in bytes by data layout of target
+        uint64_t offset;
+    };
+
     struct StructDef {
+        string id;
         llvm::StructType *Ty;
-        map<string, int> members;
+        // member name to index and offset
+        llvm::StringMap<StructMember> members;
+        // member name by index, empty if a member has no name
+        vector<string> member_names;
 
         StructDef() = default;
 
-        StructDef(llvm::StructType *Ty) : Ty(Ty), members(map<string, int>()) {}
+        StructDef(llvm::StructType *Ty) : Ty(Ty) {}
 
         ~StructDef() = default;
     };
 
     struct GenericDef {
         int idx;
-        // map type string to function name
-        map<string, string> function_map;
+        // map type id to function name, id of "default" is 0
+        llvm::DenseMap<uint32_t, string> function_map;
+        // map type name to function name for an imported generic function,
+        // an entry moves to function_map at the first call of its type
+        llvm::StringMap<string> imported_map;
 
         GenericDef() = default;
 
-        GenericDef(int idx) : idx(idx), function_map(map<string, string>()) {}
+        GenericDef(int idx) : idx(idx) {}
 
         ~GenericDef() = default;
     };
 
+    /*
+     * a function or obj with type parameters, e.g. function max<T>(a: T, b: T).
+     * its source is parsed again with the parameters bound for every
+     * instance, so an instance is compiled like a hand-written copy
+     */
+    struct GenericTemplate {
+        // name with module path, e.g. a::b::max
+        string id;
+        string name;
+        // module the template is defined in, names in its body are
+        // resolved in this module
+        vector<string> module_path;
+        vector<string> module_path_with_module_name;
+        vector<string> params;
+        // source after the parameter list, from "(" of a function or
+        // "{" of an obj to the closing "}"
+        string source;
+        int line;
+        int column;
+        bool is_object;
+        bool is_inline;
+        bool is_always_inline;
+        bool is_noinline;
+        bool is_pure;
+        // opaque types standing for params and the parameter types of a
+        // function made of them, built at the first inference
+        vector<llvm::Type *> placeholders;
+        vector<llvm::Type *> patterns;
+        map<vector<llvm::Type *>, llvm::Type *> object_instances;
+        map<vector<llvm::Type *>, llvm::Function *> function_instances;
+
+        GenericTemplate()
+                : line(0), column(0), is_object(false), is_inline(false),
+                  is_always_inline(false), is_noinline(false), is_pure(false) {}
+    };
+
+    /*
+     * hints written before for and while, e.g. unroll(4) vectorize(8) for ...
+     * they become llvm.loop metadata of the loop. a count of 0 means the
+     * hint is given without a count, -1 means it is not given
+     */
+    struct LoopHint {
+        int line;
+        int column;
+        // unroll(n), 1 disables unrolling
+        int unroll;
+        // vectorize(width), 1 disables vectorization
+        int vectorize;
+        // interleave(n), number of iterations running in one vector iteration
+        int interleave;
+        // iterations do not depend on each other through memory
+        bool no_alias;
+
+        LoopHint()
+                : line(0), column(0), unroll(-1), vectorize(-1),
+                  interleave(-1), no_alias(false) {}
+
+        bool empty() const {
+            return unroll < 0 && vectorize < 0 && interleave < 0 && !no_alias;
+        }
+    };
+
     /*******************************************************
      *                       AST base                      *
      *******************************************************/
@@ -263,6 +341,29 @@ namespace AVSI {
         void dump(int depth) override;
     };
 
+    /*
+     * parallel(schedule, chunk) reduce(op: var, ...) before a for loop. the
+     * body is outlined to a function, iterations are shared by the threads
+     * of the runtime in libavsi (parallel.c)
+     */
+    struct ParallelLoop {
+        // values are those of the runtime
+        enum Schedule {
+            STATIC = 0,
+            DYNAMIC = 1,
+            GUIDED = 2
+        };
+
+        bool enabled;
+        Schedule schedule;
+        // iterations taken at once, nullptr for the default of schedule
+        shared_ptr<AST> chunk;
+        // operator (+, *, min or max) and token of the variable
+        vector<pair<string, Token>> reductions;
+
+        ParallelLoop() : enabled(false), schedule(STATIC), chunk(nullptr) {}
+    };
+
     class For : public AST {
     public:
         shared_ptr<AST> initList;
@@ -270,6 +371,8 @@ namespace AVSI {
         shared_ptr<AST> adjustment;
         shared_ptr<AST> compound;
         bool noCondition;
+        LoopHint hint;
+        ParallelLoop parallel;
 
         For(void)
                 : AST(__FOR_NAME), initList(nullptr), condition(nullptr),
@@ -298,6 +401,8 @@ namespace AVSI {
         bool is_always_inline;
         bool is_noinline;
         bool is_pure;
+        // target_clones("avx2", "default"), one version for each target
+        vector<string> target_clones;
 
         FunctionDecl(void)
                 : AST(__FUNCTIONDECL_NAME),
@@ -336,6 +441,8 @@ namespace AVSI {
         string id;
         vector<shared_ptr<AST> > paramList;
         llvm::Value *param_this;
+        // explicit arguments of a generic function, e.g. zero<i32>()
+        vector<Type> type_args;
 
         FunctionCall(void)
                 : AST(__FUNCTIONCALL_NAME),paramList(vector<shared_ptr<AST> >()), param_this(nullptr) {};
@@ -737,6 +844,7 @@ namespace AVSI {
     public:
         shared_ptr<AST> condition;
         shared_ptr<AST> compound;
+        LoopHint hint;
 
         While(void)
                 : AST(__WHILE_NAME), condition(nullptr), compound(nullptr) {};
@@ -767,20 +875,75 @@ namespace AVSI {
 
     pair<map<string, StructDef *>::iterator, string> find_struct(vector<string> modinfo, string &name);
 
+    pair<map<string, GenericTemplate *>::iterator, string> find_object_template(vector<string> modinfo, string &name);
+
+    GenericTemplate *find_function_template(vector<string> modinfo, string &name);
+
     void llvm_import_module(vector<string> path, string mod, int line, int col, string as = string());
 
-    void llvm_global_context_reset();
+    void llvm_link_imported_bodies();
 
-    void llvm_module_fpm_init();
+    void llvm_global_context_reset();
 
     void llvm_machine_init();
 
-    void llvm_emit_obj();
-
-    void llvm_emit_asm();
+    void llvm_emit_machine_code(bool emit_asm);
 
     void llvm_emit_bitcode();
 
+    void llvm_emit_interface();
+
+    void llvm_import_interface(string filename, string unparsed_name, int line, int col);
+
+    void llvm_profile_instrument(string filename);
+
+    void llvm_profile_annotate(string filename);
+
+    int llvm_jit_run(vector<string> args);
+
+    void llvm_set_target_clones(llvm::Function *fun, vector<string> targets, int line, int col);
+
+    void llvm_emit_target_clones();
+
+    void llvm_lower_ifuncs(llvm::Module &M);
+
+    llvm::Constant *llvm_const_eval(llvm::Function *fun, vector<llvm::Value *> args, string &reason);
+
+    void llvm_register_template(GenericTemplate *gt);
+
+    void llvm_import_templates(map<string, vector<vector<string>> *> &metadata);
+
+    string llvm_instance_name(GenericTemplate *gt, vector<llvm::Type *> &args);
+
+    llvm::Type *llvm_object_pattern(GenericTemplate *gt, vector<llvm::Type *> &args);
+
+    void llvm_object_instance(llvm::Type *Ty, GenericTemplate *gt, vector<llvm::Type *> &args);
+
+    llvm::Function *llvm_instantiate_function(GenericTemplate *gt, vector<Type> type_args,
+                                              vector<llvm::Value *> &args, const Token &token);
+
+    void llvm_instantiate_pending();
+
+    shared_ptr<AST> llvm_parse_instance(GenericTemplate *gt, vector<Type> &args, string id);
+
+    void llvm_generic_reset();
+
+    void llvm_debug_init();
+
+    void llvm_debug_struct(llvm::StructType *Ty, int line);
+
+    llvm::DIScope *llvm_debug_function(llvm::Function *fun, string name, int line);
+
+    void llvm_debug_function_end(llvm::Function *fun);
+
+    llvm::DIScope *llvm_debug_lexical_block(llvm::DIScope *parent);
+
+    void llvm_debug_location(int line, int col);
+
+    void llvm_debug_variable(string name, llvm::AllocaInst *addr, llvm::DIScope *scope, unsigned arg_no);
+
+    void llvm_debug_finalize();
+
     void llvm_emit_ir();
 
     string llvm_emit_cpp();
@@ -794,7 +957,11 @@ namespace AVSI {
 
     bool isTheSameBasicType(llvm::PointerType *l, llvm::PointerType *r);
 
-    uint64_t registerType(llvm::Type *Ty);
+    vector<string> getFunctionNameCandidates(vector<string> modinfo, string id);
+
+    StructDef *registerStruct(string id, llvm::StructType *Ty, vector<string> member_names);
+
+    StructDef *findStructDef(llvm::Type *Ty);
 
     llvm::AllocaInst *allocaBlockEntry(llvm::Function *fun, string name, llvm::Type *Ty);
 
@@ -806,6 +973,20 @@ namespace AVSI {
 
     bool store(AST *ast, llvm::Value *l_alloca_addr, llvm::Value *r_value, bool assignment = true, string l_base_name = "member");
 
+    void storeAggregate(llvm::Value *v, llvm::Value *addr);
+
+    void eraseDeadAggregateLoads(llvm::Function *fun);
+
+    llvm::Value *llvm_parallel_for(For *loop);
+
+    bool llvm_is_parallel_body(llvm::Function *fun);
+
+    void llvm_set_loop_hint(const LoopHint &hint, llvm::BasicBlock *header, llvm::BasicBlock *preheader);
+
+    void llvm_vector_access_align(llvm::Instruction *inst, llvm::Value *ptr);
+
+    void llvm_bounds_check(llvm::Value *index, uint64_t len, int line, int column);
+
     llvm::Value *type_conv(AST *ast, llvm::Value *v, llvm::Type *vtype, llvm::Type *etype, bool AllowPtrConv = true);
 
     /* derivator */
@@ -821,6 +1002,8 @@ namespace AVSI {
     /* built-in function */
     bool SF_convert_binop_operand(FunctionCall *ast, llvm::Value *lv, llvm::Value *rv);
 
+    void SF_convert_vector_operand(FunctionCall *ast, llvm::Value *&lv, llvm::Value *&rv);
+
     bool SF_is_builtin(FunctionCall *ast);
 
     llvm::Value *SF_builtin(FunctionCall *ast);
@@ -828,6 +1011,24 @@ namespace AVSI {
     llvm::Value *SF_min(FunctionCall *ast);
 
     llvm::Value *SF_max(FunctionCall *ast);
+
+    llvm::Value *SF_vsplat(FunctionCall *ast);
+
+    llvm::Value *SF_vshuffle(FunctionCall *ast);
+
+    llvm::Value *SF_vselect(FunctionCall *ast);
+
+    llvm::Value *SF_vany(FunctionCall *ast);
+
+    llvm::Value *SF_vall(FunctionCall *ast);
+
+    llvm::Value *SF_vsum(FunctionCall *ast);
+
+    llvm::Value *SF_vmin(FunctionCall *ast);
+
+    llvm::Value *SF_vmax(FunctionCall *ast);
+
+    llvm::Value *SF_vdot(FunctionCall *ast);
 } // namespace AVSI
 
 #endif
\ No newline at end of file
@@ -46,6 +46,7 @@
 #define __ErrReport         "ErrReport"
 
 #define __Warning           "Warning"
+#define __Remark            "Remark"
 
 
 #define __COLOR_RESET       "\033[0m"
@@ -181,6 +182,14 @@ namespace AVSI {
                   << msg
                   << __COLOR_RESET << std::endl;
     }
+
+    static inline void Remark(std::string msg, int line, int column) {
+        std::cerr << __COLOR_GREEN << input_file_name;
+        if (line > 0) std::cerr << ":" << line << ":" << column + 1;
+        std::cerr << ": " << __Remark << ": "
+                  << msg
+                  << __COLOR_RESET << std::endl;
+    }
 } // namespace AVSI
 
 #endif
\ No newline at end of file
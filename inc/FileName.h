@@ -46,13 +46,17 @@
 
 #define MODULE_INIT_NAME    "__init__"
 #define MODULE_LIB_NAME     "lib"
+// bitcode of imported modules, loaded transitively by --run
+#define MODULE_IMPORTS_MD   "avsi.imports"
 
 extern std::string compiler_command_line;
 
 extern std::string compiler_exec_path;
 extern std::string output_root_path;
 extern std::vector<std::string> include_path;
+extern std::vector<std::string> library_path;
 extern std::vector<std::string> package_path;
+extern std::vector<std::string> import_chain;
 
 extern std::string input_file_name_raw;
 extern std::string input_file_name;
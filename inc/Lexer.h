@@ -39,16 +39,20 @@
 #include "Token.h"
 
 namespace AVSI {
-    using std::ifstream;
+    using std::istream;
     using std::string;
 
     class Lexer {
     private:
-        ifstream *file;
+        istream *file;
 //        unsigned int linenum;
 //        unsigned int cur;
         std::string line;
         decltype(file->tellg()) file_state_backup;
+        // source text read since startRecord
+        bool recording = false;
+        string record;
+        size_t record_size_backup = 0;
 
     public:
         unsigned int linenum;
@@ -57,7 +61,7 @@ namespace AVSI {
 
         Lexer(void);
 
-        Lexer(ifstream *file);
+        Lexer(istream *file);
 
         ~Lexer();
 
@@ -88,6 +92,10 @@ namespace AVSI {
         void stash(Lexer *backup);
 
         void restore(Lexer *backup);
+
+        void startRecord();
+
+        string stopRecord();
     };
 
     static map<char, TokenType> TokenMap = {
@@ -155,6 +163,13 @@ namespace AVSI {
             {"noinline",        NOINLINE},
             {"pure",            PURE},
             {"const",           CONST},
+            {"target_clones",   TARGET_CLONES},
+            {"unroll",          UNROLL},
+            {"vectorize",       VECTORIZE},
+            {"interleave",      INTERLEAVE},
+            {"no_alias",        NO_ALIAS},
+            {"parallel",        PARALLEL},
+            {"reduce",          REDUCE},
             {"f64",             F64},
             {"f32",             F32},
             {"i128",            I128},
@@ -47,12 +47,18 @@ namespace AVSI {
         Token currentToken;
         Token lastToken;
         int parenCnt = 0;
+        // types bound to type parameters when parsing an instance of generic
+        map<string, Type> type_params;
+        // generic function or obj declared by the last statement
+        GenericTemplate *last_template = nullptr;
 
     public:
         Parser(void);
 
         Parser(Lexer *lexer);
 
+        Parser(Lexer *lexer, map<string, Type> type_params);
+
         ~Parser();
 
         void eat(TokenType type);
@@ -69,8 +75,16 @@ namespace AVSI {
 
         shared_ptr<AST> forStatement();
 
+        void loopHint(LoopHint &hint);
+
+        void parallelClause(ParallelLoop &parallel);
+
+        shared_ptr<AST> loopStatement();
+
         shared_ptr<AST> functionDecl();
 
+        shared_ptr<AST> functionTail(Token token, string id);
+
         shared_ptr<AST> functionCall();
 
         shared_ptr<AST> generic();
@@ -85,6 +99,16 @@ namespace AVSI {
 
         shared_ptr<AST> object(bool is_mangle);
 
+        shared_ptr<AST> objectTail(Token token, string id);
+
+        GenericTemplate *genericTemplate(string name);
+
+        bool isGenericName();
+
+        vector<Type> eatTypeArgs();
+
+        Type instantiateObject(GenericTemplate *gt, vector<Type> args, Token token);
+
         shared_ptr<AST> IfStatement();
 
         shared_ptr<AST> param();
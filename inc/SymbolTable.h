@@ -32,8 +32,6 @@
 #define AVSI2_SYMBOLTABLE_H
 
 #include "../inc/AST.h"
-#include <map>
-#include <deque>
 #include <vector>
 
 #if (__SIZEOF_POINTER__ == 4)
@@ -49,64 +47,85 @@
 #define ENTRY_NAME          "main"
 
 namespace AVSI {
-    using std::map;
-    using std::deque;
     using std::vector;
 
     class AST;
 
-    class SymbolMap {
-    private:
-        llvm::BasicBlock *BB;
-        map<string, llvm::AllocaInst *> named_values;
-        map<string, shared_ptr<AST>> assigned_ast;
+    /*
+     * a name seen by symbol table. it keeps the innermost binding of the
+     * name, bindings of outer scopes are in the undo log
+     */
+    struct Symbol {
+        string name;
+        size_t hash;
+        llvm::AllocaInst *addr;
+        // scope of addr from 1, 0 if the name is not bound
+        uint32_t addr_depth;
+        shared_ptr<AST> assigned_ast;
+        uint32_t ast_depth;
+
+        Symbol(string name, size_t hash)
+                : name(name),
+                  hash(hash),
+                  addr(nullptr),
+                  addr_depth(0),
+                  assigned_ast(nullptr),
+                  ast_depth(0) {}
+    };
 
-    public:
+    // a binding replaced in an inner scope, restored when the scope is popped
+    struct SymbolUndo {
+        uint32_t symbol;
+        bool is_ast;
+        llvm::AllocaInst *addr;
+        shared_ptr<AST> assigned_ast;
+        uint32_t depth;
+    };
+
+    struct SymbolScope {
+        llvm::BasicBlock *BB;
         llvm::BasicBlock *loop_exit;
         llvm::BasicBlock *loop_entry;
-
-        SymbolMap()
-                : BB(nullptr),
-                  named_values(map < string, llvm::AllocaInst * > ()),
-                  loop_exit(nullptr),
-                  loop_entry(nullptr) {named_values.clear();}
-
-        SymbolMap(llvm::BasicBlock *BB)
-                : BB(BB),
-                  named_values(map < string, llvm::AllocaInst * > ()),
-                  loop_exit(nullptr),
-                  loop_entry(nullptr) {named_values.clear();}
-
-        ~SymbolMap() = default;;
-
-        llvm::BasicBlock *getBasicBlock() const;
-
-        llvm::AllocaInst *find(string &name);
-
-        void insert(string &name, llvm::AllocaInst *addr);
-
-        vector<llvm::AllocaInst *> getAllocaList();
-
-        void insertAssingedAst(string &name, shared_ptr<AST> ast);
-
-        shared_ptr<AST> getAssignedAST(string &name);
+        // scope in debug information, nullptr without -g
+        llvm::DIScope *di_scope;
+        // size of undo log when the scope is pushed
+        size_t undo_mark;
     };
 
+    /*
+     * names are interned in symbols and found by an open addressing hash
+     * table of their indexes, so a lookup costs the same in any depth.
+     * binding a name in a scope pushes the replaced binding to the undo
+     * log, pop rewinds the log to the mark of the scope. vectors keep their
+     * capacity, entering or leaving a scope allocates nothing.
+     */
     class SymbolTable {
     private:
-        deque<SymbolMap *> maps;
+        vector<Symbol> symbols;
+        // index + 1 of symbol, 0 for empty slot. size is a power of 2
+        vector<uint32_t> slots;
+        vector<SymbolUndo> undo_log;
+        vector<SymbolScope> scopes;
+
+        Symbol *lookup(const string &name);
+
+        uint32_t intern(const string &name);
+
+        void rehash(size_t size);
 
     public:
-        SymbolTable() : maps(deque<SymbolMap *>()) {maps.clear();}
+        SymbolTable() : slots(vector<uint32_t>(64, 0)) {}
 
         ~SymbolTable() = default;
 
         void push(llvm::BasicBlock *BB);
 
-        vector<llvm::AllocaInst *> pop();
+        void pop();
 
         llvm::BasicBlock *getBasicBlock() const;
 
+        size_t depth() const;
+
         llvm::AllocaInst *find(string &name);
 
         llvm::BasicBlock *getLoopExit();
@@ -117,7 +136,11 @@ namespace AVSI {
 
         void setLoopEntry(llvm::BasicBlock * BB);
 
-        void insert(string name, llvm::AllocaInst *addr, bool current_scope);
+        void insert(string name, llvm::AllocaInst *addr, bool current_scope, unsigned arg_no = 0);
+
+        llvm::DIScope *getDebugScope();
+
+        void setDebugScope(llvm::DIScope *scope);
 
         void insertAssingedAst(string &name, shared_ptr<AST> ast, bool current_scope);
 
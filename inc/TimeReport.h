@@ -0,0 +1,85 @@
+/*
+ * TimeReport.h 2025
+ *
+ * compile time report
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AVSI2_TIMEREPORT_H
+#define AVSI2_TIMEREPORT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AVSI {
+    using std::string;
+    using std::vector;
+    using std::unique_ptr;
+
+    /*
+     * a phase in time report. phases with the same name under one
+     * parent are merged, e.g. lexing is timed token by token
+     */
+    struct TimeRecord {
+        string name;
+        // seconds
+        double wall = 0;
+        double cpu = 0;
+        // KiB
+        long peak_rss = 0;
+        uint64_t count = 0;
+        vector<unique_ptr<TimeRecord>> children;
+
+        TimeRecord(string name) : name(name) {}
+
+        TimeRecord *child(const string &name);
+    };
+
+    /*
+     * time a phase from construction to destruction. it does nothing
+     * unless --time-report is given
+     */
+    class TimeScope {
+    private:
+        TimeRecord *record;
+        TimeRecord *parent;
+        double wall_start;
+        double cpu_start;
+
+    public:
+        explicit TimeScope(const string &name);
+
+        ~TimeScope();
+    };
+
+    void time_report_init(const string &name);
+
+    void time_report_attach(const string &file);
+
+    void time_report_emit();
+}
+
+#endif //AVSI2_TIMEREPORT_H
@@ -121,6 +121,13 @@ namespace AVSI {
         NOINLINE,
         PURE,
         CONST,
+        TARGET_CLONES,
+        UNROLL,
+        VECTORIZE,
+        INTERLEAVE,
+        NO_ALIAS,
+        PARALLEL,
+        REDUCE,
         // types,
         F64,
         F32,
@@ -192,13 +199,20 @@ namespace AVSI {
             WHILE, OBJ, MODULE,
             IMPORT, NOMANGLE, INLINE,
             ALWAYS_INLINE, NOINLINE, GLOBAL,
-            PURE
+            PURE, TARGET_CLONES, UNROLL,
+            VECTORIZE, INTERLEAVE, NO_ALIAS,
+            PARALLEL, REDUCE
     };
 
     const static TokenType FUNCTION_ATTR[] = {
             PUBLIC, PRIVATE, NOMANGLE, 
             INLINE, ALWAYS_INLINE, NOINLINE,
-            PURE, CONST
+            PURE, CONST, TARGET_CLONES
+    };
+
+    const static TokenType LOOP_HINT[] = {
+            UNROLL, VECTORIZE, INTERLEAVE, NO_ALIAS,
+            PARALLEL, REDUCE
     };
 
     static map<TokenType, string> token_name = {
@@ -253,6 +267,13 @@ namespace AVSI {
             {ALWAYS_INLINE,     "ALWAYS_INLINE"},
             {NOINLINE,          "NOINLINE"},
             {PURE,              "PURE"},
+            {TARGET_CLONES,     "TARGET_CLONES"},
+            {UNROLL,            "UNROLL"},
+            {VECTORIZE,         "VECTORIZE"},
+            {INTERLEAVE,        "INTERLEAVE"},
+            {NO_ALIAS,          "NO_ALIAS"},
+            {PARALLEL,          "PARALLEL"},
+            {REDUCE,            "REDUCE"},
             {GLOBAL,            "GLOBAL"},
             {GENERIC,           "GENERIC"},
             {GRAD,              "GRAD"},
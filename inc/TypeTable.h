@@ -0,0 +1,87 @@
+/*
+ * TypeTable.h 2025
+ *
+ * descriptors of llvm types used by compiler
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AVSI2_TYPETABLE_H
+#define AVSI2_TYPETABLE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Type.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace AVSI {
+    using std::string;
+
+    /*
+     * everything compiler knows about a type. descriptors are interned, a
+     * type gets one descriptor and its id never changes until the global
+     * context is reset
+     */
+    struct TypeDesc {
+        uint32_t id;
+        llvm::Type *Ty;
+        // size in bytes by data layout of target, 0 for unsized type
+        uint64_t size;
+        // name to be displayed in messages and the key of generic function.
+        // built at the first use, empty before that
+        string name;
+
+        TypeDesc(uint32_t id, llvm::Type *Ty, uint64_t size) : id(id), Ty(Ty), size(size) {}
+    };
+
+    /*
+     * descriptors are indexed by their ids. nullptr is the type "default"
+     * of generic function with id 0
+     */
+    class TypeTable {
+    private:
+        // deque keeps references to descriptors valid when it grows
+        std::deque<TypeDesc> descs;
+        llvm::DenseMap<llvm::Type *, uint32_t> index;
+
+        const string &buildName(TypeDesc &desc);
+
+    public:
+        TypeTable() { clear(); }
+
+        ~TypeTable() = default;
+
+        TypeDesc &get(llvm::Type *Ty);
+
+        uint32_t id(llvm::Type *Ty) { return get(Ty).id; }
+
+        uint64_t size(llvm::Type *Ty) { return get(Ty).size; }
+
+        const string &name(llvm::Type *Ty);
+
+        void clear();
+    };
+}
+
+#endif //AVSI2_TYPETABLE_H
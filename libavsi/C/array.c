@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * allocator of std::array
+ *
+ * Array<T> is laid out as the struct below. cap is the number of elements
+ * owned by the array, a slice borrows the memory of another array and has
+ * cap 0, so growing a slice copies it instead of resizing memory of others.
+ * memory is aligned to 32 bytes for vector loads of the loops over it
+ */
+
+#define AVSI_ARRAY_ALIGN 32
+#define AVSI_ARRAY_MIN_CAP 8
+
+struct avsi_array {
+    void *data;
+    int64_t len;
+    int64_t cap;
+};
+
+void *__avsi_alloc(int64_t size) {
+    void *p = NULL;
+    if (size <= 0) size = AVSI_ARRAY_ALIGN;
+    if (posix_memalign(&p, AVSI_ARRAY_ALIGN, (size_t) size) != 0) {
+        fprintf(stderr, "avsi array: out of memory, %lld bytes\n", (long long) size);
+        abort();
+    }
+    return p;
+}
+
+void __avsi_free(void *p) {
+    free(p);
+}
+
+/* make room for n elements, capacity grows by doubling */
+void __avsi_array_reserve(struct avsi_array *a, int64_t n, int64_t elem_size) {
+    if (n <= a->cap) return;
+    if (n < a->len) n = a->len;
+
+    int64_t cap = a->cap < AVSI_ARRAY_MIN_CAP ? AVSI_ARRAY_MIN_CAP : a->cap;
+    while (cap < n) cap *= 2;
+
+    void *data = __avsi_alloc(cap * elem_size);
+    if (a->len) memcpy(data, a->data, (size_t) (a->len * elem_size));
+    if (a->cap) free(a->data);
+
+    a->data = data;
+    a->cap = cap;
+}
+
+void __avsi_array_free(struct avsi_array *a) {
+    if (a->cap) free(a->data);
+    a->data = NULL;
+    a->len = 0;
+    a->cap = 0;
+}
@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * runtime of -fbounds-check
+ *
+ * the compiler checks an index of arr or vec against the length and calls
+ * this on failure. file is the source file of the module, line and column
+ * are the position of the index
+ */
+
+__attribute__((noreturn, cold))
+void __avsi_bounds_fail(int64_t index, int64_t len, const char *file, int32_t line, int32_t column) {
+    fflush(stdout);
+    fprintf(stderr, "%s:%d:%d: index %lld out of bounds for length %lld\n",
+            file, line, column, (long long) index, (long long) len);
+    abort();
+}
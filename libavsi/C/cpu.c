@@ -0,0 +1,87 @@
+#include <stdint.h>
+
+/*
+ * cpu feature runtime for target_clones
+ *
+ * resolvers of ifunc call __avsi_cpu_supports before the program is
+ * initialized, even before relocations of libc are done in a static
+ * program. so only cpuid is used here, no libc functions
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+
+struct avsi_cpu_feature {
+    const char *name;
+    /* leaf of cpuid, 7 means leaf 7 subleaf 0 */
+    uint32_t leaf;
+    /* 0: ebx, 1: ecx, 2: edx */
+    uint32_t reg;
+    uint32_t bit;
+    /* needs ymm (1) or zmm (2) state enabled by os */
+    uint32_t state;
+};
+
+static const struct avsi_cpu_feature features[] = {
+    {"sse3",     1, 1, 0,  0},
+    {"ssse3",    1, 1, 9,  0},
+    {"fma",      1, 1, 12, 1},
+    {"sse4.1",   1, 1, 19, 0},
+    {"sse4.2",   1, 1, 20, 0},
+    {"popcnt",   1, 1, 23, 0},
+    {"avx",      1, 1, 28, 1},
+    {"bmi",      7, 0, 3,  0},
+    {"avx2",     7, 0, 5,  1},
+    {"bmi2",     7, 0, 8,  0},
+    {"avx512f",  7, 0, 16, 2},
+    {"avx512dq", 7, 0, 17, 2},
+    {"avx512cd", 7, 0, 28, 2},
+    {"avx512bw", 7, 0, 30, 2},
+    {"avx512vl", 7, 0, 31, 2},
+};
+
+static int same_name(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/* registers saved by os on context switch, read by xgetbv */
+static uint64_t os_state(void) {
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) return 0;
+
+    uint32_t lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+int __avsi_cpu_supports(const char *name) {
+    for (unsigned i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+        const struct avsi_cpu_feature *f = &features[i];
+        if (!same_name(f->name, name)) continue;
+
+        uint32_t regs[4] = {0, 0, 0, 0};
+        if (!__get_cpuid_count(f->leaf, 0, &regs[3], &regs[0], &regs[1], &regs[2])) return 0;
+        if (!(regs[f->reg] & (1u << f->bit))) return 0;
+
+        uint64_t state = f->state ? os_state() : 0;
+        /* xmm and ymm */
+        if (f->state >= 1 && (state & 0x6) != 0x6) return 0;
+        /* opmask and zmm */
+        if (f->state >= 2 && (state & 0xe0) != 0xe0) return 0;
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int __avsi_cpu_supports(const char *name) {
+    (void) name;
+    return 0;
+}
+
+#endif
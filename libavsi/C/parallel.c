@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * work-sharing runtime of parallel for
+ *
+ * the compiler outlines the body of a parallel for to a function which
+ * takes chunks of the iteration space [0, count) by __avsi_parallel_next
+ * until it is used up, then merges its reductions under
+ * __avsi_parallel_lock. __avsi_parallel_for runs that function once on
+ * every thread of a pool and returns when all of them are done.
+ *
+ * the pool is started at the first parallel for and kept for the whole
+ * program. it has one thread less than the cpus in the affinity mask, the
+ * calling thread is thread 0. AVSI_NUM_THREADS sets the number of threads.
+ * idle workers spin for a while before they sleep, so loops in a row don't
+ * pay for waking them up. they don't spin with more threads than cpus, a
+ * spinning thread would only keep the one it waits for off the cpu.
+ *
+ * a parallel for inside another one, or started while the pool is busy
+ * with a loop of another thread, runs on the calling thread alone.
+ */
+
+#define AVSI_SCHEDULE_STATIC 0
+#define AVSI_SCHEDULE_DYNAMIC 1
+#define AVSI_SCHEDULE_GUIDED 2
+
+#define AVSI_SPIN_COUNT 20000
+
+#if defined(__x86_64__) || defined(__i386__)
+#define avsi_cpu_relax() __builtin_ia32_pause()
+#else
+#define avsi_cpu_relax() ((void) 0)
+#endif
+
+struct avsi_loop;
+
+typedef void (*avsi_parallel_body)(void *ctx, struct avsi_loop *loop);
+
+struct avsi_loop {
+    avsi_parallel_body body;
+    void *ctx;
+    int64_t count;
+    int64_t chunk;
+    int32_t schedule;
+    int32_t threads;
+    /* next iteration of dynamic and guided schedule */
+    _Atomic int64_t next;
+    pthread_mutex_t lock;
+};
+
+/* state of the loop run by this thread */
+struct avsi_thread {
+    struct avsi_loop *loop;
+    int32_t id;
+    /* next chunk of static schedule, counted in chunks */
+    int64_t static_next;
+};
+
+static __thread struct avsi_thread self;
+
+static struct {
+    pthread_once_t once;
+    int32_t threads;
+    /* rounds to spin before waiting on a condition */
+    int32_t spin;
+    /* set while a loop runs on the pool */
+    atomic_flag busy;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    struct avsi_loop *loop;
+    /* bumped for every loop, workers wait for a new value */
+    _Atomic uint64_t generation;
+    /* workers still running the current loop */
+    _Atomic int32_t running;
+} pool = {
+    .once = PTHREAD_ONCE_INIT,
+    .busy = ATOMIC_FLAG_INIT,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void run_loop(struct avsi_loop *loop, int32_t id) {
+    struct avsi_thread saved = self;
+    self.loop = loop;
+    self.id = id;
+    self.static_next = id;
+    loop->body(loop->ctx, loop);
+    self = saved;
+}
+
+static void *worker_main(void *arg) {
+    int32_t id = (int32_t) (intptr_t) arg;
+    uint64_t seen = 0;
+
+    for (;;) {
+        uint64_t generation;
+        int spin = 0;
+        while ((generation = atomic_load_explicit(&pool.generation, memory_order_acquire)) == seen) {
+            if (++spin < pool.spin) {
+                avsi_cpu_relax();
+                continue;
+            }
+            pthread_mutex_lock(&pool.mutex);
+            while (atomic_load(&pool.generation) == seen) pthread_cond_wait(&pool.start, &pool.mutex);
+            pthread_mutex_unlock(&pool.mutex);
+        }
+        seen = generation;
+
+        struct avsi_loop *loop = pool.loop;
+        if (id < loop->threads) run_loop(loop, id);
+
+        if (atomic_fetch_sub_explicit(&pool.running, 1, memory_order_acq_rel) == 1) {
+            pthread_mutex_lock(&pool.mutex);
+            pthread_cond_signal(&pool.done);
+            pthread_mutex_unlock(&pool.mutex);
+        }
+    }
+    return NULL;
+}
+
+static int32_t cpu_count(void) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) return CPU_COUNT(&set);
+    return 1;
+}
+
+static void pool_init(void) {
+    int32_t cpus = cpu_count();
+    const char *env = getenv("AVSI_NUM_THREADS");
+    pool.threads = env && atoi(env) > 0 ? atoi(env) : cpus;
+    pool.spin = pool.threads <= cpus ? AVSI_SPIN_COUNT : 0;
+    for (int32_t i = 1; i < pool.threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, (void *) (intptr_t) i) != 0) {
+            /* run with the workers started so far */
+            pool.threads = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+void __avsi_parallel_for(avsi_parallel_body body, void *ctx, int64_t count, int32_t schedule, int64_t chunk) {
+    if (count <= 0) return;
+
+    struct avsi_loop loop;
+    loop.body = body;
+    loop.ctx = ctx;
+    loop.count = count;
+    loop.chunk = chunk > 0 ? chunk : 0;
+    loop.schedule = schedule;
+    loop.threads = 1;
+    atomic_init(&loop.next, 0);
+    pthread_mutex_init(&loop.lock, NULL);
+
+    pthread_once(&pool.once, pool_init);
+
+    if (self.loop || pool.threads == 1 || count == 1 || atomic_flag_test_and_set(&pool.busy)) {
+        run_loop(&loop, 0);
+        pthread_mutex_destroy(&loop.lock);
+        return;
+    }
+
+    /* workers beyond count have no iteration, they return at once */
+    loop.threads = count < pool.threads ? (int32_t) count : pool.threads;
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.loop = &loop;
+    atomic_store(&pool.running, pool.threads - 1);
+    atomic_fetch_add_explicit(&pool.generation, 1, memory_order_release);
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+
+    run_loop(&loop, 0);
+
+    for (int spin = 0; atomic_load_explicit(&pool.running, memory_order_acquire) != 0; spin++) {
+        if (spin < pool.spin) {
+            avsi_cpu_relax();
+            continue;
+        }
+        pthread_mutex_lock(&pool.mutex);
+        while (atomic_load(&pool.running) != 0) pthread_cond_wait(&pool.done, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+    }
+
+    atomic_flag_clear(&pool.busy);
+    pthread_mutex_destroy(&loop.lock);
+}
+
+/* next chunk [begin, end) of this thread, 0 if no iteration is left */
+int32_t __avsi_parallel_next(struct avsi_loop *loop, int64_t *begin, int64_t *end) {
+    int64_t b, size;
+
+    switch (loop->schedule) {
+        case AVSI_SCHEDULE_DYNAMIC:
+            size = loop->chunk ? loop->chunk : 1;
+            b = atomic_fetch_add_explicit(&loop->next, size, memory_order_relaxed);
+            break;
+        case AVSI_SCHEDULE_GUIDED:
+            /* a part of what is left, never less than chunk */
+            b = atomic_load_explicit(&loop->next, memory_order_relaxed);
+            do {
+                if (b >= loop->count) return 0;
+                size = (loop->count - b) / (2 * loop->threads);
+                if (size < loop->chunk) size = loop->chunk;
+                if (size < 1) size = 1;
+            } while (!atomic_compare_exchange_weak_explicit(
+                    &loop->next, &b, b + size, memory_order_relaxed, memory_order_relaxed));
+            break;
+        default:
+            if (loop->chunk) {
+                /* chunks are dealt round robin */
+                size = loop->chunk;
+                b = self.static_next * size;
+                self.static_next += loop->threads;
+            } else {
+                /* one block for each thread, sizes differ by 1 at most */
+                if (self.static_next >= loop->threads) return 0;
+                int64_t q = loop->count / loop->threads;
+                int64_t r = loop->count % loop->threads;
+                b = q * self.id + (self.id < r ? self.id : r);
+                size = q + (self.id < r);
+                self.static_next = loop->threads;
+            }
+            break;
+    }
+
+    if (b >= loop->count) return 0;
+    *begin = b;
+    *end = size < loop->count - b ? b + size : loop->count;
+    return 1;
+}
+
+void __avsi_parallel_lock(struct avsi_loop *loop) {
+    pthread_mutex_lock(&loop->lock);
+}
+
+void __avsi_parallel_unlock(struct avsi_loop *loop) {
+    pthread_mutex_unlock(&loop->lock);
+}
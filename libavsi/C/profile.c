@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * profile runtime for programs built with -fprofile-generate
+ *
+ * every module registers its function records by a constructor. at exit
+ * the counts are merged into the profile file, one line per function:
+ *     name hash n c0 c1 ... c(n-1)
+ * lines of functions not in this program are kept
+ */
+
+struct avsi_prof_record {
+    const char *name;
+    uint64_t hash;
+    uint32_t num_counters;
+    uint64_t *counters;
+};
+
+struct avsi_prof_module {
+    struct avsi_prof_record *records;
+    uint32_t num_records;
+    struct avsi_prof_module *next;
+};
+
+static struct avsi_prof_module *modules = NULL;
+static const char *profile_file = NULL;
+
+static struct avsi_prof_record *find_record(const char *name, uint64_t hash, uint32_t n) {
+    for (struct avsi_prof_module *m = modules; m; m = m->next) {
+        for (uint32_t i = 0; i < m->num_records; i++) {
+            struct avsi_prof_record *r = &m->records[i];
+            if (r->hash == hash && r->num_counters == n && strcmp(r->name, name) == 0) return r;
+        }
+    }
+    return NULL;
+}
+
+/* add counts of last runs, returns lines which belong to other programs */
+static char *merge_profile(FILE *in) {
+    size_t kept_size = 0, kept_cap = 0;
+    char *kept = NULL;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &line_cap, in)) != -1) {
+        char *name = malloc(len + 1);
+        unsigned long long hash, n;
+        int pos = 0;
+        if (sscanf(line, "%s %llu %llu%n", name, &hash, &n, &pos) != 3) {
+            free(name);
+            continue;
+        }
+
+        struct avsi_prof_record *r = find_record(name, hash, n);
+        free(name);
+        if (r) {
+            char *p = line + pos;
+            for (uint32_t i = 0; i < r->num_counters; i++) {
+                r->counters[i] += strtoull(p, &p, 10);
+            }
+            continue;
+        }
+
+        if (kept_size + len + 1 > kept_cap) {
+            kept_cap = (kept_size + len + 1) * 2;
+            kept = realloc(kept, kept_cap);
+        }
+        memcpy(kept + kept_size, line, len);
+        kept_size += len;
+        kept[kept_size] = '\0';
+    }
+    free(line);
+    return kept;
+}
+
+/* run by .fini_array, atexit needs __dso_handle from crtbegin.o which cart does not link */
+__attribute__((destructor))
+static void write_profile(void) {
+    if (!modules) return;
+
+    const char *file = getenv("AVSI_PROFILE_FILE");
+    if (!file) file = profile_file;
+
+    char *kept = NULL;
+    FILE *in = fopen(file, "r");
+    if (in) {
+        kept = merge_profile(in);
+        fclose(in);
+    }
+
+    FILE *out = fopen(file, "w");
+    if (!out) {
+        fprintf(stderr, "avsi profile: can't write '%s'\n", file);
+        free(kept);
+        return;
+    }
+    if (kept) fputs(kept, out);
+    free(kept);
+
+    for (struct avsi_prof_module *m = modules; m; m = m->next) {
+        for (uint32_t i = 0; i < m->num_records; i++) {
+            struct avsi_prof_record *r = &m->records[i];
+            fprintf(out, "%s %llu %u", r->name, (unsigned long long) r->hash, r->num_counters);
+            for (uint32_t j = 0; j < r->num_counters; j++) {
+                fprintf(out, " %llu", (unsigned long long) r->counters[j]);
+            }
+            fputc('\n', out);
+        }
+    }
+    fclose(out);
+}
+
+void __avsi_prof_register(const char *file, struct avsi_prof_record *records, uint32_t num_records) {
+    struct avsi_prof_module *m = malloc(sizeof(struct avsi_prof_module));
+    if (!m) return;
+
+    m->records = records;
+    m->num_records = num_records;
+    m->next = modules;
+
+    if (!modules) profile_file = file;
+    modules = m;
+}
@@ -0,0 +1,379 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * work-stealing runtime of std::task
+ *
+ * every thread of the pool owns a Chase-Lev deque. a task spawned by a
+ * thread is pushed to the bottom of its own deque, the owner takes tasks
+ * from the bottom and idle threads steal from the top of the others. so
+ * an owner works depth first on what it spawned itself, and a thief takes
+ * the oldest task, which is the largest part of a divide and conquer.
+ *
+ * the deque follows "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013). a full deque
+ * grows to twice its size, the old buffer may still be read by a thief and
+ * is kept until the program exits, which is less than the size in use.
+ *
+ * the pool is started at the first spawn. it has one thread less than the
+ * cpus in the affinity mask, the thread of the first spawn owns deque 0.
+ * AVSI_NUM_THREADS sets the number of threads. any other thread outside of
+ * the pool, e.g. a thread of parallel for, runs its tasks at once.
+ *
+ * join and wait never block, they run other tasks until what they wait
+ * for is done. workers with nothing to steal spin for a while and sleep.
+ */
+
+#define AVSI_DEQUE_MIN_SIZE 256
+#define AVSI_SPIN_COUNT 2000
+#define AVSI_TASK_CACHE 64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define avsi_cpu_relax() __builtin_ia32_pause()
+#else
+#define avsi_cpu_relax() ((void) 0)
+#endif
+
+typedef void (*avsi_task_fn)(void *arg);
+
+struct avsi_group {
+    /* tasks spawned in the group and not finished yet */
+    _Atomic int64_t pending;
+};
+
+struct avsi_task {
+    avsi_task_fn fn;
+    void *arg;
+    /* NULL for a task with handle, which is freed by join */
+    struct avsi_group *group;
+    _Atomic int32_t done;
+    /* next free task of the cache of a thread */
+    struct avsi_task *next;
+};
+
+struct avsi_buffer {
+    int64_t size;
+    struct avsi_buffer *prev;
+    _Atomic(struct avsi_task *) slot[];
+};
+
+struct avsi_deque {
+    _Atomic int64_t top;
+    /* keep thieves on top away from the line of the owner */
+    char pad[64 - sizeof(int64_t)];
+    _Atomic int64_t bottom;
+    _Atomic(struct avsi_buffer *) buffer;
+    char pad2[64 - sizeof(int64_t) - sizeof(void *)];
+};
+
+struct avsi_worker {
+    struct avsi_deque *deque;
+    int32_t id;
+    uint32_t seed;
+    /* freed tasks, reused by spawn of this thread */
+    struct avsi_task *cache;
+    int32_t cached;
+};
+
+static __thread struct avsi_worker self;
+
+static struct {
+    pthread_once_t once;
+    int32_t threads;
+    int32_t spin;
+    struct avsi_deque *deques;
+    /* set once a thread outside of the pool owns deque 0 */
+    atomic_flag owned;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    _Atomic int32_t sleeping;
+} pool = {
+    .once = PTHREAD_ONCE_INIT,
+    .owned = ATOMIC_FLAG_INIT,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void *task_alloc(size_t size) {
+    void *p = aligned_alloc(64, (size + 63) & ~(size_t) 63);
+    if (!p) {
+        fprintf(stderr, "avsi task: out of memory, %zu bytes\n", size);
+        abort();
+    }
+    return p;
+}
+
+static struct avsi_buffer *buffer_new(int64_t size, struct avsi_buffer *prev) {
+    struct avsi_buffer *b = task_alloc(sizeof(struct avsi_buffer) + size * sizeof(b->slot[0]));
+    b->size = size;
+    b->prev = prev;
+    return b;
+}
+
+/* owner only */
+static void deque_push(struct avsi_deque *d, struct avsi_task *t) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&d->top, memory_order_acquire);
+    struct avsi_buffer *a = atomic_load_explicit(&d->buffer, memory_order_relaxed);
+
+    if (b - top > a->size - 1) {
+        struct avsi_buffer *grown = buffer_new(a->size * 2, a);
+        for (int64_t i = top; i < b; i++) {
+            struct avsi_task *x = atomic_load_explicit(&a->slot[i & (a->size - 1)], memory_order_relaxed);
+            atomic_store_explicit(&grown->slot[i & (grown->size - 1)], x, memory_order_relaxed);
+        }
+        atomic_store_explicit(&d->buffer, grown, memory_order_release);
+        a = grown;
+    }
+
+    /* release on the slot too, the task is published by it as well */
+    atomic_store_explicit(&a->slot[b & (a->size - 1)], t, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+/* owner only, NULL if empty */
+static struct avsi_task *deque_take(struct avsi_deque *d) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    struct avsi_buffer *a = atomic_load_explicit(&d->buffer, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    struct avsi_task *x = atomic_load_explicit(&a->slot[b & (a->size - 1)], memory_order_relaxed);
+    if (t == b) {
+        /* the last one, a thief may take it at the same time */
+        if (!atomic_compare_exchange_strong_explicit(
+                &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            x = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+/* any thread, NULL if empty or lost a race */
+static struct avsi_task *deque_steal(struct avsi_deque *d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+
+    struct avsi_buffer *a = atomic_load_explicit(&d->buffer, memory_order_acquire);
+    struct avsi_task *x = atomic_load_explicit(&a->slot[t & (a->size - 1)], memory_order_acquire);
+    if (!atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return x;
+}
+
+static int deque_empty(struct avsi_deque *d) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+    return t >= b;
+}
+
+static struct avsi_task *task_new(void) {
+    struct avsi_task *t = self.cache;
+    if (t) {
+        self.cache = t->next;
+        self.cached--;
+        return t;
+    }
+    return task_alloc(sizeof(struct avsi_task));
+}
+
+static void task_free(struct avsi_task *t) {
+    if (self.cached < AVSI_TASK_CACHE) {
+        t->next = self.cache;
+        self.cache = t;
+        self.cached++;
+        return;
+    }
+    free(t);
+}
+
+static void task_run(struct avsi_task *t) {
+    t->fn(t->arg);
+    struct avsi_group *g = t->group;
+    if (g) {
+        task_free(t);
+        atomic_fetch_sub_explicit(&g->pending, 1, memory_order_release);
+    } else {
+        atomic_store_explicit(&t->done, 1, memory_order_release);
+    }
+}
+
+/* a task of this thread, or one stolen from a random other thread */
+static struct avsi_task *task_find(void) {
+    struct avsi_task *t = deque_take(self.deque);
+    if (t) return t;
+
+    int32_t n = pool.threads;
+    self.seed = self.seed * 1103515245u + 12345u;
+    int32_t start = (int32_t) ((self.seed >> 16) % (uint32_t) n);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t victim = (start + i) % n;
+        if (victim == self.id) continue;
+        t = deque_steal(&pool.deques[victim]);
+        if (t) return t;
+    }
+    return NULL;
+}
+
+static int pool_empty(void) {
+    for (int32_t i = 0; i < pool.threads; i++) {
+        if (!deque_empty(&pool.deques[i])) return 0;
+    }
+    return 1;
+}
+
+static void worker_sleep(void) {
+    pthread_mutex_lock(&pool.mutex);
+    atomic_fetch_add_explicit(&pool.sleeping, 1, memory_order_seq_cst);
+    /* a spawn after this sees sleeping and wakes us up */
+    if (pool_empty()) pthread_cond_wait(&pool.wake, &pool.mutex);
+    atomic_fetch_sub_explicit(&pool.sleeping, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&pool.mutex);
+}
+
+static void *worker_main(void *arg) {
+    self.id = (int32_t) (intptr_t) arg;
+    self.deque = &pool.deques[self.id];
+    self.seed = (uint32_t) self.id * 2654435761u;
+
+    for (int spin = 0;; spin++) {
+        struct avsi_task *t = task_find();
+        if (t) {
+            task_run(t);
+            spin = 0;
+        } else if (spin < pool.spin) {
+            avsi_cpu_relax();
+        } else {
+            worker_sleep();
+            spin = 0;
+        }
+    }
+    return NULL;
+}
+
+static int32_t cpu_count(void) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) return CPU_COUNT(&set);
+    return 1;
+}
+
+static void pool_init(void) {
+    int32_t cpus = cpu_count();
+    const char *env = getenv("AVSI_NUM_THREADS");
+    pool.threads = env && atoi(env) > 0 ? atoi(env) : cpus;
+    pool.spin = pool.threads <= cpus ? AVSI_SPIN_COUNT : 0;
+
+    pool.deques = task_alloc(sizeof(struct avsi_deque) * pool.threads);
+    for (int32_t i = 0; i < pool.threads; i++) {
+        atomic_init(&pool.deques[i].top, 0);
+        atomic_init(&pool.deques[i].bottom, 0);
+        atomic_init(&pool.deques[i].buffer, buffer_new(AVSI_DEQUE_MIN_SIZE, NULL));
+    }
+
+    for (int32_t i = 1; i < pool.threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, (void *) (intptr_t) i) != 0) {
+            /* run with the workers started so far */
+            pool.threads = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+/* deque of this thread, NULL for a thread outside of the pool */
+static struct avsi_deque *own_deque(void) {
+    if (self.deque) return self.deque;
+    pthread_once(&pool.once, pool_init);
+    if (atomic_flag_test_and_set(&pool.owned)) return NULL;
+    self.id = 0;
+    self.deque = &pool.deques[0];
+    self.seed = 1;
+    return self.deque;
+}
+
+static void task_push(struct avsi_task *t) {
+    deque_push(self.deque, t);
+    /* pairs with the fence of sleeping in worker_sleep */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool.sleeping, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&pool.mutex);
+        pthread_cond_signal(&pool.wake);
+        pthread_mutex_unlock(&pool.mutex);
+    }
+}
+
+/* run other tasks until a task is done or a group has none pending */
+static void help_until(_Atomic int32_t *done, _Atomic int64_t *pending) {
+    for (int spin = 0;; spin++) {
+        if (done && atomic_load_explicit(done, memory_order_acquire)) return;
+        if (pending && atomic_load_explicit(pending, memory_order_acquire) == 0) return;
+
+        struct avsi_task *t = self.deque ? task_find() : NULL;
+        if (t) {
+            task_run(t);
+            spin = 0;
+        } else if (spin < pool.spin) {
+            avsi_cpu_relax();
+        } else {
+            /* the task is run by a thief which may need this cpu */
+            sched_yield();
+        }
+    }
+}
+
+void *__avsi_task_spawn(avsi_task_fn fn, void *arg) {
+    struct avsi_task *t = task_new();
+    t->fn = fn;
+    t->arg = arg;
+    t->group = NULL;
+    atomic_init(&t->done, 0);
+
+    if (own_deque()) {
+        task_push(t);
+    } else {
+        task_run(t);
+    }
+    return t;
+}
+
+void __avsi_task_join(struct avsi_task *t) {
+    if (!t) return;
+    help_until(&t->done, NULL);
+    task_free(t);
+}
+
+void __avsi_group_spawn(struct avsi_group *g, avsi_task_fn fn, void *arg) {
+    atomic_fetch_add_explicit(&g->pending, 1, memory_order_relaxed);
+    struct avsi_task *t = task_new();
+    t->fn = fn;
+    t->arg = arg;
+    t->group = g;
+
+    if (own_deque()) {
+        task_push(t);
+    } else {
+        task_run(t);
+    }
+}
+
+void __avsi_group_wait(struct avsi_group *g) {
+    help_until(NULL, &g->pending);
+}
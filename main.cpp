@@ -27,6 +27,7 @@
  */
 
 #include <cstdlib>
+#include <cstring>
 #include <unistd.h>
 #include <memory>
 #include <getopt.h>
@@ -36,6 +37,7 @@
 
 #include "./inc/Parser.h"
 #include "./inc/FileName.h"
+#include "./inc/TimeReport.h"
 
 #define AVSI_VERSION_MAJOR      0
 #define AVSI_VERSION_MINOR      1
@@ -64,9 +66,19 @@ static struct option long_options[] = {
         {"verbose", no_argument, NULL, 'v'},
         {"include", required_argument, NULL, 'I'},
         {"warning", no_argument, NULL, 'W'},
-        {"optimize", no_argument, NULL, 'O'},
+        {"optimize", optional_argument, NULL, 'O'},
         {"dump", no_argument, NULL, 'D'},
+        {"debug", no_argument, NULL, 'g'},
         {"package-name", required_argument, NULL, 100},
+        {"import-chain", required_argument, NULL, 101},
+        {"time-report", optional_argument, NULL, 256},
+        {"time-report-output", required_argument, NULL, 257},
+        {"lto", optional_argument, NULL, 258},
+        {"library-path", required_argument, NULL, 'L'},
+        {"jit-cache", required_argument, NULL, 259},
+        {"no-jit-cache", no_argument, NULL, 260},
+        {"march", required_argument, NULL, 261},
+        {"mattr", required_argument, NULL, 262},
         {0, 0, 0, 0}
 };
 
@@ -78,8 +90,43 @@ bool opt_reliance = false;
 bool opt_verbose = false;
 bool opt_warning = false;
 bool opt_optimize = false;
+// -O<opt_level>, -Os sets opt_size_level 1 and -Oz sets 2
+int opt_level = 0;
+int opt_size_level = 0;
 bool opt_dump = false;
 bool opt_pic = false;
+// -g, DWARF line tables, scopes, variables and types
+bool opt_debug = false;
+bool opt_time_report = false;
+bool opt_time_report_json = false;
+// emit bitcode only, objects are produced by the link time optimizer
+bool opt_lto = false;
+// --lto=thin, bitcode carries module summary and hash for ThinLTO
+bool opt_thin_lto = false;
+// -fprofile-generate[=<file>] and -fprofile-use=<file>
+string profile_generate_file;
+string profile_use_file;
+// --run <file> [args], compile in memory and run main by jit
+bool opt_run = false;
+vector<string> run_args;
+// machine code of --run is kept in jit_cache_path, empty for default folder
+bool opt_jit_cache = true;
+string jit_cache_path;
+// -march=<cpu|native> and -mattr=<+feature,-feature>
+string target_cpu = "generic";
+string target_features;
+// -fconstexpr-steps=<n> and -fconstexpr-memory=<bytes>, limits of evaluating a pure function at compile time
+uint64_t constexpr_steps = 1 << 20;
+uint64_t constexpr_memory = 1 << 24;
+// -fbounds-check, check indexes of arrays against their lengths at run time
+bool opt_bounds_check = false;
+// -Rpass=<regex>, -Rpass-missed=<regex> and -Rpass-analysis=<regex>, remarks
+// of passes whose name matches <regex>, e.g. -Rpass-missed=loop-vectorize
+string remark_pass;
+string remark_pass_missed;
+string remark_pass_analysis;
+// set by parent compiler, where the report of this compile is written
+string time_report_output;
 
 void printHelp(void) {
     string version = \
@@ -88,28 +135,61 @@ void printHelp(void) {
     string msg = \
     "usage:\n"
     "    avsi [options] file\n"
+    "    avsi [options] --run file [args]\n"
     "options:\n"
     "    -l             --ir        Generate .ll LLVM IR.\n"
     "    -S             --asm       Generate .s assembly file.\n"
-    "    -m             --module    Generate .bc module file. \n"
+    "    -m             --module    Generate .bc module and .avsii interface file. \n"
     "    -r             --reliance  Generate .r reliance file for Makefile.\n"
     "    -o <dir>       --output    Output to <dir>.\n"
     "    -h             --help      Display available options.\n"
     "    -v             --verbose   Display more details during building.\n"
     "    -I             --include   Add include path.\n"
+    "    -L <dir>       --library-path\n"
+    "                               Add path to search libavsi.a for --run.\n"
     "    -W             --warning   Show all warnings.\n"
-    "    -O             --optimize  Optimize code\n"
-    "    -D             --dump      AST dump\n\n"
+    "    -O<level>      --optimize  Optimize code, level is 0, 1, 2, 3, s or z.\n"
+    "                               -O is the same as -O2\n"
+    "    -D             --dump      AST dump\n"
+    "    -g             --debug     Generate debug information\n\n"
     "short options:\n"
-    "    -fpic                      generate Position-Independent-Code"
+    "    -fpic                      generate Position-Independent-Code\n"
+    "    -fprofile-generate[=<file>]\n"
+    "                               Count functions and branches, the program writes\n"
+    "                               counts to <file> (default.avsiprof) at exit\n"
+    "    -fprofile-use=<file>       Optimize with counts written by -fprofile-generate\n"
+    "    -fbounds-check             Abort with the position of the access when an index\n"
+    "                               is out of the length of arr or vec\n"
+    "    -fconstexpr-steps=<n>      Stop evaluating a pure function at compile time\n"
+    "                               after <n> instructions (default 1048576)\n"
+    "    -fconstexpr-memory=<n>     Stop evaluating a pure function at compile time\n"
+    "                               when it uses <n> bytes (default 16777216)\n"
+    "    -Rpass=<regex>             Report transformations done by passes matching <regex>,\n"
+    "                               e.g. loop-vectorize, slp-vectorizer, loop-unroll\n"
+    "    -Rpass-missed=<regex>      Report transformations not done by passes matching <regex>\n"
+    "    -Rpass-analysis=<regex>    Report why, e.g. why a loop is not vectorized\n"
+    "    -march=<cpu>               Generate code for <cpu>, native is the cpu of this\n"
+    "                               machine (default generic)\n"
+    "    -mattr=<features>          Turn on or off cpu features, e.g. +avx2,-fma\n"
     "long options:\n"
-    "    --package-name <name>      Set package name split by '.', e.g.  std.io.file\n";
+    "    --package-name <name>      Set package name split by '.', e.g.  std.io.file\n"
+    "    --time-report[=json]       Report wall time, cpu time and peak rss of each phase,\n"
+    "                               json is written to <output>/time-report.json\n"
+    "    --lto[=<mode>]             Emit .bc for link time optimization instead of .o,\n"
+    "                               every imported module is built the same way.\n"
+    "                               mode is full (default) or thin\n"
+    "    --run <file> [args]        JIT compile <file> and run it with [args], options\n"
+    "                               after <file> are passed to the program\n"
+    "    --jit-cache <dir>          Keep machine code of --run in <dir> (default\n"
+    "                               ~/.cache/avsi/jit), unchanged modules are not\n"
+    "                               compiled again\n"
+    "    --no-jit-cache             Always compile modules of --run\n";
 
     printf("%s\n\n%s", version.c_str(), msg.c_str());
 }
 
 void getOption(int argc, char **argv) {
-    while ((opt = getopt_long(argc, argv, "lSmro:hvI:WODf:", long_options, &loidx)) != -1) {
+    while ((opt = getopt_long(argc, argv, "lSmro:hvI:L:WO::Dgf:R:", long_options, &loidx)) != -1) {
         if (opt == 0) {
             opt = lopt;
         }
@@ -145,19 +225,62 @@ void getOption(int argc, char **argv) {
                 t = filesystem::path(optarg);
                 include_path.push_back(filesystem::absolute(t).string());
                 break;
+            case 'L':
+                t = filesystem::path(optarg);
+                library_path.push_back(filesystem::absolute(t).string());
+                break;
             case 'W':
                 opt_warning = true;
                 break;
             case 'O':
-                opt_optimize = true;
+                arg_string = optarg ? string(optarg) : "2";
+                if (arg_string == "s" || arg_string == "z") {
+                    opt_level = 2;
+                    opt_size_level = arg_string == "s" ? 1 : 2;
+                } else if (arg_string.size() == 1 && arg_string[0] >= '0' && arg_string[0] <= '3') {
+                    opt_level = arg_string[0] - '0';
+                    opt_size_level = 0;
+                } else {
+                    cout << "unsupported optimization level '-O" << arg_string << "'" << endl;
+                    exit(-1);
+                }
+                opt_optimize = opt_level != 0;
                 break;
             case 'D':
                 opt_dump = true;
                 break;
+            case 'g':
+                opt_debug = true;
+                break;
             case 'f':
                 reloc_mode = string(optarg);
                 if(reloc_mode == "pic") {
                     opt_pic = true;
+                } else if (reloc_mode == "profile-generate") {
+                    profile_generate_file = "default.avsiprof";
+                } else if (reloc_mode.rfind("profile-generate=", 0) == 0) {
+                    profile_generate_file = reloc_mode.substr(strlen("profile-generate="));
+                } else if (reloc_mode == "bounds-check") {
+                    opt_bounds_check = true;
+                } else if (reloc_mode.rfind("profile-use=", 0) == 0) {
+                    profile_use_file = reloc_mode.substr(strlen("profile-use="));
+                } else if (reloc_mode.rfind("constexpr-steps=", 0) == 0) {
+                    constexpr_steps = strtoull(reloc_mode.substr(strlen("constexpr-steps=")).c_str(), nullptr, 10);
+                } else if (reloc_mode.rfind("constexpr-memory=", 0) == 0) {
+                    constexpr_memory = strtoull(reloc_mode.substr(strlen("constexpr-memory=")).c_str(), nullptr, 10);
+                }
+                break;
+            case 'R':
+                arg_string = string(optarg);
+                if (arg_string.rfind("pass=", 0) == 0) {
+                    remark_pass = arg_string.substr(strlen("pass="));
+                } else if (arg_string.rfind("pass-missed=", 0) == 0) {
+                    remark_pass_missed = arg_string.substr(strlen("pass-missed="));
+                } else if (arg_string.rfind("pass-analysis=", 0) == 0) {
+                    remark_pass_analysis = arg_string.substr(strlen("pass-analysis="));
+                } else {
+                    cout << "unsupported remark option '-R" << arg_string << "'" << endl;
+                    exit(-1);
                 }
                 break;
             case 100:
@@ -176,6 +299,45 @@ void getOption(int argc, char **argv) {
                 }
                 package_path.push_back(string(arg_string));
                 break;
+            case 101:
+                // passed by parent compiler, used to detect circular import
+                import_chain.push_back(filesystem::weakly_canonical(filesystem::absolute(optarg)).string());
+                break;
+            case 256:
+                opt_time_report = true;
+                if (optarg && string(optarg) == "json") {
+                    opt_time_report_json = true;
+                } else if (optarg) {
+                    cout << "unsupported time report format '" << optarg << "'" << endl;
+                    exit(-1);
+                }
+                break;
+            case 257:
+                time_report_output = string(optarg);
+                break;
+            case 258:
+                opt_lto = true;
+                if (optarg && string(optarg) == "thin") {
+                    opt_thin_lto = true;
+                } else if (optarg && string(optarg) != "full") {
+                    cout << "unsupported lto mode '" << optarg << "'" << endl;
+                    exit(-1);
+                }
+                break;
+            case 261:
+                target_cpu = string(optarg);
+                break;
+            case 262:
+                if (!target_features.empty()) target_features += ",";
+                target_features += string(optarg);
+                break;
+            case 259:
+                t = filesystem::path(optarg);
+                jit_cache_path = filesystem::absolute(t).string();
+                break;
+            case 260:
+                opt_jit_cache = false;
+                break;
             default:
                 printf("error: unsupported option");
                 break;
@@ -192,7 +354,31 @@ int main(int argc, char **argv) {
     // add default search path
     include_path.emplace_back("/usr/include/avsi");
 
+    // -march and -mattr are long options, -m is --module for getopt
+    vector<string> machine_options;
+    machine_options.reserve(argc);
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--run") break;
+        if (strncmp(argv[i], "-march=", 7) == 0 || strncmp(argv[i], "-mattr=", 7) == 0) {
+            machine_options.push_back("-" + string(argv[i]));
+            argv[i] = machine_options.back().data();
+        }
+    }
+
+    // arguments after --run <file> belong to the program, getopt only
+    // sees the file
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--run") {
+            opt_run = true;
+            run_args.assign(argv + i + 1, argv + argc);
+            argv[i] = argv[i + 1];
+            argc = i + 1;
+            break;
+        }
+    }
+
     getOption(argc, argv);
+    library_path.emplace_back("/usr/lib");
 
     if (opt_help) {
         printHelp();
@@ -246,29 +432,14 @@ int main(int argc, char **argv) {
     extern uint16_t err_count;
     extern uint16_t warn_count;
 
-    // create lock file
-    std::filesystem::path dir = filesystem::path(input_file_path_absolut).filename();
-    string file_basename = input_file_name_no_suffix == MODULE_INIT_NAME ? dir.string() : input_file_name_no_suffix;
-    std::filesystem::path lock_file =
-            output_root_path + SYSTEM_PATH_DIVIDER + input_file_path_relative + SYSTEM_PATH_DIVIDER +
-            string(file_basename) + ".lock";
-    if (std::filesystem::exists(lock_file)) {
-        std::cerr << __COLOR_RED
-                  << input_file_name
-                  << ": File lock detected\n"
-                  << "please check dependencies between modules, circular dependencies are prohibited."
-                  << __COLOR_RESET
-                  << endl;
-        std::filesystem::remove(lock_file);
-        return -1;
-    } else {
-        ofstream os(lock_file, ios::app);
-        os << " ";
-        os.close();
-    }
+    time_report_init(filesystem::proximate(p, compiler_exec_path).string());
 
     try {
-        string preprocessed_file_name = llvm_emit_cpp();
+        string preprocessed_file_name;
+        {
+            TimeScope t("cpp");
+            preprocessed_file_name = llvm_emit_cpp();
+        }
         file.close();
         file.open(preprocessed_file_name, ios::in);
         if (!file.is_open()) {
@@ -279,15 +450,43 @@ int main(int argc, char **argv) {
 
         llvm_global_context_reset();
         llvm_machine_init();
-        llvm_module_fpm_init();
+        llvm_debug_init();
 
         Lexer *lexer = new Lexer(&file);
-        Parser *parser = new Parser(lexer);
-        shared_ptr<AST> tree = parser->parse();
+        shared_ptr<AST> tree;
+        {
+            TimeScope t("parse");
+            Parser *parser = new Parser(lexer);
+            tree = parser->parse();
+        }
         if(opt_dump) tree->dump(0);
         if (opt_reliance) return 0;
-        tree->codeGen();
-        llvm_run_optimization();
+        {
+            TimeScope t("codegen");
+            tree->codeGen();
+            llvm_debug_finalize();
+        }
+        // interface is taken before optimization removes unused declarations
+        if (err_count == 0 && !opt_run && (opt_module || input_file_name_no_suffix == MODULE_LIB_NAME)) {
+            TimeScope t("emit interface");
+            llvm_emit_interface();
+        }
+        if (err_count == 0 && !profile_generate_file.empty()) {
+            TimeScope t("profile instrument");
+            llvm_profile_instrument(profile_generate_file);
+        }
+        if (err_count == 0 && !profile_use_file.empty()) {
+            TimeScope t("profile use");
+            llvm_profile_annotate(profile_use_file);
+        }
+        if (err_count == 0) {
+            TimeScope t("target clones");
+            llvm_emit_target_clones();
+        }
+        {
+            TimeScope t("optimization");
+            llvm_run_optimization();
+        }
 
         if (err_count + warn_count != 0) {
             std::cerr << __COLOR_RESET
@@ -299,11 +498,34 @@ int main(int argc, char **argv) {
                       << __COLOR_RESET << std::endl;
         }
 
-        if (opt_ir) llvm_emit_ir();
-        if (opt_asm) llvm_emit_asm();
-        if (opt_module || input_file_name_no_suffix == MODULE_LIB_NAME) llvm_emit_bitcode();
-        //if (!(opt_ir || opt_asm))
-        llvm_emit_obj();
+        // let the importing compiler know, e.g. circular import
+        if (err_count != 0) {
+            time_report_emit();
+            return 1;
+        }
+
+        if (opt_ir) {
+            TimeScope t("emit ir");
+            llvm_emit_ir();
+        }
+        if (opt_run) {
+            int ret;
+            {
+                TimeScope t("run");
+                ret = llvm_jit_run(run_args);
+            }
+            time_report_emit();
+            return ret;
+        }
+        if (opt_lto || opt_module || input_file_name_no_suffix == MODULE_LIB_NAME) {
+            TimeScope t("emit bitcode");
+            llvm_emit_bitcode();
+        }
+        // object and assembly share one code generator run
+        if (!opt_lto) {
+            TimeScope t(opt_asm ? "emit obj & asm" : "emit obj");
+            llvm_emit_machine_code(opt_asm);
+        }
     } catch (Exception &e) {
         if (e.type() == __ErrReport) {
             std::cerr << __COLOR_RED
@@ -314,14 +536,13 @@ int main(int argc, char **argv) {
                       << warn_count << " warnings"
                       << __COLOR_RESET << std::endl;
         }
-        std::filesystem::remove(lock_file);
+        time_report_emit();
         return 1;
     } catch(...) {
-        std::filesystem::remove(lock_file);
+        time_report_emit();
         return 1;
     }
 
-    // remove lock
-    std::filesystem::remove(lock_file);
+    time_report_emit();
     return 0;
 }
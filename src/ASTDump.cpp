@@ -37,7 +37,7 @@ do { \
 
 namespace AVSI {
     // type name to be displayed in debug message
-    extern map<llvm::Type *, string> type_name;
+    extern TypeTable type_table;
 
     void printBlank(int depth) {
         for (int i = 0; i < depth; i++) {
@@ -45,6 +45,34 @@ namespace AVSI {
         }
     }
 
+    void printLoopHint(const LoopHint &hint, int depth) {
+        if (hint.empty()) return;
+        auto count = [](int n) { return n > 0 ? "(" + to_string(n) + ")" : string(""); };
+        printBlank(depth);
+        cout << "- hint:";
+        if (hint.unroll >= 0) cout << " unroll" << count(hint.unroll);
+        if (hint.vectorize >= 0) cout << " vectorize" << count(hint.vectorize);
+        if (hint.interleave >= 0) cout << " interleave" << count(hint.interleave);
+        if (hint.no_alias) cout << " no_alias";
+        cout << endl;
+    }
+
+    void printParallel(const ParallelLoop &parallel, int depth) {
+        if (!parallel.enabled) return;
+        static const char *schedule[] = {"static", "dynamic", "guided"};
+        printBlank(depth);
+        cout << "- parallel: " << schedule[parallel.schedule];
+        for (auto i: parallel.reductions) {
+            cout << " " << i.first << ":" << i.second.getValue().any_cast<string>();
+        }
+        cout << endl;
+        if (parallel.chunk) {
+            printBlank(depth);
+            cout << "- chunk:" << endl;
+            parallel.chunk->dump(depth);
+        }
+    }
+
     void Assign::dump(int depth) {
         printBlank(depth);
         PRINT_LINE_COLUNM();
@@ -85,6 +113,8 @@ namespace AVSI {
     void For::dump(int depth) {
         printBlank(depth);
         PRINT_LINE_COLUNM();
+        printLoopHint(this->hint, depth + 1);
+        printParallel(this->parallel, depth + 1);
         printBlank(depth + 1);
         cout << "- initList:" << endl;
         if (initList) this->initList->dump(depth + 1);
@@ -167,7 +197,7 @@ namespace AVSI {
             cout << "- function list:" << endl;
             for (auto i : this->func_list) {
                 printBlank(depth + 2);
-                cout << type_name[i.second.first] << ": " << i.first << endl;
+                cout << type_table.name(i.second.first) << ": " << i.first << endl;
             }
         }
 
@@ -338,6 +368,7 @@ namespace AVSI {
     void While::dump(int depth) {
         printBlank(depth);
         PRINT_LINE_COLUNM();
+        printLoopHint(this->hint, depth + 1);
         printBlank(depth + 1);
         cout << "- condition:" << endl;
         if (condition) this->condition->dump(depth + 1);
@@ -68,8 +68,6 @@ namespace AVSI {
     llvm::LLVMContext *the_context;
     llvm::Module *the_module;
     llvm::IRBuilder<> *builder;
-    llvm::legacy::FunctionPassManager *the_function_fpm;
-    llvm::legacy::PassManager *the_module_fpm;
     llvm::TargetMachine *TheTargetMachine;
 
     llvm::BasicBlock *global_insert_point;
@@ -95,8 +93,12 @@ namespace AVSI {
     SymbolTable *symbol_table;
     // store structure definitions. including members' name and type.
     map<string, StructDef *> struct_types;
+    // find definition of a struct by its llvm type
+    llvm::DenseMap<llvm::Type *, StructDef *> struct_defs;
     // store generic definitions. including function name and type.
     map<string, GenericDef *> generic_function;
+    // templates of generic functions, see CGGeneric.cpp
+    extern map<string, GenericTemplate *> function_templates;
     // store function defined in the context.
     map<std::string, llvm::FunctionType *> function_protos;
 
@@ -105,15 +107,15 @@ namespace AVSI {
     // map simple types to an integer
     map<llvm::Type *, uint8_t> simple_types_map;
 
-    // type name to be displayed in debug message
-    map<llvm::Type *, string> type_name;
-    // store size of specific type. for an array pointer, it will
-    // be the size of the space where the pointer point to
-    map<llvm::Type *, uint32_t> type_size;
+    // descriptors of types, including names and sizes
+    TypeTable type_table;
 
     // map a relative or renamed module path to absolute
     map<string, string> module_name_alias;
 
+    // bitcode files of imported modules, loaded lazily for cross-module inlining
+    set<string> imported_bitcode;
+
     // map token type to llvm simple type
     map<TokenType, llvm::Type *> token_to_simple_types;
 
@@ -208,30 +210,76 @@ namespace AVSI {
             if (
                     simple_types.find(l_type) == simple_types.end() ||
                     simple_types.find(r_type) == simple_types.end()) {
-                if (l_type->isVectorTy() && r_type->isVectorTy()) {
+                if (l_type->isVectorTy() || r_type->isVectorTy()) {
+                    // a scalar operand is broadcast to every element
+                    if (!l_type->isVectorTy()) {
+                        lv = type_conv(this, lv, l_type, r_type);
+                        l_type = r_type;
+                    } else if (!r_type->isVectorTy()) {
+                        rv = type_conv(this, rv, r_type, l_type);
+                        r_type = l_type;
+                    }
+
                     if (l_type != r_type) {
                         throw ExceptionFactory<MathException>(
-                            "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
-                            + "to vector expression",
+                            "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
+                            + "' to vector expression",
                             this->token.line, this->token.column
                         );
                     }
 
+                    bool float_point = l_type->isFPOrFPVectorTy();
                     switch (this->op.getType()) {
                     case PLUS:
-                        return builder->CreateAdd(lv, rv, "vadd");
+                        return float_point ? builder->CreateFAdd(lv, rv, "vadd") : builder->CreateAdd(lv, rv, "vadd");
                     case MINUS:
-                        return builder->CreateSub(lv, rv, "vsub");
+                        return float_point ? builder->CreateFSub(lv, rv, "vsub") : builder->CreateSub(lv, rv, "vsub");
                     case STAR:
-                        return builder->CreateMul(lv, rv, "vmul");
+                        return float_point ? builder->CreateFMul(lv, rv, "vmul") : builder->CreateMul(lv, rv, "vmul");
                     case SLASH:
-                        return builder->CreateFDiv(lv, rv, "vdiv");
+                        return float_point ? builder->CreateFDiv(lv, rv, "vdiv") : builder->CreateSDiv(lv, rv, "vdiv");
+                    case REM:
+                        return float_point ? builder->CreateFRem(lv, rv, "vrem") : builder->CreateSRem(lv, rv, "vrem");
+                    // comparisons give a mask, vec[bool:N]
+                    case EQ:
+                        return float_point ? builder->CreateFCmpOEQ(lv, rv, "veq") : builder->CreateICmpEQ(lv, rv, "veq");
+                    case NE:
+                        return float_point ? builder->CreateFCmpONE(lv, rv, "vne") : builder->CreateICmpNE(lv, rv, "vne");
+                    case GT:
+                        return float_point ? builder->CreateFCmpOGT(lv, rv, "vgt") : builder->CreateICmpSGT(lv, rv, "vgt");
+                    case LT:
+                        return float_point ? builder->CreateFCmpOLT(lv, rv, "vlt") : builder->CreateICmpSLT(lv, rv, "vlt");
+                    case GE:
+                        return float_point ? builder->CreateFCmpOGE(lv, rv, "vge") : builder->CreateICmpSGE(lv, rv, "vge");
+                    case LE:
+                        return float_point ? builder->CreateFCmpOLE(lv, rv, "vle") : builder->CreateICmpSLE(lv, rv, "vle");
+                    default:
+                        break;
+                    }
+
+                    if (float_point) {
+                        throw ExceptionFactory<MathException>(
+                            "unsupported operation " + token_name[this->op.getType()] + " to floating point vector expression",
+                            this->token.line, this->token.column
+                        );
+                    }
+
+                    switch (this->op.getType()) {
+                    case BITAND:
+                        return builder->CreateAnd(lv, rv, "vbitand");
+                    case BITOR:
+                        return builder->CreateOr(lv, rv, "vbitor");
+                    case SHL:
+                        return builder->CreateShl(lv, rv, "vshl");
+                    case SHR:
+                        return builder->CreateAShr(lv, rv, "vshr");
+                    case SHRU:
+                        return builder->CreateLShr(lv, rv, "vshr");
                     default:
                         throw ExceptionFactory<MathException>(
-                            "unsupported operation " + token_name[this->token.getType()] + "to vector expression",
+                            "unsupported operation " + token_name[this->op.getType()] + " to vector expression",
                             this->token.line, this->token.column
                         );
-                    // TODO more operation
                     }
                 } else {
                     return nullptr;
@@ -358,7 +406,7 @@ namespace AVSI {
                 case BITOR:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to bitor expression",
                                 this->token.line, this->token.column);
                     else
@@ -366,7 +414,7 @@ namespace AVSI {
                 case BITAND:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to bitand expression",
                                 this->token.line, this->token.column);
                     else
@@ -374,7 +422,7 @@ namespace AVSI {
                 case SHL:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to shift expression",
                                 this->token.line, this->token.column);
                     else
@@ -382,7 +430,7 @@ namespace AVSI {
                 case SHR:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to shift expression",
                                 this->token.line, this->token.column);
                     else
@@ -390,7 +438,7 @@ namespace AVSI {
                 case SHRU:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to shift expression",
                                 this->token.line, this->token.column);
                     else
@@ -398,7 +446,7 @@ namespace AVSI {
                 case REM:
                     if (float_point)
                         throw ExceptionFactory<MathException>(
-                                "unsupported type '" + type_name[l_type] + "' and '" + type_name[r_type]
+                                "unsupported type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type)
                                 + "to remainder expression",
                                 this->token.line, this->token.column);
                     else
@@ -510,6 +558,8 @@ namespace AVSI {
     }
 
     llvm::Value *For::codeGen() {
+        if (this->parallel.enabled) return llvm_parallel_for(this);
+
         llvm::Function *the_function = builder->GetInsertBlock()->getParent();
 
         llvm::BasicBlock *headBB = llvm::BasicBlock::Create(*the_context, "loop.head", the_function);
@@ -527,12 +577,14 @@ namespace AVSI {
             return nullptr;
         }
 
+        llvm::BasicBlock *preheaderBB = builder->GetInsertBlock();
         builder->CreateBr(headBB);
 
 //        the_function->getBasicBlockList().push_back(headBB);
         builder->SetInsertPoint(headBB);
 
         if (!this->noCondition) {
+            llvm_debug_location(this->token.line, this->token.column);
             llvm::Value *cond = this->condition->codeGen();
             if (!cond) {
                 return nullptr;
@@ -554,8 +606,8 @@ namespace AVSI {
                 }
             }
 
+            // back edge goes to headBB, where the condition starts
             builder->CreateCondBr(cond, loopBB, mergeBB);
-            headBB = builder->GetInsertBlock();
         } else {
             builder->CreateBr(loopBB);
         }
@@ -578,6 +630,7 @@ namespace AVSI {
 
         the_function->getBasicBlockList().push_back(adjBB);
         builder->SetInsertPoint(adjBB);
+        llvm_debug_location(this->token.line, this->token.column);
 
         llvm::Value *adjust = this->adjustment->codeGen();
         if (!((static_pointer_cast<Compound>(this->adjustment))->child.empty()) && (!adjust)) {
@@ -589,6 +642,7 @@ namespace AVSI {
         if (!t) {
             builder->CreateBr(headBB);
         }
+        llvm_set_loop_hint(this->hint, headBB, preheaderBB);
 
         the_function->getBasicBlockList().push_back(mergeBB);
         builder->SetInsertPoint(mergeBB);
@@ -634,7 +688,7 @@ namespace AVSI {
             }
 
             struct_type = ty.first->second->Ty;
-            auto struct_name = type_name[struct_type];
+            auto struct_name = type_table.name(struct_type);
             auto index = struct_name.find('{');
             string part = struct_name.substr(0, index);
             struct_path = getpathUnresolvedToList(part);
@@ -723,6 +777,10 @@ namespace AVSI {
                 the_function->addFnAttr(llvm::Attribute::WillReturn);
             }
 
+            if (!this->target_clones.empty()) {
+                llvm_set_target_clones(the_function, this->target_clones, this->token.line, this->token.column);
+            }
+
             uint8_t param_index = 0;
             auto args_iter = the_function->args().begin();
 
@@ -750,12 +808,13 @@ namespace AVSI {
             symbol_table->setLoopEntry(nullptr);
             symbol_table->setLoopExit(nullptr);
             builder->SetInsertPoint(BB);
+            symbol_table->setDebugScope(llvm_debug_function(the_function, this->id, this->token.line));
 
             // initialize param
             for (auto &arg: the_function->args()) {
                 llvm::AllocaInst *alloca = allocaBlockEntry(the_function, arg.getName().str() + ".addr", arg.getType());
                 builder->CreateStore(&arg, alloca);
-                symbol_table->insert(arg.getName().str(), alloca, true);
+                symbol_table->insert(arg.getName().str(), alloca, true, arg.getArgNo() + 1);
             }
 
             llvm::Value *ret = nullptr;
@@ -781,15 +840,15 @@ namespace AVSI {
                                     && simple_types.find(the_function->getReturnType()) != simple_types.end()
                                     ) {
                                 throw ExceptionFactory<LogicException>(
-                                        "unmatched return type '" + type_name[ret->getType()]
-                                        + "', excepted '" + type_name[the_function->getReturnType()] + "'."
+                                        "unmatched return type '" + type_table.name(ret->getType())
+                                        + "', excepted '" + type_table.name(the_function->getReturnType()) + "'."
                                         + "This return expression cause a loss of precision",
                                         this->getToken().line, this->getToken().column
                                 );
                             }
                             throw ExceptionFactory<LogicException>(
-                                    "unmatched return type '" + type_name[ret->getType()]
-                                    + "', excepted '" + type_name[the_function->getReturnType()] + "'."
+                                    "unmatched return type '" + type_table.name(ret->getType())
+                                    + "', excepted '" + type_table.name(the_function->getReturnType()) + "'."
                                     + "please check return expression",
                                     this->getToken().line, this->getToken().column
                             );
@@ -804,18 +863,23 @@ namespace AVSI {
                     }
                 }
                 symbol_table->pop();
+                llvm_debug_function_end(the_function);
+                eraseDeadAggregateLoads(the_function);
 
                 if (llvm::verifyFunction(*the_function, &llvm::outs())) {
                     throw ExceptionFactory<IRErrException>(
                             "some errors occurred when generating function",
                             this->token.line, this->token.column);
                 }
-                the_function_fpm->run(*the_function);
-                the_function_fpm->run(*the_function);
                 if (last_BB != nullptr) {
                     builder->SetInsertPoint(last_BB, last_pt);
                 }
 
+                if (symbol_table->depth() == 0) {
+                    // bodies of generic functions used by this one
+                    llvm_instantiate_pending();
+                }
+
                 return the_function;
             }
             symbol_table->pop();
@@ -844,36 +908,7 @@ namespace AVSI {
         /* generate function names */
         vector<string> func_names;
         if (!fun) {
-            if (modinfo.empty()) {
-                // function in currnet module
-                func_names.push_back(getFunctionNameMangling(module_path_with_module_name, this->id));
-            } else if (modinfo[0] == "root") {
-                // absolute path
-                vector<string> p;
-                modinfo.erase(modinfo.begin());
-                p.insert(p.end(), package_path.begin(), package_path.end());
-                p.insert(p.end(), modinfo.begin(), modinfo.end());
-                func_names.push_back(getFunctionNameMangling(p, this->id));
-            } else {
-                // may be relative path
-                auto fun_path = module_path;
-                fun_path.insert(fun_path.end(), modinfo.begin(), modinfo.end());
-                func_names.push_back(getFunctionNameMangling(fun_path, this->id));
-                // may be alias
-                string head = modinfo[0];
-                if (module_name_alias.find(head) != module_name_alias.end()) {
-                    auto path_cut = modinfo;
-                    path_cut.erase(path_cut.begin());
-                    head = module_name_alias[head];
-                    auto head_to_origin = getpathUnresolvedToList(head);
-                    for (auto i: path_cut) {
-                        head_to_origin.push_back(i);
-                    }
-                    func_names.push_back(getFunctionNameMangling(head_to_origin, this->id));
-                }
-                // may be absolute
-                func_names.push_back(getFunctionNameMangling(modinfo, this->id));
-            }
+            func_names = getFunctionNameCandidates(modinfo, this->id);
         }
         func_names.push_back(this->id);
 
@@ -888,18 +923,29 @@ namespace AVSI {
             // may be generic function
             for (auto i: func_names) {
                 if (generic_function.find(i) != generic_function.end()) {
-                    int idx = generic_function[i]->idx;
-                    auto arg_type_name = type_name[caller_args[idx]->getType()];
+                    GenericDef *gd = generic_function[i];
+                    llvm::Type *arg_type = caller_args[gd->idx]->getType();
+                    uint32_t arg_type_id = type_table.id(arg_type);
+
+                    auto mapped = gd->function_map.find(arg_type_id);
+                    if (mapped == gd->function_map.end() && !gd->imported_map.empty()) {
+                        // imported functions are known by type name
+                        auto imported = gd->imported_map.find(type_table.name(arg_type));
+                        if (imported != gd->imported_map.end()) {
+                            mapped = gd->function_map.insert({arg_type_id, imported->second}).first;
+                            gd->imported_map.erase(imported);
+                        }
+                    }
+                    if (mapped == gd->function_map.end()) {
+                        mapped = gd->function_map.find(type_table.id(nullptr));
+                    }
 
-                    if (generic_function[i]->function_map.find(arg_type_name) != generic_function[i]->function_map.end()) {
-                        fun = the_module->getFunction(generic_function[i]->function_map[arg_type_name]);
-                        break;
-                    } else if (generic_function[i]->function_map.find("default") != generic_function[i]->function_map.end()){
-                        fun = the_module->getFunction(generic_function[i]->function_map["default"]);
+                    if (mapped != gd->function_map.end()) {
+                        fun = the_module->getFunction(mapped->second);
                         break;
                     } else {
                         throw ExceptionFactory<MissingException>(
-                            "function '" + this->id + "' is not declared for type '" + arg_type_name + "'",
+                            "function '" + this->id + "' is not declared for type '" + type_table.name(arg_type) + "'",
                             this->getToken().line, this->getToken().column
                         );
                     }
@@ -907,6 +953,26 @@ namespace AVSI {
             }
         }
 
+        bool instantiated = false;
+        if (!fun && this->param_this == nullptr) {
+            // may be template of generic function
+            for (auto &i: func_names) {
+                auto gt = function_templates.find(i);
+                if (gt != function_templates.end()) {
+                    fun = llvm_instantiate_function(gt->second, this->type_args, caller_args, this->getToken());
+                    instantiated = true;
+                    break;
+                }
+            }
+        }
+
+        if (!this->type_args.empty() && !instantiated) {
+            throw ExceptionFactory<TypeException>(
+                "function '" + this->id + "' is not generic",
+                this->getToken().line, this->getToken().column
+            );
+        }
+
         bool implicit = false;
 
         if (!fun) {
@@ -958,7 +1024,7 @@ namespace AVSI {
             if (callee_arg_iter->getType() != this->param_this->getType()) {
                 throw ExceptionFactory<MissingException>(
                         this->id + "is not a matched member function for type"
-                        + type_name[this->param_this->getType()->getPointerElementType()],
+                        + type_table.name(this->param_this->getType()->getPointerElementType()),
                         this->token.line, this->token.column);
             }
             callee_arg_iter++;
@@ -974,16 +1040,13 @@ namespace AVSI {
             llvm::Type *callee_type = callee_arg_iter == fun->args().end() ? nullptr : callee_arg_iter->getType();
             llvm::Type *caller_type = v->getType();
 
-            if (callee_arg_iter != fun->args().end() && type_size.find(callee_type) == type_size.end()) registerType(callee_type);
-            if (type_size.find(caller_type) == type_size.end()) registerType(caller_type);
-
             if (caller_type->isArrayTy()) {
                 llvm::AllocaInst *addr = (llvm::AllocaInst *) llvm::getLoadStorePointerOperand(v);
 
                 if (!addr) {
                     llvm::Function *the_scope = builder->GetInsertBlock()->getParent();
                     addr = allocaBlockEntry(the_scope, "array.init", caller_type);
-                    builder->CreateStore(v, addr);
+                    storeAggregate(v, addr);
                 }
 
                 v = builder->CreateInBoundsGEP(
@@ -997,7 +1060,6 @@ namespace AVSI {
                 );
 
                 caller_type = v->getType();
-                if (type_size.find(caller_type) == type_size.end()) registerType(caller_type);
             } else if (
                 caller_type->isStructTy() &&
                 (
@@ -1028,15 +1090,14 @@ namespace AVSI {
 
                 v = builder->CreatePointerCast(v, caller_type->getPointerTo());                
                 caller_type = v->getType();
-                if (type_size.find(caller_type) == type_size.end()) registerType(caller_type);
             } else if ((callee_arg_iter == fun->args().end()) && caller_type->isFloatingPointTy()) {
                 try {
                     v = type_conv(arg.get(), v, caller_type, llvm::Type::getDoubleTy(*the_context), false);
                 } catch (...) {
                     throw ExceptionFactory<TypeException>(
                             "unmatched type, provided: " +
-                            type_name[caller_type] +
-                            ", excepted: " + type_name[callee_arg_iter->getType()],
+                            type_table.name(caller_type) +
+                            ", excepted: " + type_table.name(callee_arg_iter->getType()),
                             arg->getToken().line, arg->getToken().column);
                 }
             } else if ((callee_arg_iter != fun->args().end()) && callee_type != caller_type) {
@@ -1045,8 +1106,8 @@ namespace AVSI {
                 } catch (...) {
                     throw ExceptionFactory<TypeException>(
                             "unmatched type, provided: " +
-                            type_name[caller_type] +
-                            ", excepted: " + type_name[callee_arg_iter->getType()],
+                            type_table.name(caller_type) +
+                            ", excepted: " + type_table.name(callee_arg_iter->getType()),
                             arg->getToken().line, arg->getToken().column);
                 }
             }
@@ -1060,6 +1121,20 @@ namespace AVSI {
             caller_args.insert(caller_args.begin(), this->param_this);
         }
 
+        // pure function with constant arguments is evaluated by compiler
+        if (!implicit && fun->doesNotAccessMemory()) {
+            string reason;
+            llvm::Constant *ret = llvm_const_eval(fun, caller_args, reason);
+            if (ret) {
+                return ret;
+            } else if (!builder->GetInsertBlock()) {
+                Warning(
+                    "'" + this->id + "' can't be evaluated at compile time: " + reason,
+                    this->getToken().line, this->getToken().column
+                );
+            }
+        }
+
         llvm::CallInst *inst = nullptr;
 
         if (implicit) {
@@ -1134,7 +1209,7 @@ namespace AVSI {
                 }
 
                 struct_type = ty.first->second->Ty;
-                auto struct_name = type_name[struct_type];
+                auto struct_name = type_table.name(struct_type);
                 auto index = struct_name.find('{');
                 string part = struct_name.substr(0, index);
                 struct_path = getpathUnresolvedToList(part);
@@ -1162,7 +1237,7 @@ namespace AVSI {
         for (auto i: this->func_list) {
             string mapped_func_name = get_func_name(i.first, parent_modinfo, this->token);
 
-            string ty_name = type_name[i.second.first];
+            string ty_name = type_table.name(i.second.first);
 
             llvm::Metadata *md_args[] = {
                     llvm::MDString::get(*the_context, mapped_func_name),
@@ -1170,7 +1245,7 @@ namespace AVSI {
             };            
 
             meta->addOperand(llvm::MDNode::get(*the_context, md_args));
-            gd->function_map[ty_name] = mapped_func_name;
+            gd->function_map[type_table.id(i.second.first)] = mapped_func_name;
         }
 
         if (!this->default_func.empty()) {
@@ -1180,7 +1255,7 @@ namespace AVSI {
             };            
 
             meta->addOperand(llvm::MDNode::get(*the_context, md_args));
-            gd->function_map["default"] = this->default_func;
+            gd->function_map[type_table.id(nullptr)] = this->default_func;
         }
 
         generic_function[mapper_func_name] = gd;
@@ -1273,8 +1348,6 @@ namespace AVSI {
                 contain_type = I8_TY;
             }
             llvm::Type *ptr_type = contain_type->getPointerTo();
-            type_name[ptr_type] = type_name[contain_type] + "*";
-            type_size[ptr_type] = PTR_SIZE;
             auto nullptr_init = llvm::ConstantInt::get(ISIZE_TY, 0);
             return builder->CreateIntToPtr(nullptr_init, ptr_type);
         }
@@ -1291,11 +1364,6 @@ namespace AVSI {
         if (this->Ty.first != VOID_TY) {
             if (!this->is_vec) {
                 auto arr_type = llvm::ArrayType::get(this->Ty.first, element_num);
-                type_name[arr_type] = "arr[" + type_name[this->Ty.first] + ":" + to_string(element_num) + "]";
-                type_name[arr_type->getPointerTo()] =
-                        "arr[" + type_name[this->Ty.first] + ":" + to_string(element_num) + "]*";
-                type_size[arr_type] = type_size[this->Ty.first] * element_num;
-                type_size[arr_type->getPointerTo()] = PTR_SIZE;
                 if (is_in_function) {
                     llvm::AllocaInst *array_alloca = allocaBlockEntry(the_scope, "array.init.by.type", arr_type);
                     builder->CreateMemSet(
@@ -1303,7 +1371,7 @@ namespace AVSI {
                             llvm::ConstantInt::get(
                                     llvm::Type::getInt8Ty(*the_context),
                                     0),
-                            type_size[arr_type],
+                            type_table.size(arr_type),
                             llvm::MaybeAlign());
 
                     return builder->CreateLoad(arr_type, array_alloca);
@@ -1312,11 +1380,6 @@ namespace AVSI {
                 }
             } else {
                 auto vec_type = llvm::VectorType::get(this->Ty.first, element_num, false);
-                type_name[vec_type] = "vec[" + type_name[this->Ty.first] + ":" + to_string(element_num) + "]";
-                type_name[vec_type->getPointerTo()] =
-                        "vec[" + type_name[this->Ty.first] + ":" + to_string(element_num) + "]*";
-                type_size[vec_type] = type_size[this->Ty.first] * element_num;
-                type_size[vec_type->getPointerTo()] = PTR_SIZE;
 
                 if (is_in_function) {
                     llvm::AllocaInst *array_alloca = allocaBlockEntry(the_scope, "vector.init.by.type", vec_type);
@@ -1325,7 +1388,7 @@ namespace AVSI {
                             llvm::ConstantInt::get(
                                     llvm::Type::getInt8Ty(*the_context),
                                     0),
-                            type_size[vec_type],
+                            type_table.size(vec_type),
                             llvm::MaybeAlign());
 
                     return builder->CreateLoad(vec_type, array_alloca);
@@ -1335,6 +1398,37 @@ namespace AVSI {
             }
         }
 
+        /**
+         * a vector is built from its elements by insertelement, elements are
+         * converted to the type of the first one
+         */
+        if (this->is_vec) {
+            llvm::Value *head_rv = this->paramList[0]->codeGen();
+            auto eleTy = head_rv->getType();
+            if (simple_types.find(eleTy) == simple_types.end()) {
+                throw ExceptionFactory<LogicException>(
+                        "element of vector type must be simple",
+                        this->paramList[0]->getToken().line, this->paramList[0]->getToken().column);
+            }
+
+            llvm::Value *vec = llvm::UndefValue::get(llvm::FixedVectorType::get(eleTy, element_num));
+            for (int i = 0; i < element_num; i++) {
+                shared_ptr<AST> param = this->paramList[i];
+                llvm::Value *rv = i == 0 ? head_rv : param->codeGen();
+                if (rv->getType() != eleTy) {
+                    rv = type_conv(param.get(), rv, rv->getType(), eleTy, false);
+                }
+                vec = builder->CreateInsertElement(vec, rv, (uint64_t) i, "vector.init");
+            }
+
+            if (!is_in_function && !llvm::isa<llvm::Constant>(vec)) {
+                throw ExceptionFactory<LogicException>(
+                        "vector initializer must be a compile-time constant",
+                        this->getToken().line, this->getToken().column);
+            }
+            return vec;
+        }
+
         bool is_const_array = true;
         bool is_char_array = true;
 
@@ -1359,16 +1453,12 @@ namespace AVSI {
         if (is_const_array) {
             // create a constant data array for constant array
             llvm::Constant *arr = nullptr;
-            llvm::Type *tname;
-            ::size_t tsize;
             if (is_char_array) {
                 string str;
                 for (auto i: this->paramList) {
                     str += (static_pointer_cast<Num>(i))->getToken().getValue().any_cast<char>();
                 }
                 arr = llvm::ConstantDataArray::getString(*the_context, str);
-                tname = I8_TY;
-                tsize = type_size[I8_TY];
                 element_num += 1;
             } else {
                 if (const__number_array_type == DataType::Integer) {
@@ -1377,41 +1467,21 @@ namespace AVSI {
                         data.push_back((static_pointer_cast<Num>(i))->getToken().getValue().any_cast<int>());
                     }
                     arr = llvm::ConstantDataArray::get(*the_context, data);
-                    tname = I32_TY;
-                    tsize = type_size[I32_TY];
                 } else {
                     vector<float> data;
                     for (auto i: this->paramList) {
                         data.push_back((static_pointer_cast<Num>(i))->getToken().getValue().any_cast<double>());
                     }
                     arr = llvm::ConstantDataArray::get(*the_context, data);
-                    tname = F32_TY;
-                    tsize = type_size[F32_TY];
                 }
             }
 
-            type_name[arr->getType()] = "arr[" + type_name[tname] + ":" + to_string(element_num) + "]";
-            type_name[arr->getType()->getPointerTo()] = "arr[" + type_name[tname] + ":" + to_string(element_num) + "]*";
-            type_size[arr->getType()] = tsize * element_num;
-
             if (is_in_function) {
-                string global_var_name = string("__constant.") + string(builder->GetInsertBlock()->getParent()->getName()) + string(".arr");
-                llvm::function_ref<llvm::GlobalVariable *()> global_var_callback = [&] {
-                    return new llvm::GlobalVariable(
-                            *the_module,
-                            arr->getType(),
-                            false,
-                            llvm::GlobalVariable::LinkageTypes::PrivateLinkage,
-                            arr,
-                            global_var_name);
-                };
-                auto ptr = the_module->getOrInsertGlobal(
-                        global_var_name,
-                        (llvm::Type *) arr->getType(),
-                        global_var_callback
-                );
+                // every evaluation makes a new array, copied from the constant
+                llvm::AllocaInst *array_alloca = allocaBlockEntry(the_scope, "array.init.by.const", arr->getType());
+                storeAggregate(arr, array_alloca);
 
-                return builder->CreateLoad(arr->getType(), ptr);
+                return builder->CreateLoad(arr->getType(), array_alloca);
             } else {
                 return arr;
             }
@@ -1422,14 +1492,6 @@ namespace AVSI {
                 auto eleTy = head_rv->getType();
                 auto arr_type = llvm::ArrayType::get(eleTy, element_num + 1);
 
-                if (type_size.find(eleTy) == type_size.end()) {
-                    registerType(eleTy);
-                }
-
-                type_name[arr_type] = "arr[" + type_name[eleTy] + ":" + to_string(element_num) + "]";
-                type_name[arr_type->getPointerTo()] = "arr[" + type_name[eleTy] + ":" + to_string(element_num) + "]*";
-                type_size[arr_type] = (eleTy->isPointerTy() ? PTR_SIZE : type_size[eleTy]) * element_num;
-
                 // initialize array
                 llvm::AllocaInst *array_alloca = allocaBlockEntry(the_scope, "array.init.by.value", arr_type);
 
@@ -1442,7 +1504,11 @@ namespace AVSI {
                                 llvm::ConstantInt::get(ISIZE_TY, 0),
                         },
                         "Array.init.element." + to_string(0));
-                builder->CreateStore(head_rv, first_element_addr);
+                if (eleTy->isAggregateType()) {
+                    storeAggregate(head_rv, first_element_addr);
+                } else {
+                    builder->CreateStore(head_rv, first_element_addr);
+                }
 
                 // initialize other elements
                 for (int i = 1; i < element_num; i++) {
@@ -1463,13 +1529,17 @@ namespace AVSI {
                         } catch (...) {
                             throw ExceptionFactory<TypeException>(
                                     "not matched type, element type: " +
-                                    type_name[rv->getType()] +
-                                    ", array type: " + type_name[eleTy],
+                                    type_table.name(rv->getType()) +
+                                    ", array type: " + type_table.name(eleTy),
                                     param->getToken().line, param->getToken().column);
                         }
                     }
 
-                    builder->CreateStore(rv, element_addr);
+                    if (eleTy->isAggregateType()) {
+                        storeAggregate(rv, element_addr);
+                    } else {
+                        builder->CreateStore(rv, element_addr);
+                    }
                 }
 
                 // add NULL to tail
@@ -1481,14 +1551,49 @@ namespace AVSI {
                                 llvm::ConstantInt::get(llvm::Type::getInt32Ty(*the_context), element_num),
                         },
                         "ArrayInit.element.tail");
-                builder->CreateStore(llvm::Constant::getNullValue(eleTy), element_addr);
+                if (eleTy->isAggregateType()) {
+                    storeAggregate(llvm::Constant::getNullValue(eleTy), element_addr);
+                } else {
+                    builder->CreateStore(llvm::Constant::getNullValue(eleTy), element_addr);
+                }
 
                 return builder->CreateLoad(arr_type, array_alloca);
             } else {
-                throw ExceptionFactory<LogicException>(
-                    "array initializer must be a compile-time constant",
-                    this->getToken().line, this->getToken().column
-                );
+                // elements are computed at compile time, e.g. by pure functions
+                vector<llvm::Constant *> elements;
+                llvm::Type *eleTy = nullptr;
+                for (int i = 0; i < element_num; i++) {
+                    shared_ptr<AST> param = this->paramList[i];
+                    llvm::Value *rv = param->codeGen();
+
+                    if (eleTy && rv->getType() != eleTy) {
+                        try {
+                            rv = type_conv(param.get(), rv, rv->getType(), eleTy, false);
+                        } catch (...) {
+                            throw ExceptionFactory<TypeException>(
+                                    "not matched type, element type: " +
+                                    type_table.name(rv->getType()) +
+                                    ", array type: " + type_table.name(eleTy),
+                                    param->getToken().line, param->getToken().column);
+                        }
+                    }
+
+                    auto element = llvm::dyn_cast<llvm::Constant>(rv);
+                    if (!element) {
+                        throw ExceptionFactory<LogicException>(
+                            "array initializer must be a compile-time constant",
+                            param->getToken().line, param->getToken().column
+                        );
+                    }
+                    eleTy = element->getType();
+                    elements.push_back(element);
+                }
+
+                // add NULL to tail
+                elements.push_back(llvm::Constant::getNullValue(eleTy));
+                auto arr_type = llvm::ArrayType::get(eleTy, element_num + 1);
+
+                return llvm::ConstantArray::get(arr_type, elements);
             }
         }
     }
@@ -1516,6 +1621,11 @@ namespace AVSI {
         llvm::Constant *init = v->Ty.first == VOID_TY ? nullptr : llvm::Constant::getNullValue(v->Ty.first);
 
         if (this->expr != nullptr) {
+            // initializer is not a part of the function generated before
+            auto last_BB = builder->GetInsertBlock();
+            auto last_pt = builder->GetInsertPoint();
+            builder->ClearInsertionPoint();
+
             try {
                 auto right = this->expr->codeGen();
                 init = llvm::dyn_cast<llvm::Constant>(right);
@@ -1529,6 +1639,10 @@ namespace AVSI {
                         "initializer element is not a compile-time constant",
                         this->getToken().line, this->getToken().column);
             }
+
+            if (last_BB != nullptr) {
+                builder->SetInsertPoint(last_BB, last_pt);
+            }
         }
 
         auto g_type = init->getType();
@@ -1741,10 +1855,24 @@ namespace AVSI {
     }
 
     llvm::Value *Object::codeGen() {
+        auto def = struct_types.find(this->id);
+        if (def != struct_types.end()) llvm_debug_struct(def->second->Ty, this->token.line);
         return llvm::ConstantFP::getNaN(F64_TY);
     }
 
     llvm::Value *UnaryOp::codeGen() {
+        // address of a function, e.g. the body of a task
+        if (this->op.getType() == BITAND && this->right->__AST_name == __VARIABLE_NAME) {
+            auto var = static_pointer_cast<Variable>(this->right);
+            if (var->offset.empty() && !symbol_table->find(var->id)) {
+                vector<string> func_names = getFunctionNameCandidates(var->getToken().getModInfo(), var->id);
+                func_names.push_back(var->id);
+                for (auto &i: func_names) {
+                    if (llvm::Function *fun = the_module->getFunction(i)) return fun;
+                }
+            }
+        }
+
         llvm::Value *rv = this->right->codeGen();
         if (!rv) {
             throw ExceptionFactory<LogicException>(
@@ -1769,7 +1897,7 @@ namespace AVSI {
         if (this->op.getType() == STAR) {
             if (!ty->isPtrOrPtrVectorTy()) {
                 throw ExceptionFactory<MathException>(
-                        "type '" + type_name[ty] + "' must be pointer type",
+                        "type '" + type_table.name(ty) + "' must be pointer type",
                         this->token.line, this->token.column);
             }
 
@@ -1778,7 +1906,7 @@ namespace AVSI {
 
         if (simple_types.find(ty) == simple_types.end()) {
             throw ExceptionFactory<MathException>(
-                    "unsupported type '" + type_name[ty] + "' to unary expression",
+                    "unsupported type '" + type_table.name(ty) + "' to unary expression",
                     this->token.line, this->token.column);
         }
 
@@ -1797,7 +1925,7 @@ namespace AVSI {
         } else if (this->op.getType() == BITCPL) {
             if (float_point)
                 throw ExceptionFactory<MathException>(
-                        "unsupported type '" + type_name[ty] + "' to bit complement expression",
+                        "unsupported type '" + type_table.name(ty) + "' to bit complement expression",
                         this->token.line, this->token.column);
             else
                 return builder->CreateXor(rv, llvm::ConstantInt::get(ty, -1), "complement");
@@ -1822,11 +1950,11 @@ namespace AVSI {
                 return llvm::ConstantInt::get(I32_TY, PTR_SIZE);
             } else {
                 // non-pointer type
-                return llvm::ConstantInt::get(I32_TY, type_size[type]);
+                return llvm::ConstantInt::get(I32_TY, type_table.size(type));
             }
         }
 
-        return llvm::ConstantInt::get(I32_TY, type_size[this->Ty.first]);
+        return llvm::ConstantInt::get(I32_TY, type_table.size(this->Ty.first));
     }
 
     llvm::Value *String::codeGen() {
@@ -1856,7 +1984,9 @@ namespace AVSI {
         }
 
         if (builder->GetInsertBlock()) {
-            return builder->CreateLoad(v->getType()->getPointerElementType(), v, this->id.c_str());
+            llvm::LoadInst *load = builder->CreateLoad(v->getType()->getPointerElementType(), v, this->id.c_str());
+            llvm_vector_access_align(load, v);
+            return load;
         } else {
             throw ExceptionFactory<MissingException>(
                 "cannot get the value of variable '" + this->id + "' out of function",
@@ -1877,6 +2007,7 @@ namespace AVSI {
         for (shared_ptr<AST> ast: this->child) {
             try {
                 llvm::BasicBlock *bb = builder->GetInsertBlock();
+                llvm_debug_location(ast->getToken().line, ast->getToken().column);
                 if (ast->__AST_name == __COMPOUND_NAME && bb) {
                     symbol_table->push(bb);
                 }
@@ -1900,6 +2031,7 @@ namespace AVSI {
                         && ast->__AST_name != __FUNCTIONDECL_NAME
                         && ast->__AST_name != __OBJECT_NAME
                         && ast->__AST_name != __GENERIC_NAME
+                        && ast->__AST_name != __GLOBAL_NAME
                         && (
                                 (
                                         builder->GetInsertBlock()
@@ -1947,6 +2079,12 @@ namespace AVSI {
     }
 
     llvm::Value *Return::codeGen() {
+        if (llvm_is_parallel_body(builder->GetInsertBlock()->getParent())) {
+            throw ExceptionFactory<LogicException>(
+                    "return is not allowed in parallel for",
+                    this->token.line, this->token.column);
+        }
+
         if (this->ret != nullptr) {
             llvm::Value *re = this->ret->codeGen();
             if (!re) {
@@ -1967,15 +2105,15 @@ namespace AVSI {
                             && simple_types.find(the_scope->getReturnType()) != simple_types.end()
                             ) {
                         throw ExceptionFactory<LogicException>(
-                                "unmatched return type '" + type_name[re->getType()]
-                                + "', excepted '" + type_name[the_scope->getReturnType()] + "'."
+                                "unmatched return type '" + type_table.name(re->getType())
+                                + "', excepted '" + type_table.name(the_scope->getReturnType()) + "'."
                                 + "This return expression cause a loss of precision",
                                 this->getToken().line, this->getToken().column
                         );
                     }
                     throw ExceptionFactory<LogicException>(
-                            "unmatched return type '" + type_name[re->getType()]
-                            + "', excepted '" + type_name[the_scope->getReturnType()] + "'."
+                            "unmatched return type '" + type_table.name(re->getType())
+                            + "', excepted '" + type_table.name(the_scope->getReturnType()) + "'."
                             + "please check return expression",
                             this->getToken().line, this->getToken().column
                     );
@@ -1996,6 +2134,7 @@ namespace AVSI {
         llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*the_context, "loop.body");
         llvm::BasicBlock *mergeBB = llvm::BasicBlock::Create(*the_context, "loop.end");
 
+        llvm::BasicBlock *preheaderBB = builder->GetInsertBlock();
         builder->CreateBr(headBB);
 
         builder->SetInsertPoint(headBB);
@@ -2004,6 +2143,7 @@ namespace AVSI {
         symbol_table->setLoopExit(mergeBB);
         symbol_table->setLoopEntry(headBB);
 
+        llvm_debug_location(this->token.line, this->token.column);
         llvm::Value *cond = this->condition->codeGen();
         if (!cond) {
             return nullptr;
@@ -2039,6 +2179,7 @@ namespace AVSI {
         if (!t) {
             builder->CreateBr(headBB);
         }
+        llvm_set_loop_hint(this->hint, headBB, preheaderBB);
 
         the_function->getBasicBlockList().push_back(mergeBB);
         builder->SetInsertPoint(mergeBB);
@@ -0,0 +1,751 @@
+/*
+ * CGConstEval.cpp 2025
+ *
+ * compile time evaluation of pure functions
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * calls of pure functions whose arguments are all constants are run here
+ * while the caller is generated, the call is replaced by the returned
+ * constant. so pure functions can compute sizes of arrays, initializers
+ * of global variables and tables at build time, e.g.
+ *
+ *      pure function square(x: i32) -> i32 { return x * x }
+ *      global table = [square(1), square(2), square(3)]
+ *
+ * the evaluator interprets the llvm ir of the callee. memory is a list of
+ * blocks, one for each alloca and each constant global which is read, a
+ * pointer is (block + 1) << 32 | offset. anything the evaluator can't do
+ * exactly as the machine does, e.g. division by zero, calls of impure
+ * functions or pointers returned, stops the evaluation and the call is
+ * kept. -fconstexpr-steps and -fconstexpr-memory limit instructions run
+ * and bytes allocated by one evaluation.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include "../inc/AST.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
+
+extern uint64_t constexpr_steps;
+extern uint64_t constexpr_memory;
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::IRBuilder<> *builder;
+
+#define CONST_EVAL_MAX_DEPTH    512
+
+    /*
+     * value of a register. integers, floating points and pointers are
+     * kept in bits, arrays, structs and vectors in elements
+     */
+    struct EvalValue {
+        llvm::APInt bits;
+        vector<EvalValue> elements;
+    };
+
+    struct ConstEvalError {
+        string reason;
+    };
+
+    class ConstEvaluator {
+    private:
+        typedef llvm::DenseMap<const llvm::Value *, EvalValue> Frame;
+
+        const llvm::DataLayout &DL;
+        vector<vector<uint8_t>> blocks;
+        vector<bool> block_readonly;
+        map<const llvm::GlobalVariable *, uint64_t> globals;
+        uint64_t steps = 0;
+        uint64_t memory = 0;
+        int depth = 0;
+
+        [[noreturn]] static void fail(string reason) {
+            throw ConstEvalError{reason};
+        }
+
+        static EvalValue ptr(uint64_t p) {
+            return EvalValue{llvm::APInt(64, p), {}};
+        }
+
+        static llvm::APFloat fp(llvm::Type *Ty, const EvalValue &v) {
+            return llvm::APFloat(Ty->getFltSemantics(), v.bits);
+        }
+
+        static EvalValue fp_value(const llvm::APFloat &f) {
+            return EvalValue{f.bitcastToAPInt(), {}};
+        }
+
+        uint64_t allocate(uint64_t size, bool readonly) {
+            if (size > constexpr_memory || memory + size > constexpr_memory) {
+                fail("more than " + to_string(constexpr_memory) + " bytes of memory are used");
+            }
+            memory += size;
+            blocks.emplace_back(size, 0);
+            block_readonly.push_back(readonly);
+            return (uint64_t) blocks.size() << 32;
+        }
+
+        /**
+         * @description:    find the bytes a pointer points to
+         * @param:          p: encoded pointer
+         * @param:          size: bytes accessed
+         * @param:          write: memory is written
+         * @return:         address of the first byte
+         */
+        uint8_t *address(uint64_t p, uint64_t size, bool write) {
+            uint64_t block = p >> 32;
+            uint64_t offset = p & 0xffffffff;
+            if (block == 0 || block > blocks.size()) fail("an invalid pointer is dereferenced");
+            block--;
+            if (offset + size > blocks[block].size()) fail("memory is accessed out of bounds");
+            if (write && block_readonly[block]) fail("constant memory is written");
+            return blocks[block].data() + offset;
+        }
+
+        void step() {
+            if (++steps > constexpr_steps) {
+                fail("more than " + to_string(constexpr_steps) + " steps are run");
+            }
+        }
+
+        EvalValue zero(llvm::Type *Ty) {
+            EvalValue v;
+            if (auto ST = llvm::dyn_cast<llvm::StructType>(Ty)) {
+                for (auto i: ST->elements()) v.elements.push_back(zero(i));
+            } else if (auto AT = llvm::dyn_cast<llvm::ArrayType>(Ty)) {
+                v.elements.assign(AT->getNumElements(), zero(AT->getElementType()));
+            } else if (auto VT = llvm::dyn_cast<llvm::FixedVectorType>(Ty)) {
+                v.elements.assign(VT->getNumElements(), zero(VT->getElementType()));
+            } else if (Ty->isPointerTy()) {
+                v.bits = llvm::APInt(64, 0);
+            } else if (Ty->isIntegerTy() || Ty->isFloatingPointTy()) {
+                v.bits = llvm::APInt(Ty->getPrimitiveSizeInBits(), 0);
+            } else {
+                fail("type is not supported");
+            }
+            return v;
+        }
+
+        void store_to(const EvalValue &v, llvm::Type *Ty, uint8_t *dst) {
+            if (auto ST = llvm::dyn_cast<llvm::StructType>(Ty)) {
+                auto SL = DL.getStructLayout(ST);
+                for (unsigned i = 0; i < ST->getNumElements(); i++) {
+                    store_to(v.elements[i], ST->getElementType(i), dst + SL->getElementOffset(i));
+                }
+            } else if (llvm::isa<llvm::ArrayType>(Ty) || llvm::isa<llvm::FixedVectorType>(Ty)) {
+                llvm::Type *eleTy = Ty->isArrayTy() ? Ty->getArrayElementType()
+                                                    : llvm::cast<llvm::FixedVectorType>(Ty)->getElementType();
+                uint64_t stride = DL.getTypeAllocSize(eleTy);
+                if (Ty->isVectorTy() && eleTy->getPrimitiveSizeInBits() != stride * 8) fail("vector type is not supported");
+                for (unsigned i = 0; i < v.elements.size(); i++) {
+                    store_to(v.elements[i], eleTy, dst + i * stride);
+                }
+            } else if (Ty->isIntegerTy() || Ty->isFloatingPointTy() || Ty->isPointerTy()) {
+                llvm::StoreIntToMemory(v.bits, dst, DL.getTypeStoreSize(Ty));
+            } else {
+                fail("type is not supported");
+            }
+        }
+
+        EvalValue load_from(llvm::Type *Ty, const uint8_t *src) {
+            EvalValue v;
+            if (auto ST = llvm::dyn_cast<llvm::StructType>(Ty)) {
+                auto SL = DL.getStructLayout(ST);
+                for (unsigned i = 0; i < ST->getNumElements(); i++) {
+                    v.elements.push_back(load_from(ST->getElementType(i), src + SL->getElementOffset(i)));
+                }
+            } else if (llvm::isa<llvm::ArrayType>(Ty) || llvm::isa<llvm::FixedVectorType>(Ty)) {
+                llvm::Type *eleTy = Ty->isArrayTy() ? Ty->getArrayElementType()
+                                                    : llvm::cast<llvm::FixedVectorType>(Ty)->getElementType();
+                uint64_t n = Ty->isArrayTy() ? Ty->getArrayNumElements()
+                                             : llvm::cast<llvm::FixedVectorType>(Ty)->getNumElements();
+                uint64_t stride = DL.getTypeAllocSize(eleTy);
+                if (Ty->isVectorTy() && eleTy->getPrimitiveSizeInBits() != stride * 8) fail("vector type is not supported");
+                for (uint64_t i = 0; i < n; i++) {
+                    v.elements.push_back(load_from(eleTy, src + i * stride));
+                }
+            } else if (Ty->isIntegerTy() || Ty->isFloatingPointTy() || Ty->isPointerTy()) {
+                unsigned bytes = DL.getTypeStoreSize(Ty);
+                unsigned width = Ty->isPointerTy() ? 64 : Ty->getPrimitiveSizeInBits();
+                // read whole bytes, bits above the width are not part of the value
+                llvm::APInt bits(bytes * 8, 0);
+                llvm::LoadIntFromMemory(bits, src, bytes);
+                v.bits = bits.zextOrTrunc(width);
+            } else {
+                fail("type is not supported");
+            }
+            return v;
+        }
+
+        uint64_t global(llvm::GlobalVariable *GV) {
+            auto it = globals.find(GV);
+            if (it != globals.end()) return it->second;
+
+            if (!GV->isConstant() || !GV->hasDefinitiveInitializer()) {
+                fail("global variable '" + GV->getName().str() + "' is not a constant");
+            }
+            uint64_t p = allocate(DL.getTypeAllocSize(GV->getValueType()), true);
+            globals[GV] = p;
+            store_to(constant(GV->getInitializer()), GV->getValueType(), blocks[(p >> 32) - 1].data());
+            return p;
+        }
+
+        /*
+         * apply fn to each lane of vectors, or to the values if the type
+         * is a scalar
+         */
+        template<typename Fn>
+        EvalValue lanes(llvm::Type *Ty, const EvalValue &a, const EvalValue &b, Fn fn) {
+            if (auto VT = llvm::dyn_cast<llvm::FixedVectorType>(Ty)) {
+                EvalValue v;
+                for (unsigned i = 0; i < VT->getNumElements(); i++) {
+                    v.elements.push_back(fn(VT->getElementType(), a.elements[i], b.elements[i]));
+                }
+                return v;
+            }
+            return fn(Ty, a, b);
+        }
+
+        EvalValue binary(unsigned op, llvm::Type *Ty, const EvalValue &a, const EvalValue &b) {
+            if (Ty->isFloatingPointTy()) {
+                llvm::APFloat x = fp(Ty, a), y = fp(Ty, b);
+                auto rm = llvm::APFloat::rmNearestTiesToEven;
+                switch (op) {
+                    case llvm::Instruction::FAdd: x.add(y, rm); break;
+                    case llvm::Instruction::FSub: x.subtract(y, rm); break;
+                    case llvm::Instruction::FMul: x.multiply(y, rm); break;
+                    case llvm::Instruction::FDiv: x.divide(y, rm); break;
+                    case llvm::Instruction::FRem: x.mod(y); break;
+                    default: fail("operator is not supported");
+                }
+                return fp_value(x);
+            }
+
+            const llvm::APInt &x = a.bits, &y = b.bits;
+            bool is_div = op == llvm::Instruction::UDiv || op == llvm::Instruction::SDiv ||
+                          op == llvm::Instruction::URem || op == llvm::Instruction::SRem;
+            if (is_div && y.isZero()) fail("division by zero");
+            if ((op == llvm::Instruction::SDiv || op == llvm::Instruction::SRem) &&
+                x.isMinSignedValue() && y.isAllOnes()) {
+                fail("division overflows");
+            }
+            bool is_shift = op == llvm::Instruction::Shl || op == llvm::Instruction::LShr ||
+                            op == llvm::Instruction::AShr;
+            if (is_shift && y.uge(x.getBitWidth())) fail("shift amount is too large");
+
+            switch (op) {
+                case llvm::Instruction::Add:  return EvalValue{x + y, {}};
+                case llvm::Instruction::Sub:  return EvalValue{x - y, {}};
+                case llvm::Instruction::Mul:  return EvalValue{x * y, {}};
+                case llvm::Instruction::UDiv: return EvalValue{x.udiv(y), {}};
+                case llvm::Instruction::SDiv: return EvalValue{x.sdiv(y), {}};
+                case llvm::Instruction::URem: return EvalValue{x.urem(y), {}};
+                case llvm::Instruction::SRem: return EvalValue{x.srem(y), {}};
+                case llvm::Instruction::Shl:  return EvalValue{x.shl(y), {}};
+                case llvm::Instruction::LShr: return EvalValue{x.lshr(y), {}};
+                case llvm::Instruction::AShr: return EvalValue{x.ashr(y), {}};
+                case llvm::Instruction::And:  return EvalValue{x & y, {}};
+                case llvm::Instruction::Or:   return EvalValue{x | y, {}};
+                case llvm::Instruction::Xor:  return EvalValue{x ^ y, {}};
+                default: fail("operator is not supported");
+            }
+        }
+
+        EvalValue cast(unsigned op, llvm::Type *srcTy, llvm::Type *dstTy, const EvalValue &v) {
+            unsigned width = dstTy->isPointerTy() ? 64 : dstTy->getPrimitiveSizeInBits();
+            switch (op) {
+                case llvm::Instruction::Trunc: return EvalValue{v.bits.trunc(width), {}};
+                case llvm::Instruction::ZExt:  return EvalValue{v.bits.zext(width), {}};
+                case llvm::Instruction::SExt:  return EvalValue{v.bits.sext(width), {}};
+                case llvm::Instruction::PtrToInt:
+                case llvm::Instruction::IntToPtr:
+                    return EvalValue{v.bits.zextOrTrunc(width), {}};
+                case llvm::Instruction::FPTrunc:
+                case llvm::Instruction::FPExt: {
+                    llvm::APFloat f = fp(srcTy, v);
+                    bool loses_info;
+                    f.convert(dstTy->getFltSemantics(), llvm::APFloat::rmNearestTiesToEven, &loses_info);
+                    return fp_value(f);
+                }
+                case llvm::Instruction::FPToUI:
+                case llvm::Instruction::FPToSI: {
+                    llvm::APSInt i(width, op == llvm::Instruction::FPToUI);
+                    bool is_exact;
+                    auto status = fp(srcTy, v).convertToInteger(i, llvm::APFloat::rmTowardZero, &is_exact);
+                    if (status & llvm::APFloat::opInvalidOp) fail("floating point value is out of range of integer");
+                    return EvalValue{i, {}};
+                }
+                case llvm::Instruction::UIToFP:
+                case llvm::Instruction::SIToFP: {
+                    llvm::APFloat f(dstTy->getFltSemantics());
+                    f.convertFromAPInt(v.bits, op == llvm::Instruction::SIToFP, llvm::APFloat::rmNearestTiesToEven);
+                    return fp_value(f);
+                }
+                default:
+                    fail("cast is not supported");
+            }
+        }
+
+        EvalValue gep(llvm::GEPOperator *GEP, Frame &frame) {
+            if (GEP->getType()->isVectorTy()) fail("vector of pointers is not supported");
+
+            uint64_t p = operand(GEP->getPointerOperand(), frame).bits.getZExtValue();
+            for (auto GTI = llvm::gep_type_begin(GEP), E = llvm::gep_type_end(GEP); GTI != E; ++GTI) {
+                llvm::APInt idx = operand(GTI.getOperand(), frame).bits;
+                if (auto ST = GTI.getStructTypeOrNull()) {
+                    p += DL.getStructLayout(ST)->getElementOffset(idx.getZExtValue());
+                } else {
+                    p += (uint64_t) (idx.sextOrTrunc(64).getSExtValue() *
+                                     (int64_t) DL.getTypeAllocSize(GTI.getIndexedType()));
+                }
+            }
+            return ptr(p);
+        }
+
+        EvalValue intrinsic(llvm::CallInst *CI, Frame &frame) {
+            auto id = CI->getCalledFunction()->getIntrinsicID();
+            auto arg = [&](unsigned i) { return operand(CI->getArgOperand(i), frame); };
+            llvm::Type *Ty = CI->getType();
+
+            switch (id) {
+                case llvm::Intrinsic::dbg_declare:
+                case llvm::Intrinsic::dbg_value:
+                case llvm::Intrinsic::dbg_label:
+                case llvm::Intrinsic::lifetime_start:
+                case llvm::Intrinsic::lifetime_end:
+                case llvm::Intrinsic::assume:
+                case llvm::Intrinsic::donothing:
+                case llvm::Intrinsic::experimental_noalias_scope_decl:
+                    return EvalValue();
+                case llvm::Intrinsic::memcpy:
+                case llvm::Intrinsic::memmove: {
+                    uint64_t n = arg(2).bits.getZExtValue();
+                    if (n == 0) return EvalValue();
+                    uint8_t *src = address(arg(1).bits.getZExtValue(), n, false);
+                    uint8_t *dst = address(arg(0).bits.getZExtValue(), n, true);
+                    memmove(dst, src, n);
+                    return EvalValue();
+                }
+                case llvm::Intrinsic::memset: {
+                    uint64_t n = arg(2).bits.getZExtValue();
+                    if (n == 0) return EvalValue();
+                    memset(address(arg(0).bits.getZExtValue(), n, true), (int) arg(1).bits.getZExtValue(), n);
+                    return EvalValue();
+                }
+                default:
+                    break;
+            }
+
+            auto unary_fp = [&](auto fn) {
+                auto x = arg(0);
+                return lanes(Ty, x, x, [&](llvm::Type *T, const EvalValue &a, const EvalValue &) {
+                    return fp_value(fn(T, fp(T, a)));
+                });
+            };
+            auto binary_fp = [&](auto fn) {
+                return lanes(Ty, arg(0), arg(1), [&](llvm::Type *T, const EvalValue &a, const EvalValue &b) {
+                    return fp_value(fn(fp(T, a), fp(T, b)));
+                });
+            };
+            auto binary_int = [&](auto fn) {
+                return lanes(Ty, arg(0), arg(1), [&](llvm::Type *, const EvalValue &a, const EvalValue &b) {
+                    return EvalValue{fn(a.bits, b.bits), {}};
+                });
+            };
+            auto to_integral = [](llvm::APFloat::roundingMode rm) {
+                return [rm](llvm::Type *, llvm::APFloat f) {
+                    f.roundToIntegral(rm);
+                    return f;
+                };
+            };
+
+            switch (id) {
+                case llvm::Intrinsic::fabs:
+                    return unary_fp([](llvm::Type *, llvm::APFloat f) {
+                        f.clearSign();
+                        return f;
+                    });
+                case llvm::Intrinsic::sqrt:
+                    // sqrt of ieee 754 is correctly rounded, the host gives the same result
+                    return unary_fp([](llvm::Type *T, llvm::APFloat f) {
+                        if (T->isFloatTy()) return llvm::APFloat(sqrtf(f.convertToFloat()));
+                        if (T->isDoubleTy()) return llvm::APFloat(sqrt(f.convertToDouble()));
+                        fail("sqrt of this type is not supported");
+                    });
+                case llvm::Intrinsic::floor: return unary_fp(to_integral(llvm::APFloat::rmTowardNegative));
+                case llvm::Intrinsic::ceil:  return unary_fp(to_integral(llvm::APFloat::rmTowardPositive));
+                case llvm::Intrinsic::trunc: return unary_fp(to_integral(llvm::APFloat::rmTowardZero));
+                case llvm::Intrinsic::round: return unary_fp(to_integral(llvm::APFloat::rmNearestTiesToAway));
+                case llvm::Intrinsic::minnum:
+                    return binary_fp([](const llvm::APFloat &a, const llvm::APFloat &b) { return llvm::minnum(a, b); });
+                case llvm::Intrinsic::maxnum:
+                    return binary_fp([](const llvm::APFloat &a, const llvm::APFloat &b) { return llvm::maxnum(a, b); });
+                case llvm::Intrinsic::copysign:
+                    return binary_fp([](llvm::APFloat a, const llvm::APFloat &b) {
+                        a.copySign(b);
+                        return a;
+                    });
+                case llvm::Intrinsic::smax:
+                    return binary_int([](const llvm::APInt &a, const llvm::APInt &b) { return llvm::APIntOps::smax(a, b); });
+                case llvm::Intrinsic::smin:
+                    return binary_int([](const llvm::APInt &a, const llvm::APInt &b) { return llvm::APIntOps::smin(a, b); });
+                case llvm::Intrinsic::umax:
+                    return binary_int([](const llvm::APInt &a, const llvm::APInt &b) { return llvm::APIntOps::umax(a, b); });
+                case llvm::Intrinsic::umin:
+                    return binary_int([](const llvm::APInt &a, const llvm::APInt &b) { return llvm::APIntOps::umin(a, b); });
+                case llvm::Intrinsic::abs: {
+                    bool int_min_is_poison = arg(1).bits.getBoolValue();
+                    auto x = arg(0);
+                    return lanes(Ty, x, x, [&](llvm::Type *, const EvalValue &a, const EvalValue &) {
+                        if (int_min_is_poison && a.bits.isMinSignedValue()) fail("abs of minimum integer");
+                        return EvalValue{a.bits.abs(), {}};
+                    });
+                }
+                default:
+                    fail("intrinsic '" + CI->getCalledFunction()->getName().str() + "' is not supported");
+            }
+        }
+
+        EvalValue execute(llvm::Instruction *I, Frame &frame) {
+            unsigned op = I->getOpcode();
+            llvm::Type *Ty = I->getType();
+
+            if (I->isBinaryOp()) {
+                return lanes(Ty, operand(I->getOperand(0), frame), operand(I->getOperand(1), frame),
+                             [&](llvm::Type *T, const EvalValue &a, const EvalValue &b) {
+                                 return binary(op, T, a, b);
+                             });
+            }
+            if (I->isCast() && op != llvm::Instruction::BitCast && op != llvm::Instruction::AddrSpaceCast) {
+                auto v = operand(I->getOperand(0), frame);
+                llvm::Type *srcTy = I->getOperand(0)->getType();
+                if (auto VT = llvm::dyn_cast<llvm::FixedVectorType>(srcTy)) {
+                    EvalValue r;
+                    for (unsigned i = 0; i < VT->getNumElements(); i++) {
+                        r.elements.push_back(cast(op, VT->getElementType(), Ty->getScalarType(), v.elements[i]));
+                    }
+                    return r;
+                }
+                return cast(op, srcTy, Ty, v);
+            }
+
+            switch (op) {
+                case llvm::Instruction::Alloca: {
+                    auto AI = llvm::cast<llvm::AllocaInst>(I);
+                    uint64_t n = operand(AI->getArraySize(), frame).bits.getZExtValue();
+                    uint64_t size = DL.getTypeAllocSize(AI->getAllocatedType());
+                    if (n && size > constexpr_memory / n) {
+                        fail("more than " + to_string(constexpr_memory) + " bytes of memory are used");
+                    }
+                    return ptr(allocate(size * n, false));
+                }
+                case llvm::Instruction::Load: {
+                    uint64_t p = operand(I->getOperand(0), frame).bits.getZExtValue();
+                    return load_from(Ty, address(p, DL.getTypeStoreSize(Ty), false));
+                }
+                case llvm::Instruction::Store: {
+                    auto SI = llvm::cast<llvm::StoreInst>(I);
+                    llvm::Type *valTy = SI->getValueOperand()->getType();
+                    auto v = operand(SI->getValueOperand(), frame);
+                    uint64_t p = operand(SI->getPointerOperand(), frame).bits.getZExtValue();
+                    store_to(v, valTy, address(p, DL.getTypeStoreSize(valTy), true));
+                    return EvalValue();
+                }
+                case llvm::Instruction::GetElementPtr:
+                    return gep(llvm::cast<llvm::GEPOperator>(I), frame);
+                case llvm::Instruction::BitCast:
+                case llvm::Instruction::AddrSpaceCast: {
+                    llvm::Type *srcTy = I->getOperand(0)->getType();
+                    auto v = operand(I->getOperand(0), frame);
+                    if (srcTy->isPtrOrPtrVectorTy() && Ty->isPtrOrPtrVectorTy()) return v;
+                    // reinterpret bytes
+                    vector<uint8_t> buf(DL.getTypeAllocSize(srcTy));
+                    store_to(v, srcTy, buf.data());
+                    return load_from(Ty, buf.data());
+                }
+                case llvm::Instruction::FNeg: {
+                    auto v = operand(I->getOperand(0), frame);
+                    return lanes(Ty, v, v, [&](llvm::Type *T, const EvalValue &a, const EvalValue &) {
+                        llvm::APFloat f = fp(T, a);
+                        f.changeSign();
+                        return fp_value(f);
+                    });
+                }
+                case llvm::Instruction::ICmp:
+                case llvm::Instruction::FCmp: {
+                    auto CI = llvm::cast<llvm::CmpInst>(I);
+                    return lanes(CI->getOperand(0)->getType(),
+                                 operand(CI->getOperand(0), frame), operand(CI->getOperand(1), frame),
+                                 [&](llvm::Type *T, const EvalValue &a, const EvalValue &b) {
+                                     bool r = op == llvm::Instruction::ICmp
+                                              ? llvm::ICmpInst::compare(a.bits, b.bits, CI->getPredicate())
+                                              : llvm::FCmpInst::compare(fp(T, a), fp(T, b), CI->getPredicate());
+                                     return EvalValue{llvm::APInt(1, r), {}};
+                                 });
+                }
+                case llvm::Instruction::Select: {
+                    auto cond = operand(I->getOperand(0), frame);
+                    auto a = operand(I->getOperand(1), frame);
+                    auto b = operand(I->getOperand(2), frame);
+                    if (cond.elements.empty()) return cond.bits.getBoolValue() ? a : b;
+                    EvalValue r;
+                    for (unsigned i = 0; i < cond.elements.size(); i++) {
+                        r.elements.push_back(cond.elements[i].bits.getBoolValue() ? a.elements[i] : b.elements[i]);
+                    }
+                    return r;
+                }
+                case llvm::Instruction::ExtractValue: {
+                    auto v = operand(I->getOperand(0), frame);
+                    for (auto i: llvm::cast<llvm::ExtractValueInst>(I)->indices()) {
+                        EvalValue e = std::move(v.elements[i]);
+                        v = std::move(e);
+                    }
+                    return v;
+                }
+                case llvm::Instruction::InsertValue: {
+                    auto v = operand(I->getOperand(0), frame);
+                    EvalValue *e = &v;
+                    for (auto i: llvm::cast<llvm::InsertValueInst>(I)->indices()) {
+                        e = &e->elements[i];
+                    }
+                    *e = operand(I->getOperand(1), frame);
+                    return v;
+                }
+                case llvm::Instruction::ExtractElement: {
+                    auto v = operand(I->getOperand(0), frame);
+                    uint64_t i = operand(I->getOperand(1), frame).bits.getZExtValue();
+                    if (i >= v.elements.size()) fail("index of vector is out of bounds");
+                    return v.elements[i];
+                }
+                case llvm::Instruction::InsertElement: {
+                    auto v = operand(I->getOperand(0), frame);
+                    uint64_t i = operand(I->getOperand(2), frame).bits.getZExtValue();
+                    if (i >= v.elements.size()) fail("index of vector is out of bounds");
+                    v.elements[i] = operand(I->getOperand(1), frame);
+                    return v;
+                }
+                case llvm::Instruction::ShuffleVector: {
+                    auto SV = llvm::cast<llvm::ShuffleVectorInst>(I);
+                    auto a = operand(SV->getOperand(0), frame);
+                    auto b = operand(SV->getOperand(1), frame);
+                    EvalValue r;
+                    for (int i: SV->getShuffleMask()) {
+                        if (i < 0) {
+                            r.elements.push_back(zero(Ty->getScalarType()));
+                        } else {
+                            r.elements.push_back((unsigned) i < a.elements.size() ? a.elements[i] : b.elements[i - a.elements.size()]);
+                        }
+                    }
+                    return r;
+                }
+                case llvm::Instruction::Freeze:
+                    return operand(I->getOperand(0), frame);
+                case llvm::Instruction::Call: {
+                    auto CI = llvm::cast<llvm::CallInst>(I);
+                    llvm::Function *callee = CI->getCalledFunction();
+                    if (!callee) fail("function pointer is called");
+                    if (callee->isIntrinsic()) return intrinsic(CI, frame);
+
+                    vector<EvalValue> args;
+                    for (auto &i: CI->args()) args.push_back(operand(i, frame));
+                    return run(callee, args);
+                }
+                default:
+                    fail("instruction '" + string(I->getOpcodeName()) + "' is not supported");
+            }
+        }
+
+        EvalValue operand(llvm::Value *V, Frame &frame) {
+            if (auto C = llvm::dyn_cast<llvm::Constant>(V)) return constant(C);
+
+            auto it = frame.find(V);
+            if (it == frame.end()) fail("value is used before it is defined");
+            return it->second;
+        }
+
+    public:
+        explicit ConstEvaluator(const llvm::DataLayout &DL) : DL(DL) {}
+
+        EvalValue constant(llvm::Constant *C) {
+            if (auto CI = llvm::dyn_cast<llvm::ConstantInt>(C)) return EvalValue{CI->getValue(), {}};
+            if (auto CF = llvm::dyn_cast<llvm::ConstantFP>(C)) return fp_value(CF->getValueAPF());
+            if (llvm::isa<llvm::ConstantPointerNull>(C)) return ptr(0);
+            // any value is allowed for undef, zero is what a register usually holds
+            if (llvm::isa<llvm::UndefValue>(C) || llvm::isa<llvm::ConstantAggregateZero>(C)) return zero(C->getType());
+            if (auto CDS = llvm::dyn_cast<llvm::ConstantDataSequential>(C)) {
+                EvalValue v;
+                for (unsigned i = 0; i < CDS->getNumElements(); i++) {
+                    v.elements.push_back(constant(CDS->getElementAsConstant(i)));
+                }
+                return v;
+            }
+            if (llvm::isa<llvm::ConstantAggregate>(C)) {
+                EvalValue v;
+                for (auto &i: C->operands()) {
+                    v.elements.push_back(constant(llvm::cast<llvm::Constant>(i)));
+                }
+                return v;
+            }
+            if (auto GV = llvm::dyn_cast<llvm::GlobalVariable>(C)) return ptr(global(GV));
+            if (auto CE = llvm::dyn_cast<llvm::ConstantExpr>(C)) {
+                unique_ptr<llvm::Instruction, void (*)(llvm::Instruction *)> I(
+                        CE->getAsInstruction(), [](llvm::Instruction *I) { I->deleteValue(); });
+                Frame frame;
+                return execute(I.get(), frame);
+            }
+            fail("constant '" + C->getName().str() + "' is not supported");
+        }
+
+        /**
+         * @description:    run a pure function
+         * @param:          fun: function with body
+         * @param:          args: values of arguments
+         * @return:         returned value, empty for void
+         */
+        EvalValue run(llvm::Function *fun, vector<EvalValue> &args) {
+            string name = fun->getName().str();
+            if (fun->isDeclaration()) fail("body of '" + name + "' is not in this module");
+            if (!fun->doesNotAccessMemory()) fail("'" + name + "' is not a pure function");
+            if (fun->isVarArg()) fail("'" + name + "' has variable arguments");
+            if (++depth > CONST_EVAL_MAX_DEPTH) {
+                fail("recursion is deeper than " + to_string(CONST_EVAL_MAX_DEPTH));
+            }
+
+            Frame frame;
+            unsigned idx = 0;
+            for (auto &i: fun->args()) frame[&i] = args[idx++];
+
+            llvm::BasicBlock *prev = nullptr;
+            llvm::BasicBlock *bb = &fun->getEntryBlock();
+            while (true) {
+                if (!bb->getTerminator()) fail("'" + name + "' is not completely generated");
+
+                // phi nodes take values of the predecessor at the same time
+                vector<pair<llvm::PHINode *, EvalValue>> phis;
+                for (auto &i: bb->phis()) {
+                    phis.emplace_back(&i, operand(i.getIncomingValueForBlock(prev), frame));
+                }
+                for (auto &i: phis) frame[i.first] = i.second;
+
+                llvm::BasicBlock *next = nullptr;
+                for (auto &inst: *bb) {
+                    if (llvm::isa<llvm::PHINode>(inst)) continue;
+                    step();
+
+                    if (auto br = llvm::dyn_cast<llvm::BranchInst>(&inst)) {
+                        next = br->isUnconditional() || operand(br->getCondition(), frame).bits.getBoolValue()
+                               ? br->getSuccessor(0)
+                               : br->getSuccessor(1);
+                    } else if (auto sw = llvm::dyn_cast<llvm::SwitchInst>(&inst)) {
+                        auto cond = operand(sw->getCondition(), frame);
+                        next = sw->getDefaultDest();
+                        for (auto &i: sw->cases()) {
+                            if (i.getCaseValue()->getValue() == cond.bits) {
+                                next = i.getCaseSuccessor();
+                                break;
+                            }
+                        }
+                    } else if (auto ret = llvm::dyn_cast<llvm::ReturnInst>(&inst)) {
+                        depth--;
+                        return ret->getReturnValue() ? operand(ret->getReturnValue(), frame) : EvalValue();
+                    } else if (inst.isTerminator()) {
+                        fail("instruction '" + string(inst.getOpcodeName()) + "' is not supported");
+                    } else {
+                        auto v = execute(&inst, frame);
+                        if (!inst.getType()->isVoidTy()) frame[&inst] = v;
+                    }
+                }
+                prev = bb;
+                bb = next;
+            }
+        }
+
+        llvm::Constant *to_constant(const EvalValue &v, llvm::Type *Ty) {
+            if (Ty->isIntegerTy()) return llvm::ConstantInt::get(*the_context, v.bits);
+            if (Ty->isFloatingPointTy()) return llvm::ConstantFP::get(*the_context, fp(Ty, v));
+            if (auto PT = llvm::dyn_cast<llvm::PointerType>(Ty)) {
+                if (v.bits.isZero()) return llvm::ConstantPointerNull::get(PT);
+                fail("pointer can't be returned");
+            }
+
+            vector<llvm::Constant *> elements;
+            for (unsigned i = 0; i < v.elements.size(); i++) {
+                llvm::Type *eleTy = Ty->isStructTy() ? Ty->getStructElementType(i)
+                                                     : Ty->isArrayTy() ? Ty->getArrayElementType()
+                                                                       : Ty->getScalarType();
+                elements.push_back(to_constant(v.elements[i], eleTy));
+            }
+            if (auto ST = llvm::dyn_cast<llvm::StructType>(Ty)) return llvm::ConstantStruct::get(ST, elements);
+            if (auto AT = llvm::dyn_cast<llvm::ArrayType>(Ty)) return llvm::ConstantArray::get(AT, elements);
+            if (Ty->isVectorTy()) return llvm::ConstantVector::get(elements);
+            fail("type is not supported");
+        }
+    };
+
+    /**
+     * @description:    evaluate a call of pure function at compile time
+     * @param:          fun: callee
+     * @param:          args: arguments, all of them must be constants
+     * @param:          reason: why the call is not evaluated
+     * @return:         returned value, nullptr if it can't be evaluated
+     */
+    llvm::Constant *llvm_const_eval(llvm::Function *fun, vector<llvm::Value *> args, string &reason) {
+        if (fun->getReturnType()->isVoidTy()) {
+            reason = "function returns nothing";
+            return nullptr;
+        }
+        // body of the function being generated is not finished
+        if (builder->GetInsertBlock() && builder->GetInsertBlock()->getParent() == fun) {
+            reason = "function calls itself";
+            return nullptr;
+        }
+
+        ConstEvaluator eval(the_module->getDataLayout());
+        try {
+            vector<EvalValue> values;
+            for (auto i: args) {
+                auto c = llvm::dyn_cast<llvm::Constant>(i);
+                if (!c) {
+                    reason = "argument is not a compile-time constant";
+                    return nullptr;
+                }
+                values.push_back(eval.constant(c));
+            }
+            return eval.to_constant(eval.run(fun, values), fun->getReturnType());
+        } catch (const ConstEvalError &e) {
+            reason = e.reason;
+            return nullptr;
+        }
+    }
+}
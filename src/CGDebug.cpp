@@ -0,0 +1,348 @@
+/*
+ * CGDebug.cpp 2025
+ *
+ * DWARF debug information (-g)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * -g describes the module with DIBuilder while it is generated:
+ *
+ *      FunctionDecl        DISubprogram
+ *      scopes              DILexicalBlock, opened by every push of symbol
+ *                          table, so compounds and loops get their own
+ *      variables           dbg.declare of the alloca when it is inserted
+ *                          to symbol table, parameters keep their number
+ *      obj                 DICompositeType with members
+ *
+ * the location of builder is moved to each statement by Compound, and to
+ * conditions and adjustments of loops. code out of functions, e.g. global
+ * initializers, has no location. llvm_debug_finalize makes locations agree
+ * with the function they are in, since code of one function can be
+ * generated in the middle of another.
+ *
+ * -Rpass without -g only needs lines for the remarks, so functions and
+ * locations are described but no types or variables.
+ */
+
+#include "../inc/AST.h"
+#include "../inc/FileName.h"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+#include "Exception.h"
+
+extern bool opt_debug;
+extern bool opt_optimize;
+extern std::string remark_pass;
+extern std::string remark_pass_missed;
+extern std::string remark_pass_analysis;
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::IRBuilder<> *builder;
+    extern SymbolTable *symbol_table;
+    extern TypeTable type_table;
+
+    static llvm::DIBuilder *di_builder = nullptr;
+    static llvm::DICompileUnit *di_unit = nullptr;
+    static llvm::DIFile *di_file = nullptr;
+    static map<llvm::Type *, llvm::DIType *> di_types;
+    // line of obj definitions
+    static map<llvm::Type *, int> struct_lines;
+    static bool line_tables_only = false;
+
+    /**
+     * @description:    create compile unit of current module
+     * @return:         none
+     */
+    void llvm_debug_init() {
+        delete di_builder;
+        di_builder = nullptr;
+        di_types.clear();
+        struct_lines.clear();
+        line_tables_only = !opt_debug &&
+                (!remark_pass.empty() || !remark_pass_missed.empty() || !remark_pass_analysis.empty());
+        if (!opt_debug && !line_tables_only) return;
+
+        the_module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+        the_module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+
+        di_builder = new llvm::DIBuilder(*the_module);
+        di_file = di_builder->createFile(input_file_name, input_file_path_absolut);
+        // sl has no DWARF language code, C is the nearest for debuggers
+        di_unit = di_builder->createCompileUnit(
+                llvm::dwarf::DW_LANG_C, di_file,
+                "avsi " LLVM_VERSION_STRING, opt_optimize, "", 0, "",
+                line_tables_only ? llvm::DICompileUnit::LineTablesOnly : llvm::DICompileUnit::FullDebug);
+    }
+
+    /**
+     * @description:    get debug type of llvm type
+     * @param:          ty: llvm type
+     * @return:         debug type, nullptr for void
+     */
+    static llvm::DIType *debug_type(llvm::Type *ty) {
+        auto iter = di_types.find(ty);
+        if (iter != di_types.end()) return iter->second;
+
+        auto &DL = the_module->getDataLayout();
+        string name = type_table.name(ty);
+        llvm::DIType *ret = nullptr;
+
+        if (ty->isVoidTy()) {
+            return nullptr;
+        } else if (ty->isIntegerTy(1)) {
+            ret = di_builder->createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+        } else if (ty->isIntegerTy(8)) {
+            ret = di_builder->createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char);
+        } else if (ty->isIntegerTy()) {
+            if (name.empty()) name = "i" + to_string(ty->getIntegerBitWidth());
+            ret = di_builder->createBasicType(name, ty->getIntegerBitWidth(), llvm::dwarf::DW_ATE_signed);
+        } else if (ty->isFloatingPointTy()) {
+            if (name.empty()) name = "f" + to_string(ty->getPrimitiveSizeInBits());
+            ret = di_builder->createBasicType(name, ty->getPrimitiveSizeInBits(), llvm::dwarf::DW_ATE_float);
+        } else if (ty->isPointerTy()) {
+            auto pointee = ty->getPointerElementType();
+            llvm::DIType *base = nullptr;
+            if (pointee->isFunctionTy()) {
+                llvm::SmallVector<llvm::Metadata *, 8> elements;
+                auto FT = llvm::cast<llvm::FunctionType>(pointee);
+                elements.push_back(debug_type(FT->getReturnType()));
+                for (auto i: FT->params()) elements.push_back(debug_type(i));
+                base = di_builder->createSubroutineType(di_builder->getOrCreateTypeArray(elements));
+            } else {
+                base = debug_type(pointee);
+            }
+            ret = di_builder->createPointerType(base, DL.getPointerSizeInBits());
+        } else if (ty->isArrayTy()) {
+            auto elements = di_builder->getOrCreateArray(
+                    {di_builder->getOrCreateSubrange(0, (int64_t) ty->getArrayNumElements())});
+            ret = di_builder->createArrayType(
+                    DL.getTypeAllocSizeInBits(ty), DL.getABITypeAlignment(ty) * 8,
+                    debug_type(ty->getArrayElementType()), elements);
+        } else if (auto VT = llvm::dyn_cast<llvm::FixedVectorType>(ty)) {
+            auto elements = di_builder->getOrCreateArray(
+                    {di_builder->getOrCreateSubrange(0, (int64_t) VT->getNumElements())});
+            ret = di_builder->createVectorType(
+                    DL.getTypeAllocSizeInBits(ty), DL.getABITypeAlignment(ty) * 8,
+                    debug_type(VT->getElementType()), elements);
+        } else if (auto ST = llvm::dyn_cast<llvm::StructType>(ty)) {
+            string struct_name = name.substr(0, name.find('{'));
+            int line = struct_lines.count(ty) ? struct_lines[ty] : 0;
+
+            // members may point to the struct itself
+            auto forward = di_builder->createReplaceableCompositeType(
+                    llvm::dwarf::DW_TAG_structure_type, struct_name, di_file, di_file, line);
+            di_types[ty] = forward;
+
+            const StructDef *def = findStructDef(ST);
+            vector<string> member_names(ST->getNumElements());
+            if (def) member_names = def->member_names;
+
+            auto layout = DL.getStructLayout(ST);
+            llvm::SmallVector<llvm::Metadata *, 8> members;
+            for (unsigned i = 0; i < ST->getNumElements(); i++) {
+                auto member_ty = ST->getElementType(i);
+                members.push_back(di_builder->createMemberType(
+                        di_file, member_names[i].empty() ? "_" + to_string(i) : member_names[i],
+                        di_file, line,
+                        DL.getTypeAllocSizeInBits(member_ty), DL.getABITypeAlignment(member_ty) * 8,
+                        layout->getElementOffsetInBits(i), llvm::DINode::FlagZero,
+                        debug_type(member_ty)));
+            }
+
+            ret = di_builder->createStructType(
+                    di_file, struct_name, di_file, line,
+                    DL.getTypeAllocSizeInBits(ST), DL.getABITypeAlignment(ST) * 8,
+                    llvm::DINode::FlagZero, nullptr, di_builder->getOrCreateArray(members));
+            forward->replaceAllUsesWith(ret);
+        } else {
+            ret = di_builder->createUnspecifiedType(name.empty() ? "?" : name);
+        }
+
+        di_types[ty] = ret;
+        return ret;
+    }
+
+    /**
+     * @description:    describe a struct defined by obj
+     * @param:          Ty: struct type
+     * @param:          line: line of obj
+     * @return:         none
+     */
+    void llvm_debug_struct(llvm::StructType *Ty, int line) {
+        if (!di_builder || line_tables_only) return;
+
+        struct_lines[Ty] = line;
+        di_builder->retainType(debug_type(Ty));
+    }
+
+    /**
+     * @description:    create subprogram of a function being defined
+     * @param:          fun: function
+     * @param:          name: name in source
+     * @param:          line: line of function
+     * @return:         subprogram, it is the scope of function body
+     */
+    llvm::DIScope *llvm_debug_function(llvm::Function *fun, string name, int line) {
+        if (!di_builder) return nullptr;
+
+        llvm::SmallVector<llvm::Metadata *, 8> elements;
+        if (!line_tables_only) {
+            elements.push_back(debug_type(fun->getReturnType()));
+            for (auto &arg: fun->args()) elements.push_back(debug_type(arg.getType()));
+        }
+        auto FT = di_builder->createSubroutineType(di_builder->getOrCreateTypeArray(elements));
+
+        auto flags = llvm::DISubprogram::SPFlagDefinition;
+        if (opt_optimize) flags |= llvm::DISubprogram::SPFlagOptimized;
+        if (fun->hasLocalLinkage()) flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+
+        auto SP = di_builder->createFunction(
+                di_file, name, fun->getName(), di_file, line, FT, line,
+                llvm::DINode::FlagPrototyped, flags);
+        fun->setSubprogram(SP);
+
+        builder->SetCurrentDebugLocation(llvm::DILocation::get(*the_context, line, 0, SP));
+        return SP;
+    }
+
+    /**
+     * @description:    resolve variables of a function so it can be verified
+     * @param:          fun: function
+     * @return:         none
+     */
+    void llvm_debug_function_end(llvm::Function *fun) {
+        if (!di_builder || !fun->getSubprogram()) return;
+        di_builder->finalizeSubprogram(fun->getSubprogram());
+    }
+
+    /**
+     * @description:    open a lexical block at current location
+     * @param:          parent: enclosing scope
+     * @return:         lexical block, nullptr out of functions
+     */
+    llvm::DIScope *llvm_debug_lexical_block(llvm::DIScope *parent) {
+        if (!di_builder || !parent) return nullptr;
+
+        unsigned line = 0, col = 0;
+        if (auto loc = builder->getCurrentDebugLocation()) {
+            line = loc.getLine();
+            col = loc.getCol();
+        }
+        return di_builder->createLexicalBlock(parent, di_file, line, col);
+    }
+
+    static llvm::DISubprogram *scope_subprogram(llvm::DIScope *scope) {
+        auto local = llvm::dyn_cast_or_null<llvm::DILocalScope>(scope);
+        return local ? local->getSubprogram() : nullptr;
+    }
+
+    /**
+     * @description:    move builder to a line of current scope
+     * @param:          line: line
+     * @param:          col: column
+     * @return:         none
+     */
+    void llvm_debug_location(int line, int col) {
+        if (!di_builder) return;
+
+        auto BB = builder->GetInsertBlock();
+        auto SP = BB && BB->getParent() ? BB->getParent()->getSubprogram() : nullptr;
+        auto scope = symbol_table->getDebugScope();
+        if (!SP || scope_subprogram(scope) != SP) {
+            builder->SetCurrentDebugLocation(llvm::DebugLoc());
+            return;
+        }
+        builder->SetCurrentDebugLocation(llvm::DILocation::get(*the_context, line, col + 1, scope));
+    }
+
+    /**
+     * @description:    describe a variable by its alloca
+     * @param:          name: variable name
+     * @param:          addr: allocated space
+     * @param:          scope: scope of variable
+     * @param:          arg_no: number of parameter from 1, 0 for local variable
+     * @return:         none
+     */
+    void llvm_debug_variable(string name, llvm::AllocaInst *addr, llvm::DIScope *scope, unsigned arg_no) {
+        if (!di_builder || line_tables_only || !scope || !addr) return;
+        auto SP = addr->getFunction()->getSubprogram();
+        if (!SP || scope_subprogram(scope) != SP) return;
+
+        unsigned line = SP->getLine();
+        if (auto loc = builder->getCurrentDebugLocation()) line = loc.getLine();
+
+        auto type = debug_type(addr->getAllocatedType());
+        llvm::DILocalVariable *var = arg_no
+                ? di_builder->createParameterVariable(scope, name, arg_no, di_file, line, type, true)
+                : di_builder->createAutoVariable(scope, name, di_file, line, type, true);
+
+        auto loc = llvm::DILocation::get(*the_context, line, 0, llvm::cast<llvm::DILocalScope>(scope));
+        if (auto next = addr->getNextNode()) {
+            di_builder->insertDeclare(addr, var, di_builder->createExpression(), loc, next);
+        } else {
+            di_builder->insertDeclare(addr, var, di_builder->createExpression(), loc, addr->getParent());
+        }
+    }
+
+    /**
+     * @description:    finish debug information. instructions keep only
+     *                  locations of their own function, and calls in
+     *                  a described function get one, as the verifier needs
+     * @return:         none
+     */
+    void llvm_debug_finalize() {
+        if (!di_builder) return;
+
+        for (auto &fun: the_module->functions()) {
+            auto SP = fun.getSubprogram();
+            for (auto &BB: fun) {
+                for (auto &I: BB) {
+                    auto &loc = I.getDebugLoc();
+                    if (!SP) {
+                        if (loc) I.setDebugLoc(llvm::DebugLoc());
+                        continue;
+                    }
+                    bool own = loc && loc->getScope()->getSubprogram() == SP;
+                    if (!own && (loc || llvm::isa<llvm::CallBase>(I))) {
+                        I.setDebugLoc(llvm::DILocation::get(*the_context, 0, 0, SP));
+                    }
+                }
+            }
+        }
+
+        di_builder->finalize();
+        delete di_builder;
+        di_builder = nullptr;
+        builder->SetCurrentDebugLocation(llvm::DebugLoc());
+    }
+}
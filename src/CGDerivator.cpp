@@ -79,8 +79,6 @@ namespace AVSI {
     extern llvm::LLVMContext *the_context;
     extern llvm::Module *the_module;
     extern llvm::IRBuilder<> *builder;
-    extern llvm::legacy::FunctionPassManager *the_function_fpm;
-    extern llvm::legacy::PassManager *the_module_fpm;
 
     extern llvm::TargetMachine *TheTargetMachine;
 
@@ -111,8 +109,6 @@ namespace AVSI {
     extern set<llvm::Type *> simple_types;
     extern map<llvm::Type *, uint8_t> simple_types_map;
 
-    extern map<llvm::Type *, string> type_name;
-    extern map<llvm::Type *, uint32_t> type_size;
 
     extern map<string, string> module_name_alias;
 
@@ -0,0 +1,593 @@
+/*
+ * CGGeneric.cpp 2025
+ *
+ * generic functions and objs, instantiated for every type argument
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * generic functions and objs are monomorphized: the source after the type
+ * parameter list is kept as a template, and parsed again with the
+ * parameters bound for every list of type arguments.
+ *
+ *      function max<T>(a: T, b: T) -> T { ... }
+ *      obj Pair<T> { first: T, second: T }
+ *
+ *      max(1, 2)               instance max<i32>, T is inferred
+ *      zero<f64>()             explicit type arguments
+ *      p: Pair<i32>            instance Pair<i32>
+ *
+ * type arguments are inferred by matching parameter types of the template,
+ * parsed once with opaque placeholders for the type parameters, against
+ * types of the arguments.
+ *
+ * an instance is named after the template and its type arguments, e.g.
+ * _ZN4main8max<i32>, so modules instantiating the same function agree on
+ * it. function instances are linkonce_odr in their own comdat, the linker
+ * keeps one copy, and the optimizer sees a whole body to inline. bodies
+ * are generated after the function using them, when the builder is at
+ * global level.
+ *
+ * templates are exported to interface files as "template.<name>" metadata
+ * and imported with the module.
+ */
+
+#include <deque>
+#include <sstream>
+
+#include "../inc/Parser.h"
+#include "llvm/ADT/Triple.h"
+
+#include "Exception.h"
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::IRBuilder<> *builder;
+    extern SymbolTable *symbol_table;
+    extern TypeTable type_table;
+    extern vector<string> module_path;
+    extern vector<string> module_path_with_module_name;
+
+    map<string, GenericTemplate *> function_templates;
+    map<string, GenericTemplate *> object_templates;
+
+    // template and type arguments of instances and patterns of generic obj
+    static map<llvm::Type *, pair<GenericTemplate *, vector<llvm::Type *>>> generic_objects;
+    static set<llvm::Type *> placeholders;
+
+    struct PendingInstance {
+        shared_ptr<FunctionDecl> decl;
+        GenericTemplate *gt;
+    };
+    static deque<PendingInstance> pending;
+
+    /*
+     * names in a template are resolved in the module defining it
+     */
+    class TemplateModule {
+    private:
+        vector<string> path;
+        vector<string> path_with_module_name;
+
+    public:
+        explicit TemplateModule(GenericTemplate *gt)
+                : path(module_path), path_with_module_name(module_path_with_module_name) {
+            module_path = gt->module_path;
+            module_path_with_module_name = gt->module_path_with_module_name;
+        }
+
+        ~TemplateModule() {
+            module_path = this->path;
+            module_path_with_module_name = this->path_with_module_name;
+        }
+    };
+
+    /**
+     * @description:    key of template in function_templates or object_templates
+     * @param:          gt: template
+     * @return:         key
+     */
+    static string template_key(GenericTemplate *gt) {
+        return gt->is_object ? gt->id : getFunctionNameMangling(gt->module_path_with_module_name, gt->name);
+    }
+
+    /**
+     * @description:    source to parse an instance, line and column of
+     *                  tokens are the same as in the template
+     * @param:          gt: template
+     * @return:         source
+     */
+    static string template_source(GenericTemplate *gt) {
+        return "# " + to_string(gt->line) + "\n" + string(gt->column, ' ') + gt->source;
+    }
+
+    /**
+     * @description:    register a template and export it to interface
+     * @param:          gt: template
+     * @return:         none
+     */
+    void llvm_register_template(GenericTemplate *gt) {
+        string key = template_key(gt);
+        auto &templates = gt->is_object ? object_templates : function_templates;
+        templates[key] = gt;
+
+        string params, attrs;
+        for (auto &i: gt->params) {
+            params += (params.empty() ? "" : ",") + i;
+        }
+        if (gt->is_inline) attrs += "inline,";
+        if (gt->is_always_inline) attrs += "always_inline,";
+        if (gt->is_noinline) attrs += "noinline,";
+        if (gt->is_pure) attrs += "pure,";
+
+        vector<string> fields = {
+                gt->is_object ? "obj" : "function",
+                gt->id,
+                gt->name,
+                getpathListToUnresolved(gt->module_path),
+                getpathListToUnresolved(gt->module_path_with_module_name),
+                params,
+                to_string(gt->line),
+                to_string(gt->column),
+                attrs,
+                gt->source
+        };
+        vector<llvm::Metadata *> ops;
+        for (auto &i: fields) {
+            ops.push_back(llvm::MDString::get(*the_context, i));
+        }
+        llvm::NamedMDNode *meta = the_module->getOrInsertNamedMetadata("template." + key);
+        meta->clearOperands();
+        meta->addOperand(llvm::MDNode::get(*the_context, ops));
+    }
+
+    /**
+     * @description:    register templates of an imported module
+     * @param:          metadata: named metadata in interface file
+     * @return:         none
+     */
+    void llvm_import_templates(map<string, vector<vector<string>> *> &metadata) {
+        auto path = [](string &s) { return s.empty() ? vector<string>() : getpathUnresolvedToList(s); };
+
+        for (auto &md: metadata) {
+            if (md.first.find("template.") != 0 || md.second->empty()) continue;
+
+            auto &fields = (*md.second)[0];
+            if (fields.size() < 10) continue;
+
+            string key = md.first.substr(9);
+            auto &templates = fields[0] == "obj" ? object_templates : function_templates;
+            if (templates.find(key) != templates.end()) continue;
+
+            auto gt = new GenericTemplate();
+            gt->is_object = fields[0] == "obj";
+            gt->id = fields[1];
+            gt->name = fields[2];
+            gt->module_path = path(fields[3]);
+            gt->module_path_with_module_name = path(fields[4]);
+            std::istringstream params(fields[5]);
+            for (string i; getline(params, i, ',');) {
+                gt->params.push_back(i);
+            }
+            gt->line = atoi(fields[6].c_str());
+            gt->column = atoi(fields[7].c_str());
+            gt->is_inline = fields[8].find("inline,") == 0 || fields[8].find(",inline,") != string::npos;
+            gt->is_always_inline = fields[8].find("always_inline,") != string::npos;
+            gt->is_noinline = fields[8].find("noinline,") != string::npos;
+            gt->is_pure = fields[8].find("pure,") != string::npos;
+            gt->source = fields[9];
+
+            templates[key] = gt;
+        }
+    }
+
+    /**
+     * @description:    short name of type in names of instances, objs are
+     *                  named by id instead of members
+     * @param:          ty: type
+     * @return:         name
+     */
+    static string short_name(llvm::Type *ty) {
+        if (StructDef *sd = findStructDef(ty)) return sd->id;
+
+        if (ty->isPointerTy()) {
+            return short_name(ty->getPointerElementType()) + "*";
+        } else if (ty->isArrayTy()) {
+            return "arr[" + short_name(ty->getArrayElementType()) + ":" + to_string(ty->getArrayNumElements()) + "]";
+        } else if (auto vec = llvm::dyn_cast<llvm::FixedVectorType>(ty)) {
+            return "vec[" + short_name(vec->getElementType()) + ":" + to_string(vec->getNumElements()) + "]";
+        } else if (ty->isStructTy() && llvm::cast<llvm::StructType>(ty)->hasName()) {
+            // placeholders and patterns
+            return ty->getStructName().str();
+        }
+        return type_table.name(ty);
+    }
+
+    /**
+     * @description:    name of instance
+     * @param:          gt: template
+     * @param:          args: type arguments
+     * @return:         id of obj or mangled name of function
+     */
+    string llvm_instance_name(GenericTemplate *gt, vector<llvm::Type *> &args) {
+        string name = gt->is_object ? gt->id : gt->name;
+        name += "<";
+        for (size_t i = 0; i < args.size(); i++) {
+            name += (i ? "," : "") + short_name(args[i]);
+        }
+        name += ">";
+
+        return gt->is_object ? name : getFunctionNameMangling(gt->module_path_with_module_name, name);
+    }
+
+    /**
+     * @description:    check if a type is made of placeholders
+     * @param:          ty: type
+     * @return:         true if it is
+     */
+    static bool is_pattern(llvm::Type *ty) {
+        if (placeholders.find(ty) != placeholders.end()) return true;
+
+        if (ty->isPointerTy()) return is_pattern(ty->getPointerElementType());
+        if (ty->isArrayTy()) return is_pattern(ty->getArrayElementType());
+
+        auto inst = generic_objects.find(ty);
+        if (inst != generic_objects.end()) {
+            for (auto i: inst->second.second) {
+                if (is_pattern(i)) return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @description:    get opaque type for generic obj whose arguments are
+     *                  placeholders, e.g. Pair<T> in parameters of a
+     *                  generic function
+     * @param:          gt: template of obj
+     * @param:          args: type arguments
+     * @return:         the opaque type, or nullptr if args are concrete
+     */
+    llvm::Type *llvm_object_pattern(GenericTemplate *gt, vector<llvm::Type *> &args) {
+        bool concrete = true;
+        for (auto i: args) {
+            if (is_pattern(i)) concrete = false;
+        }
+        if (concrete) return nullptr;
+
+        string name = llvm_instance_name(gt, args);
+        llvm::StructType *Ty = llvm::StructType::getTypeByName(*the_context, name);
+        if (Ty == nullptr) {
+            Ty = llvm::StructType::create(*the_context, name);
+            generic_objects[Ty] = {gt, args};
+        }
+        return Ty;
+    }
+
+    /**
+     * @description:    put a global in a comdat of its own name
+     * @param:          GO: global
+     * @return:         none
+     */
+    static void set_comdat(llvm::GlobalObject *GO) {
+        if (!llvm::Triple(the_module->getTargetTriple()).supportsCOMDAT()) return;
+        GO->setComdat(the_module->getOrInsertComdat(GO->getName()));
+    }
+
+    /**
+     * @description:    record an instance of generic obj
+     * @param:          Ty: type of instance
+     * @param:          gt: template of obj
+     * @param:          args: type arguments
+     * @return:         none
+     */
+    void llvm_object_instance(llvm::Type *Ty, GenericTemplate *gt, vector<llvm::Type *> &args) {
+        gt->object_instances[args] = Ty;
+        generic_objects[Ty] = {gt, args};
+
+        // every module using the instance defines it
+        llvm::GlobalVariable *reserve = the_module->getNamedGlobal(".reserve.object." + llvm_instance_name(gt, args));
+        if (reserve && !reserve->isDeclaration()) {
+            reserve->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+            set_comdat(reserve);
+            llvm_debug_struct(llvm::cast<llvm::StructType>(Ty), gt->line);
+        }
+    }
+
+    /**
+     * @description:    parse an instance of template
+     * @param:          gt: template
+     * @param:          args: types bound to type parameters
+     * @param:          id: name of instance
+     * @return:         FunctionDecl or Object
+     */
+    shared_ptr<AST> llvm_parse_instance(GenericTemplate *gt, vector<Type> &args, string id) {
+        map<string, Type> bindings;
+        for (size_t i = 0; i < gt->params.size(); i++) {
+            bindings[gt->params[i]] = args[i];
+        }
+
+        TemplateModule scope(gt);
+        std::istringstream source(template_source(gt));
+        Lexer lexer(&source);
+        Parser parser(&lexer, bindings);
+
+        if (gt->is_object) {
+            return parser.objectTail(Token(OBJ, string("obj"), gt->line, gt->column), id);
+        }
+        return parser.functionTail(Token(FUNCTION, string("function"), gt->line, gt->column), id);
+    }
+
+    /**
+     * @description:    parse parameter types of generic function with
+     *                  placeholders bound to type parameters
+     * @param:          gt: template of function
+     * @return:         none
+     */
+    static void build_patterns(GenericTemplate *gt) {
+        map<string, Type> bindings;
+        for (auto &i: gt->params) {
+            llvm::StructType *placeholder = llvm::StructType::create(*the_context, i);
+            placeholders.insert(placeholder);
+            gt->placeholders.push_back(placeholder);
+            bindings[i] = Type(placeholder, i);
+        }
+
+        TemplateModule scope(gt);
+        std::istringstream source(template_source(gt));
+        Lexer lexer(&source);
+        Parser parser(&lexer, bindings);
+
+        try {
+            parser.eat(LPAR);
+            auto params = static_pointer_cast<Param>(parser.param());
+            for (Variable *i: params->paramList) {
+                gt->patterns.push_back(i->Ty.first);
+            }
+        } catch (Exception &e) {
+            // e.g. vec[T:4] needs a simple type, then type arguments are
+            // given explicitly
+            gt->patterns.clear();
+        }
+    }
+
+    /**
+     * @description:    match parameter type of template with argument type
+     *                  and bind type parameters in it
+     * @param:          pattern: parameter type made of placeholders
+     * @param:          actual: type of argument
+     * @param:          gt: template of function
+     * @param:          bindings: types bound to type parameters
+     * @param:          explicit_size: parameters bound explicitly, they are
+     *                  not checked, arguments are converted to them
+     * @return:         false if types don't match
+     */
+    static bool unify(llvm::Type *pattern, llvm::Type *actual, GenericTemplate *gt,
+                      vector<llvm::Type *> &bindings, size_t explicit_size) {
+        for (size_t i = 0; i < gt->placeholders.size(); i++) {
+            if (gt->placeholders[i] != pattern) continue;
+
+            if (i < explicit_size) return true;
+            if (bindings[i] == nullptr) bindings[i] = actual;
+            return bindings[i] == actual;
+        }
+
+        if (pattern == actual) return true;
+
+        if (pattern->isPointerTy()) {
+            if (actual->isPointerTy()) {
+                return unify(pattern->getPointerElementType(), actual->getPointerElementType(), gt, bindings,
+                             explicit_size);
+            }
+            // array decays to pointer
+            if (actual->isArrayTy()) {
+                return unify(pattern->getPointerElementType(), actual->getArrayElementType(), gt, bindings,
+                             explicit_size);
+            }
+            return false;
+        }
+
+        if (pattern->isArrayTy() && actual->isArrayTy()) {
+            return pattern->getArrayNumElements() == actual->getArrayNumElements() &&
+                   unify(pattern->getArrayElementType(), actual->getArrayElementType(), gt, bindings, explicit_size);
+        }
+
+        auto pattern_obj = generic_objects.find(pattern);
+        auto actual_obj = generic_objects.find(actual);
+        if (pattern_obj != generic_objects.end() && actual_obj != generic_objects.end() &&
+            pattern_obj->second.first == actual_obj->second.first) {
+            auto &pattern_args = pattern_obj->second.second;
+            auto &actual_args = actual_obj->second.second;
+            for (size_t i = 0; i < pattern_args.size(); i++) {
+                if (!unify(pattern_args[i], actual_args[i], gt, bindings, explicit_size)) return false;
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @description:    type bound to a type parameter by inference
+     * @param:          ty: llvm type
+     * @return:         type with the name given by eatType
+     */
+    static Type bound_type(llvm::Type *ty) {
+        if (StructDef *sd = findStructDef(ty)) return Type(ty, sd->id);
+        if (ty->isPointerTy()) return Type(ty, bound_type(ty->getPointerElementType()).second + "*");
+        if (ty->isArrayTy()) return Type(ty, "arr");
+        if (ty->isVectorTy()) return Type(ty, "vec");
+        return Type(ty, type_table.name(ty));
+    }
+
+    /**
+     * @description:    get instance of generic function for a call, the
+     *                  instance is declared at once and its body is
+     *                  generated by llvm_instantiate_pending
+     * @param:          gt: template of function
+     * @param:          type_args: explicit type arguments
+     * @param:          args: arguments of call
+     * @param:          token: token of call
+     * @return:         instance
+     */
+    llvm::Function *llvm_instantiate_function(GenericTemplate *gt, vector<Type> type_args,
+                                              vector<llvm::Value *> &args, const Token &token) {
+        if (type_args.size() > gt->params.size()) {
+            throw ExceptionFactory<TypeException>(
+                    "'" + gt->id + "' takes " + to_string(gt->params.size()) +
+                    " type arguments but " + to_string(type_args.size()) + " are given",
+                    token.line, token.column
+            );
+        }
+
+        vector<llvm::Type *> bindings(gt->params.size(), nullptr);
+        for (size_t i = 0; i < type_args.size(); i++) {
+            if (type_args[i].first == nullptr || type_args[i].first->isVoidTy()) {
+                throw ExceptionFactory<TypeException>(
+                        "invalid type argument of '" + gt->id + "'",
+                        token.line, token.column
+                );
+            }
+            bindings[i] = type_args[i].first;
+        }
+
+        if (type_args.size() < gt->params.size()) {
+            if (gt->placeholders.empty()) build_patterns(gt);
+
+            for (size_t i = 0; i < gt->patterns.size() && i < args.size(); i++) {
+                if (!args[i]) continue;
+                if (!unify(gt->patterns[i], args[i]->getType(), gt, bindings, type_args.size())) {
+                    throw ExceptionFactory<TypeException>(
+                            "type '" + type_table.name(args[i]->getType()) + "' of argument " + to_string(i + 1) +
+                            " doesn't match parameter of '" + gt->id + "'",
+                            token.line, token.column
+                    );
+                }
+            }
+
+            for (size_t i = 0; i < bindings.size(); i++) {
+                if (bindings[i] == nullptr) {
+                    throw ExceptionFactory<MissingException>(
+                            "can't infer type parameter '" + gt->params[i] + "' of '" + gt->id + "'",
+                            token.line, token.column
+                    );
+                }
+            }
+        }
+
+        auto inst = gt->function_instances.find(bindings);
+        if (inst != gt->function_instances.end()) return inst->second;
+
+        vector<Type> bound;
+        for (auto i: bindings) {
+            bound.push_back(bound_type(i));
+        }
+        string name = llvm_instance_name(gt, bindings);
+        auto decl = static_pointer_cast<FunctionDecl>(llvm_parse_instance(gt, bound, name));
+        decl->is_export = true;
+        decl->is_mangle = false;
+        decl->is_inline = gt->is_inline;
+        decl->is_always_inline = gt->is_always_inline;
+        decl->is_noinline = gt->is_noinline;
+        decl->is_pure = gt->is_pure;
+
+        // declare it now, the body may call the instance itself
+        {
+            TemplateModule scope(gt);
+            shared_ptr<AST> body = decl->compound;
+            decl->compound = nullptr;
+            decl->codeGen();
+            decl->compound = body;
+        }
+
+        llvm::Function *fun = the_module->getFunction(name);
+        gt->function_instances[bindings] = fun;
+        pending.push_back({decl, gt});
+
+        if (symbol_table->depth() == 0) {
+            llvm_instantiate_pending();
+        }
+        return fun;
+    }
+
+    /**
+     * @description:    generate bodies of function instances, instances
+     *                  used by them are generated in the same loop
+     * @return:         none
+     */
+    void llvm_instantiate_pending() {
+        static bool generating = false;
+        if (generating) return;
+        generating = true;
+
+        llvm::BasicBlock *last_BB = builder->GetInsertBlock();
+        llvm::BasicBlock::iterator last_pt;
+        if (last_BB) last_pt = builder->GetInsertPoint();
+
+        auto restore = [&]() {
+            generating = false;
+            if (last_BB) {
+                builder->SetInsertPoint(last_BB, last_pt);
+            } else {
+                builder->ClearInsertionPoint();
+            }
+        };
+
+        try {
+            while (!pending.empty()) {
+                PendingInstance inst = pending.front();
+                pending.pop_front();
+
+                TemplateModule scope(inst.gt);
+                builder->ClearInsertionPoint();
+                inst.decl->codeGen();
+
+                llvm::Function *fun = the_module->getFunction(inst.decl->id);
+                if (fun && !fun->isDeclaration()) {
+                    fun->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+                    set_comdat(fun);
+                }
+            }
+        } catch (...) {
+            restore();
+            throw;
+        }
+        restore();
+    }
+
+    /**
+     * @description:    forget templates and instances of last module
+     * @return:         none
+     */
+    void llvm_generic_reset() {
+        function_templates.clear();
+        object_templates.clear();
+        generic_objects.clear();
+        placeholders.clear();
+        pending.clear();
+    }
+}
@@ -0,0 +1,608 @@
+/*
+ * CGInterface.cpp 2025
+ *
+ * module interface file (.avsii) writer and reader
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * An interface file only keeps what "import" needs from a module:
+ *
+ *      "AVSII" version
+ *      types:      u32 count, type records
+ *      structs:    u32 count, (type id, packed, u32 n, element type ids)
+ *      functions:  u32 count, (name, type id, attribute sets)
+ *      globals:    u32 count, (name, value type id)
+ *      metadata:   u32 count, (name, u32 n, (u32 m, strings))
+ *
+ * all integers are little endian, strings are u32 length + bytes.
+ * identified structs are recorded by name first and get their bodies
+ * afterwards, so a type record only refers to types recorded before it.
+ */
+
+#include <cstdlib>
+#include <cstdint>
+
+#include "../inc/AST.h"
+#include "../inc/SymbolTable.h"
+#include "../inc/FileName.h"
+#include <filesystem>
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/DerivedTypes.h"
+
+#include "Exception.h"
+
+extern bool opt_verbose;
+
+namespace AVSI {
+    using namespace std;
+
+    extern string module_name_nopath;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+
+    extern map<string, StructDef *> struct_types;
+    extern map<string, GenericDef *> generic_function;
+    extern TypeTable type_table;
+
+#define AVSII_MAGIC     "AVSII"
+#define AVSII_VERSION   1
+
+    enum InterfaceTypeKind : uint8_t {
+        IT_VOID = 0,
+        IT_HALF,
+        IT_FLOAT,
+        IT_DOUBLE,
+        IT_FP128,
+        IT_INT,
+        IT_POINTER,
+        IT_ARRAY,
+        IT_VECTOR,
+        IT_STRUCT,
+        IT_LITERAL_STRUCT,
+        IT_FUNCTION
+    };
+
+    class InterfaceWriter {
+    private:
+        string buf;
+        map<llvm::Type *, uint32_t> type_id;
+        vector<llvm::StructType *> pending_structs;
+        string types;
+        uint32_t type_count = 0;
+
+        void put(string &out, uint32_t v) {
+            for (int i = 0; i < 4; i++) out.push_back((char) ((v >> (i * 8)) & 0xff));
+        }
+
+        void put(string &out, const llvm::StringRef &s) {
+            put(out, (uint32_t) s.size());
+            out.append(s.data(), s.size());
+        }
+
+    public:
+        /**
+         * @description:    get id of a type, record it if it is new
+         * @param:          Ty: type
+         * @return:         type id
+         */
+        uint32_t type(llvm::Type *Ty) {
+            auto iter = type_id.find(Ty);
+            if (iter != type_id.end()) return iter->second;
+
+            string rec;
+            if (Ty->isVoidTy()) {
+                rec.push_back(IT_VOID);
+            } else if (Ty->isHalfTy()) {
+                rec.push_back(IT_HALF);
+            } else if (Ty->isFloatTy()) {
+                rec.push_back(IT_FLOAT);
+            } else if (Ty->isDoubleTy()) {
+                rec.push_back(IT_DOUBLE);
+            } else if (Ty->isFP128Ty()) {
+                rec.push_back(IT_FP128);
+            } else if (Ty->isIntegerTy()) {
+                rec.push_back(IT_INT);
+                put(rec, Ty->getIntegerBitWidth());
+            } else if (Ty->isPointerTy()) {
+                uint32_t elem = type(Ty->getPointerElementType());
+                rec.push_back(IT_POINTER);
+                put(rec, elem);
+                put(rec, Ty->getPointerAddressSpace());
+            } else if (Ty->isArrayTy()) {
+                uint32_t elem = type(Ty->getArrayElementType());
+                rec.push_back(IT_ARRAY);
+                put(rec, elem);
+                put(rec, (uint32_t) Ty->getArrayNumElements());
+            } else if (auto VTy = llvm::dyn_cast<llvm::FixedVectorType>(Ty)) {
+                uint32_t elem = type(VTy->getElementType());
+                rec.push_back(IT_VECTOR);
+                put(rec, elem);
+                put(rec, VTy->getNumElements());
+            } else if (auto STy = llvm::dyn_cast<llvm::StructType>(Ty)) {
+                if (STy->isLiteral()) {
+                    vector<uint32_t> elems;
+                    for (auto i: STy->elements()) elems.push_back(type(i));
+                    rec.push_back(IT_LITERAL_STRUCT);
+                    rec.push_back((char) STy->isPacked());
+                    put(rec, (uint32_t) elems.size());
+                    for (auto i: elems) put(rec, i);
+                } else {
+                    // body is written later, a struct may refer to itself
+                    rec.push_back(IT_STRUCT);
+                    put(rec, STy->getName());
+                    pending_structs.push_back(STy);
+                }
+            } else if (auto FTy = llvm::dyn_cast<llvm::FunctionType>(Ty)) {
+                vector<uint32_t> params;
+                uint32_t ret = type(FTy->getReturnType());
+                for (auto i: FTy->params()) params.push_back(type(i));
+                rec.push_back(IT_FUNCTION);
+                put(rec, ret);
+                rec.push_back((char) FTy->isVarArg());
+                put(rec, (uint32_t) params.size());
+                for (auto i: params) put(rec, i);
+            } else {
+                string tystr;
+                llvm::raw_string_ostream os(tystr);
+                Ty->print(os);
+                throw ExceptionFactory<IRErrException>(
+                        "type '" + os.str() + "' can not be exported to module interface",
+                        0, 0);
+            }
+
+            types.append(rec);
+            type_id[Ty] = type_count;
+            return type_count++;
+        }
+
+        /**
+         * @description:    serialize exported declarations of a module
+         * @param:          M: module
+         * @return:         interface data
+         */
+        string write(llvm::Module &M) {
+            string functions, globals, metadata, structs;
+            uint32_t function_count = 0, global_count = 0, metadata_count = 0;
+
+            for (auto &fun: M.functions()) {
+                if (!fun.hasExternalLinkage() && !fun.hasAvailableExternallyLinkage()) continue;
+                // llvm.dbg.declare and other intrinsics are never imported
+                if (fun.isIntrinsic()) continue;
+
+                put(functions, fun.getName());
+                put(functions, type(fun.getFunctionType()));
+
+                // only enum attributes carry meaning for a declaration
+                auto attrs = fun.getAttributes();
+                vector<pair<uint32_t, vector<llvm::StringRef>>> sets;
+                for (unsigned idx: attrs.indexes()) {
+                    vector<llvm::StringRef> names;
+                    for (auto attr: attrs.getAttributes(idx)) {
+                        if (attr.isEnumAttribute()) {
+                            names.push_back(llvm::Attribute::getNameFromAttrKind(attr.getKindAsEnum()));
+                        }
+                    }
+                    if (!names.empty()) sets.emplace_back(idx, names);
+                }
+                put(functions, (uint32_t) sets.size());
+                for (auto &s: sets) {
+                    put(functions, s.first);
+                    put(functions, (uint32_t) s.second.size());
+                    for (auto &n: s.second) put(functions, n);
+                }
+                function_count++;
+            }
+
+            for (auto &glb: M.globals()) {
+                if (glb.getLinkage() == llvm::GlobalValue::LinkageTypes::PrivateLinkage) continue;
+
+                put(globals, glb.getName());
+                put(globals, type(glb.getValueType()));
+                global_count++;
+            }
+
+            // only metadata made of strings is exported, like struct.* and generic.*
+            for (auto &md: M.named_metadata()) {
+                // imports of a module are not imported by its importers
+                if (md.getName() == MODULE_IMPORTS_MD) continue;
+
+                bool is_string_node = true;
+                for (auto node: md.operands()) {
+                    for (auto &op: node->operands()) {
+                        if (!llvm::dyn_cast_or_null<llvm::MDString>(op.get())) {
+                            is_string_node = false;
+                        }
+                    }
+                }
+                if (!is_string_node) continue;
+
+                put(metadata, md.getName());
+                put(metadata, md.getNumOperands());
+                for (auto node: md.operands()) {
+                    put(metadata, node->getNumOperands());
+                    for (auto &op: node->operands()) {
+                        put(metadata, llvm::dyn_cast<llvm::MDString>(op.get())->getString());
+                    }
+                }
+                metadata_count++;
+            }
+
+            // bodies of structs may record new types, so loop until nothing is pending
+            uint32_t struct_count = 0;
+            for (size_t i = 0; i < pending_structs.size(); i++) {
+                llvm::StructType *STy = pending_structs[i];
+                if (STy->isOpaque()) continue;
+
+                vector<uint32_t> elems;
+                for (auto e: STy->elements()) elems.push_back(type(e));
+                put(structs, type_id[STy]);
+                structs.push_back((char) STy->isPacked());
+                put(structs, (uint32_t) elems.size());
+                for (auto e: elems) put(structs, e);
+                struct_count++;
+            }
+
+            buf = AVSII_MAGIC;
+            buf.push_back((char) AVSII_VERSION);
+            put(buf, type_count);
+            buf.append(types);
+            put(buf, struct_count);
+            buf.append(structs);
+            put(buf, function_count);
+            buf.append(functions);
+            put(buf, global_count);
+            buf.append(globals);
+            put(buf, metadata_count);
+            buf.append(metadata);
+
+            return buf;
+        }
+    };
+
+    class InterfaceReader {
+    private:
+        const char *cur;
+        const char *end;
+        string unparsed_name;
+        int line, col;
+        vector<llvm::Type *> types;
+
+        [[noreturn]] void error() {
+            throw ExceptionFactory<IRErrException>(
+                    "broken interface file of module " + unparsed_name,
+                    line, col);
+        }
+
+        uint8_t u8() {
+            if (cur + 1 > end) error();
+            return (uint8_t) *cur++;
+        }
+
+        uint32_t u32() {
+            if (cur + 4 > end) error();
+            uint32_t v = 0;
+            for (int i = 0; i < 4; i++) v |= ((uint32_t) (uint8_t) cur[i]) << (i * 8);
+            cur += 4;
+            return v;
+        }
+
+        string str() {
+            uint32_t size = u32();
+            if (cur + size > end) error();
+            string s(cur, size);
+            cur += size;
+            return s;
+        }
+
+        llvm::Type *type() {
+            uint32_t id = u32();
+            if (id >= types.size()) error();
+            return types[id];
+        }
+
+    public:
+        /*
+         * decoded module interface
+         */
+        struct Function {
+            string name;
+            llvm::FunctionType *Ty;
+            llvm::AttributeList attrs;
+        };
+
+        vector<llvm::StructType *> structs;
+        vector<Function> functions;
+        vector<pair<string, llvm::Type *>> globals;
+        vector<pair<string, vector<vector<string>>>> metadata;
+
+        InterfaceReader(const char *begin, const char *end, string unparsed_name, int line, int col)
+                : cur(begin), end(end), unparsed_name(unparsed_name), line(line), col(col) {}
+
+        void read() {
+            auto &C = *the_context;
+
+            string magic = AVSII_MAGIC;
+            if ((size_t) (end - cur) < magic.size() || string(cur, magic.size()) != magic) error();
+            cur += magic.size();
+            if (u8() != AVSII_VERSION) {
+                throw ExceptionFactory<IRErrException>(
+                        "interface file of module " + unparsed_name + " is built by another version of compiler",
+                        line, col);
+            }
+
+            uint32_t type_count = u32();
+            for (uint32_t i = 0; i < type_count; i++) {
+                llvm::Type *Ty = nullptr;
+                switch (u8()) {
+                    case IT_VOID:
+                        Ty = llvm::Type::getVoidTy(C);
+                        break;
+                    case IT_HALF:
+                        Ty = llvm::Type::getHalfTy(C);
+                        break;
+                    case IT_FLOAT:
+                        Ty = llvm::Type::getFloatTy(C);
+                        break;
+                    case IT_DOUBLE:
+                        Ty = llvm::Type::getDoubleTy(C);
+                        break;
+                    case IT_FP128:
+                        Ty = llvm::Type::getFP128Ty(C);
+                        break;
+                    case IT_INT:
+                        Ty = llvm::Type::getIntNTy(C, u32());
+                        break;
+                    case IT_POINTER: {
+                        llvm::Type *elem = type();
+                        Ty = elem->getPointerTo(u32());
+                        break;
+                    }
+                    case IT_ARRAY: {
+                        llvm::Type *elem = type();
+                        Ty = llvm::ArrayType::get(elem, u32());
+                        break;
+                    }
+                    case IT_VECTOR: {
+                        llvm::Type *elem = type();
+                        Ty = llvm::FixedVectorType::get(elem, u32());
+                        break;
+                    }
+                    case IT_STRUCT: {
+                        // a struct imported by several modules is the same type
+                        string name = str();
+                        auto STy = llvm::StructType::getTypeByName(C, name);
+                        if (!STy) STy = llvm::StructType::create(C, name);
+                        structs.push_back(STy);
+                        Ty = STy;
+                        break;
+                    }
+                    case IT_LITERAL_STRUCT: {
+                        bool packed = u8();
+                        uint32_t n = u32();
+                        vector<llvm::Type *> elems;
+                        for (uint32_t j = 0; j < n; j++) elems.push_back(type());
+                        Ty = llvm::StructType::get(C, elems, packed);
+                        break;
+                    }
+                    case IT_FUNCTION: {
+                        llvm::Type *ret = type();
+                        bool vararg = u8();
+                        uint32_t n = u32();
+                        vector<llvm::Type *> params;
+                        for (uint32_t j = 0; j < n; j++) params.push_back(type());
+                        Ty = llvm::FunctionType::get(ret, params, vararg);
+                        break;
+                    }
+                    default:
+                        error();
+                }
+                types.push_back(Ty);
+            }
+
+            uint32_t struct_count = u32();
+            for (uint32_t i = 0; i < struct_count; i++) {
+                auto STy = llvm::dyn_cast<llvm::StructType>(type());
+                if (!STy) error();
+                bool packed = u8();
+                uint32_t n = u32();
+                vector<llvm::Type *> elems;
+                for (uint32_t j = 0; j < n; j++) elems.push_back(type());
+                if (STy->isOpaque()) STy->setBody(elems, packed);
+            }
+
+            uint32_t function_count = u32();
+            for (uint32_t i = 0; i < function_count; i++) {
+                Function f;
+                f.name = str();
+                f.Ty = llvm::dyn_cast<llvm::FunctionType>(type());
+                if (!f.Ty) error();
+
+                uint32_t set_count = u32();
+                for (uint32_t j = 0; j < set_count; j++) {
+                    uint32_t idx = u32();
+                    uint32_t n = u32();
+                    llvm::AttrBuilder B(C);
+                    for (uint32_t k = 0; k < n; k++) {
+                        auto kind = llvm::Attribute::getAttrKindFromName(str());
+                        if (kind != llvm::Attribute::None) B.addAttribute(kind);
+                    }
+                    f.attrs = f.attrs.addAttributesAtIndex(C, idx, B);
+                }
+                functions.push_back(f);
+            }
+
+            uint32_t global_count = u32();
+            for (uint32_t i = 0; i < global_count; i++) {
+                string name = str();
+                globals.emplace_back(name, type());
+            }
+
+            uint32_t metadata_count = u32();
+            for (uint32_t i = 0; i < metadata_count; i++) {
+                string name = str();
+                uint32_t n = u32();
+                vector<vector<string>> nodes;
+                for (uint32_t j = 0; j < n; j++) {
+                    uint32_t m = u32();
+                    vector<string> node;
+                    for (uint32_t k = 0; k < m; k++) node.push_back(str());
+                    nodes.push_back(node);
+                }
+                metadata.emplace_back(name, nodes);
+            }
+        }
+    };
+
+    /**
+     * @description:    emit interface file of current module, which is
+     *                  used by "import" instead of bitcode
+     * @return:         none
+     */
+    void llvm_emit_interface() {
+        std::filesystem::path dir = filesystem::path(input_file_path_absolut).filename();
+        string file_basename;
+        if (input_file_name_no_suffix == MODULE_INIT_NAME)
+            file_basename = dir.string();
+        else if (input_file_name_no_suffix == MODULE_LIB_NAME)
+            file_basename = module_name_nopath;
+        else
+            file_basename = input_file_name_no_suffix;
+
+        auto Filename =
+                output_root_path + SYSTEM_PATH_DIVIDER + input_file_path_relative + SYSTEM_PATH_DIVIDER +
+                string(file_basename) + ".avsii";
+        llvm_create_dir(filesystem::path(Filename).parent_path());
+
+        InterfaceWriter writer;
+        string data = writer.write(*the_module);
+
+        std::error_code EC;
+        llvm::raw_fd_ostream dest(Filename, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            llvm::errs() << "Could not open file: " << EC.message();
+            return;
+        }
+        dest << data;
+        dest.flush();
+
+        if (opt_verbose) llvm::outs() << "Wrote " << filesystem::absolute(filesystem::path(Filename)) << "\n";
+
+        dest.close();
+    }
+
+    /**
+     * @description:    read an interface file and import its symbols
+     * @param:          filename: path to .avsii file
+     * @param:          unparsed_name: module name used in error message
+     * @param:          line: line of "import" keyword
+     * @param:          col: column of "import" keyword
+     * @return:         none
+     */
+    void llvm_import_interface(string filename, string unparsed_name, int line, int col) {
+        auto mbuf = llvm::MemoryBuffer::getFile(filename);
+        if (!mbuf) {
+            throw ExceptionFactory<MissingException>(
+                    "error occurred when reading module " + unparsed_name,
+                    line, col);
+        }
+
+        InterfaceReader reader((*mbuf)->getBufferStart(), (*mbuf)->getBufferEnd(), unparsed_name, line, col);
+        reader.read();
+
+        // import function
+        for (auto &fun: reader.functions) {
+            the_module->getOrInsertFunction(fun.name, fun.Ty, fun.attrs);
+        }
+
+        // import global
+        for (auto &glb: reader.globals) {
+            the_module->getOrInsertGlobal(glb.first, glb.second);
+        }
+
+        // import named metadata
+        map<string, vector<vector<string>> *> metadata;
+        for (auto &md: reader.metadata) {
+            metadata[md.first] = &md.second;
+            if (the_module->getNamedMetadata(md.first)) {
+                continue;
+            }
+            auto new_md = the_module->getOrInsertNamedMetadata(md.first);
+            for (auto &node: md.second) {
+                vector<llvm::Metadata *> ops;
+                for (auto &s: node) {
+                    ops.push_back(llvm::MDString::get(*the_context, s));
+                }
+                new_md->addOperand(llvm::MDNode::get(*the_context, ops));
+            }
+        }
+
+        // import struct
+        for (auto i: reader.structs) {
+            string id = string(i->getName());
+            auto md = metadata.find("struct." + id);
+            if (md == metadata.end()) continue;
+
+            auto &nodes = *md->second;
+            ::size_t size = i->getNumElements();
+            if (nodes.size() < size + 2 || nodes[size].empty() || nodes[size + 1].empty()) {
+                throw ExceptionFactory<IRErrException>(
+                        "broken interface file of module " + unparsed_name,
+                        line, col);
+            }
+
+            vector<string> member_names(size);
+            for (int j = 0; j < size; j++) {
+                if (nodes[j].empty()) continue;
+                member_names[j] = nodes[j][0];
+            }
+            registerStruct(id, i, member_names);
+        }
+
+        // import generic
+        for (auto &md: reader.metadata) {
+            if (md.first.find("generic.") != 0 || md.second.empty() || md.second[0].empty()) continue;
+
+            GenericDef *gd = new GenericDef();
+            gd->idx = atoi(md.second[0][0].c_str());
+            for (int j = 1; j < md.second.size(); j++) {
+                if (md.second[j].size() < 2) continue;
+                if (md.second[j][1] == "default") {
+                    gd->function_map[type_table.id(nullptr)] = md.second[j][0];
+                } else {
+                    gd->imported_map[md.second[j][1]] = md.second[j][0];
+                }
+            }
+
+            generic_function[md.first.substr(8)] = gd;
+        }
+
+        // import generic templates
+        llvm_import_templates(metadata);
+    }
+}
@@ -0,0 +1,283 @@
+/*
+ * CGJit.cpp 2025
+ *
+ * run program in-process with ORC LLJIT (--run)
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include "../inc/AST.h"
+#include "../inc/FileName.h"
+#include <filesystem>
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "Exception.h"
+
+extern bool opt_verbose;
+extern bool opt_jit_cache;
+extern std::string jit_cache_path;
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::TargetMachine *TheTargetMachine;
+
+#define LIBAVSI_NAME    "libavsi.a"
+
+    /**
+     * @description:    get bitcode files recorded by "import" in a module
+     * @param:          M: module
+     * @return:         absolute paths to .bc files
+     */
+    static vector<string> jit_module_imports(llvm::Module &M) {
+        vector<string> files;
+        if (auto imports = M.getNamedMetadata(MODULE_IMPORTS_MD)) {
+            for (auto node: imports->operands()) {
+                files.push_back(llvm::cast<llvm::MDString>(node->getOperand(0))->getString().str());
+            }
+        }
+        return files;
+    }
+
+    /*
+     * machine code of jitted modules on disk. an object is found by hash
+     * of module bitcode and code generation flags, so a module changed in
+     * any way is compiled again. files are named like those of ThinLTO
+     * cache, then llvm::pruneCache can clean old ones
+     */
+    class JitObjectCache : public llvm::ObjectCache {
+    private:
+        string dir;
+        string flags;
+        // key is taken before code generation, which may change the module
+        map<const llvm::Module *, string> keys;
+        // modules of program. those made by jit itself hold addresses of
+        // this process and can't be reused
+        set<const llvm::Module *> modules;
+
+        string key(const llvm::Module *M) {
+            llvm::SmallVector<char, 0> buffer;
+            llvm::raw_svector_ostream os(buffer);
+            llvm::WriteBitcodeToFile(*M, os);
+
+            llvm::SHA1 hasher;
+            hasher.update(llvm::StringRef(buffer.data(), buffer.size()));
+            hasher.update(flags);
+            return llvm::toHex(hasher.final());
+        }
+
+    public:
+        JitObjectCache(string dir, string flags) : dir(dir), flags(flags) {}
+
+        void notifyObjectCompiled(const llvm::Module *M, llvm::MemoryBufferRef Obj) override {
+            auto iter = keys.find(M);
+            if (iter == keys.end()) return;
+            string file = dir + SYSTEM_PATH_DIVIDER + "llvmcache-" + iter->second;
+            keys.erase(iter);
+
+            // other runs may read the cache at the same time
+            int fd;
+            llvm::SmallString<128> temp;
+            if (llvm::sys::fs::createUniqueFile(file + ".tmp-%%%%%%", fd, temp)) return;
+            {
+                llvm::raw_fd_ostream os(fd, true);
+                os << Obj.getBuffer();
+            }
+            if (llvm::sys::fs::rename(temp, file)) llvm::sys::fs::remove(temp);
+        }
+
+        void add(const llvm::Module *M) {
+            modules.insert(M);
+        }
+
+        unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) override {
+            if (!modules.count(M)) return nullptr;
+
+            string k = key(M);
+            string file = dir + SYSTEM_PATH_DIVIDER + "llvmcache-" + k;
+            auto mbuf = llvm::MemoryBuffer::getFile(file);
+            if (!mbuf) {
+                keys[M] = k;
+                return nullptr;
+            }
+            if (opt_verbose) llvm::outs() << "JIT cache hit " << M->getModuleIdentifier() << "\n";
+            return std::move(*mbuf);
+        }
+
+        void prune() {
+            auto policy = llvm::parseCachePruningPolicy("");
+            if (policy) llvm::pruneCache(dir, *policy);
+            else llvm::consumeError(policy.takeError());
+        }
+    };
+
+    /**
+     * @description:    folder of jit cache, --jit-cache or
+     *                  $XDG_CACHE_HOME/avsi/jit or ~/.cache/avsi/jit
+     * @return:         path, empty if no folder can be used
+     */
+    static string jit_cache_dir() {
+        if (!jit_cache_path.empty()) return jit_cache_path;
+
+        llvm::SmallString<128> dir;
+        if (!llvm::sys::path::cache_directory(dir)) return "";
+        llvm::sys::path::append(dir, "avsi", "jit");
+        return dir.str().str();
+    }
+
+    static void jit_check(llvm::Error err, string what) {
+        if (err) {
+            throw ExceptionFactory<SysErrException>(
+                    what + ": " + llvm::toString(std::move(err)),
+                    0, 0);
+        }
+    }
+
+    /**
+     * @description:    jit current module and all modules it imports, then
+     *                  call main in this process. C functions of std are
+     *                  taken from libavsi.a and others from the process
+     * @param:          args: program name and arguments passed to main
+     * @return:         exit code of main
+     */
+    int llvm_jit_run(vector<string> args) {
+        unique_ptr<JitObjectCache> cache;
+        string cache_dir = opt_jit_cache ? jit_cache_dir() : "";
+        if (!cache_dir.empty() && !llvm::sys::fs::create_directories(cache_dir)) {
+            // objects are only valid for the same compiler and target
+            // jit compiles for the cpu of this machine
+            string flags = string(LLVM_VERSION_STRING) + ";" + TheTargetMachine->getTargetTriple().str() + ";" +
+                           llvm::sys::getHostCPUName().str() + ";" + to_string((int) TheTargetMachine->getOptLevel());
+            cache = make_unique<JitObjectCache>(cache_dir, flags);
+        }
+
+        llvm::orc::LLJITBuilder builder;
+        builder.setCompileFunctionCreator(
+                [&cache](llvm::orc::JITTargetMachineBuilder JTMB)
+                        -> llvm::Expected<unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+                    JTMB.setCodeGenOptLevel(TheTargetMachine->getOptLevel());
+                    auto TM = JTMB.createTargetMachine();
+                    if (!TM) return TM.takeError();
+                    return make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*TM), cache.get());
+                });
+        auto jit = builder.create();
+        if (!jit) jit_check(jit.takeError(), "failed to create jit");
+        auto &JD = (*jit)->getMainJITDylib();
+
+        // printf, malloc, libm and so on
+        auto process = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                (*jit)->getDataLayout().getGlobalPrefix());
+        if (!process) jit_check(process.takeError(), "failed to search symbols of process");
+        JD.addGenerator(std::move(*process));
+
+        bool found_libavsi = false;
+        for (auto &dir: library_path) {
+            string file = dir + SYSTEM_PATH_DIVIDER + LIBAVSI_NAME;
+            if (!filesystem::exists(file)) continue;
+
+            auto archive = llvm::orc::StaticLibraryDefinitionGenerator::Load(
+                    (*jit)->getObjLinkingLayer(), file.c_str());
+            if (!archive) jit_check(archive.takeError(), "failed to load " + file);
+            JD.addGenerator(std::move(*archive));
+            found_libavsi = true;
+            break;
+        }
+        if (!found_libavsi) {
+            Warning(LIBAVSI_NAME " is not found, add its folder by -L", 0, 0);
+        }
+
+        // bitcode of imported modules, modules imported by them are found
+        // in their own metadata
+        deque<string> queue;
+        for (auto &i: jit_module_imports(*the_module)) queue.push_back(i);
+
+        // the jit owns current module from here
+        llvm_lower_ifuncs(*the_module);
+        the_module->setDataLayout((*jit)->getDataLayout());
+        if (cache) cache->add(the_module);
+        jit_check((*jit)->addIRModule(llvm::orc::ThreadSafeModule(
+                unique_ptr<llvm::Module>(the_module),
+                unique_ptr<llvm::LLVMContext>(the_context))), "failed to add module");
+        the_module = nullptr;
+        the_context = nullptr;
+
+        llvm::orc::ThreadSafeContext imported_context(make_unique<llvm::LLVMContext>());
+        set<string> loaded;
+        while (!queue.empty()) {
+            string file = queue.front();
+            queue.pop_front();
+            if (!loaded.insert(file).second) continue;
+
+            llvm::SMDiagnostic err;
+            auto M = llvm::parseIRFile(file, err, *imported_context.getContext());
+            if (!M) {
+                throw ExceptionFactory<SysErrException>(
+                        "failed to load " + file + ": " + err.getMessage().str(),
+                        0, 0);
+            }
+            if (opt_verbose) llvm::outs() << "JIT " << file << "\n";
+
+            for (auto &i: jit_module_imports(*M)) queue.push_back(i);
+            llvm_lower_ifuncs(*M);
+            M->setDataLayout((*jit)->getDataLayout());
+            if (cache) cache->add(M.get());
+            jit_check((*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(M), imported_context)),
+                      "failed to add " + file);
+        }
+
+        jit_check((*jit)->initialize(JD), "failed to run initializers");
+
+        auto main_symbol = (*jit)->lookup(ENTRY_NAME);
+        if (!main_symbol) jit_check(main_symbol.takeError(), "failed to find entry");
+
+        auto main_fun = (int (*)(int, char *[])) main_symbol->getAddress();
+        int ret = llvm::orc::runAsMain(main_fun, llvm::ArrayRef<string>(args).drop_front(), llvm::StringRef(args[0]));
+
+        jit_check((*jit)->deinitialize(JD), "failed to run finalizers");
+        if (cache) cache->prune();
+        return ret;
+    }
+}
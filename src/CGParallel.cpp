@@ -0,0 +1,468 @@
+/*
+ * CGParallel.cpp 2025
+ *
+ * parallel for: outlined loop bodies run by the thread pool of libavsi
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * a loop marked with
+ *
+ *      parallel(dynamic, 16) reduce(+: sum) for (i = a; i < b; i = i + s) do
+ *          ...
+ *      done
+ *
+ * is split into a function running the iterations and a call of the runtime
+ * in libavsi (parallel.c):
+ *
+ *      void f.parallel(i8 *ctx, i8 *loop) {
+ *          sum = 0
+ *          while (__avsi_parallel_next(loop, &begin, &end))
+ *              for (k = begin; k < end; k++) { i = a + k * s; body }
+ *          __avsi_parallel_lock(loop); sum' += sum; __avsi_parallel_unlock(loop)
+ *      }
+ *
+ *      __avsi_parallel_for(f.parallel, &ctx, count, schedule, chunk)
+ *
+ * every thread of the pool calls f.parallel once and takes chunks of the
+ * iteration space [0, count) until it is used up. the body is generated in
+ * place with the symbol table of the enclosing function, so names resolve
+ * as in a normal loop. values of the enclosing function used by the body
+ * are then moved to ctx: a variable is shared through its address, the
+ * loop variable and reduction variables are private to each thread.
+ */
+
+#include <set>
+
+#include "../inc/AST.h"
+#include "../inc/SymbolTable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Verifier.h"
+
+#include "Exception.h"
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::IRBuilder<> *builder;
+
+    extern llvm::Type *F64_TY;
+    extern llvm::Type *I64_TY;
+    extern llvm::Type *I32_TY;
+    extern llvm::Type *I8_TY;
+    extern llvm::Type *VOID_TY;
+
+    extern SymbolTable *symbol_table;
+    extern TypeTable type_table;
+
+#define PARALLEL_FOR_FUNCTION       "__avsi_parallel_for"
+#define PARALLEL_NEXT_FUNCTION      "__avsi_parallel_next"
+#define PARALLEL_LOCK_FUNCTION      "__avsi_parallel_lock"
+#define PARALLEL_UNLOCK_FUNCTION    "__avsi_parallel_unlock"
+
+    // outlined bodies being generated
+    static set<llvm::Function *> parallel_bodies;
+
+    /*
+     * for (i = start; i < end; i = i + step), < may also be <=, or > and >=
+     * with i = i - step
+     */
+    struct CanonicalLoop {
+        Variable *var;
+        shared_ptr<AST> start;
+        shared_ptr<AST> end;
+        shared_ptr<AST> step;
+        TokenType cmp;
+    };
+
+    /**
+     * @description:    check whether the body of fun is of a parallel for
+     * @param:          fun: function
+     * @return:         true if it is
+     */
+    bool llvm_is_parallel_body(llvm::Function *fun) {
+        return parallel_bodies.count(fun) != 0;
+    }
+
+    /**
+     * @description:    find loop variable, bounds and step of a parallel for
+     * @param:          loop: for loop
+     * @return:         parts of the loop
+     */
+    static CanonicalLoop canonical_loop(For *loop) {
+        auto fail = [&]() {
+            return ExceptionFactory<SyntaxException>(
+                    "parallel for must be like for (i = start; i < end; i = i + step), "
+                    "< may be <=, or > and >= with i = i - step",
+                    loop->getToken().line, loop->getToken().column);
+        };
+        auto single = [&](shared_ptr<AST> list) -> shared_ptr<AST> {
+            auto compound = static_pointer_cast<Compound>(list);
+            if (compound->child.size() != 1) throw fail();
+            return compound->child[0];
+        };
+        auto is_var = [](shared_ptr<AST> ast, const string &id) -> bool {
+            if (ast->__AST_name != __VARIABLE_NAME) return false;
+            auto var = static_pointer_cast<Variable>(ast);
+            return var->offset.empty() && (id.empty() || var->id == id);
+        };
+
+        CanonicalLoop ret;
+
+        auto init = single(loop->initList);
+        if (init->__AST_name != __ASSIGN_NAME) throw fail();
+        auto init_assign = static_pointer_cast<Assign>(init);
+        if (!is_var(init_assign->left, "")) throw fail();
+        ret.var = static_pointer_cast<Variable>(init_assign->left).get();
+        ret.start = init_assign->right;
+        string id = ret.var->id;
+
+        if (loop->noCondition || loop->condition->__AST_name != __BINOP_NAME) throw fail();
+        auto cond = static_pointer_cast<BinOp>(loop->condition);
+        ret.cmp = cond->getOp();
+        if (ret.cmp != LT && ret.cmp != LE && ret.cmp != GT && ret.cmp != GE) throw fail();
+        if (!is_var(cond->left, id)) throw fail();
+        ret.end = cond->right;
+
+        auto adjust = single(loop->adjustment);
+        if (adjust->__AST_name != __ASSIGN_NAME) throw fail();
+        auto adjust_assign = static_pointer_cast<Assign>(adjust);
+        if (!is_var(adjust_assign->left, id) || adjust_assign->right->__AST_name != __BINOP_NAME) throw fail();
+        auto inc = static_pointer_cast<BinOp>(adjust_assign->right);
+        TokenType inc_op = (ret.cmp == LT || ret.cmp == LE) ? PLUS : MINUS;
+        if (inc->getOp() != inc_op || !is_var(inc->left, id)) throw fail();
+        ret.step = inc->right;
+
+        return ret;
+    }
+
+    /**
+     * @description:    value a reduction starts from in every thread
+     * @param:          op: +, *, min or max
+     * @param:          Ty: type of reduction variable
+     * @return:         identity of op
+     */
+    static llvm::Constant *reduction_identity(const string &op, llvm::Type *Ty) {
+        llvm::Type *scalar = Ty->getScalarType();
+        if (op == "+") return llvm::Constant::getNullValue(Ty);
+        if (scalar->isFloatingPointTy()) {
+            if (op == "*") return llvm::ConstantFP::get(Ty, 1.0);
+            return llvm::ConstantFP::getInfinity(Ty, op == "max");
+        }
+        unsigned bits = scalar->getIntegerBitWidth();
+        if (op == "*") return llvm::ConstantInt::get(Ty, 1);
+        if (op == "min") return llvm::ConstantInt::get(Ty, llvm::APInt::getSignedMaxValue(bits));
+        return llvm::ConstantInt::get(Ty, llvm::APInt::getSignedMinValue(bits));
+    }
+
+    /**
+     * @description:    combine two partial results of a reduction
+     * @param:          op: +, *, min or max
+     * @param:          l: left value
+     * @param:          r: right value
+     * @return:         l op r
+     */
+    static llvm::Value *reduction_combine(const string &op, llvm::Value *l, llvm::Value *r) {
+        bool fp = l->getType()->getScalarType()->isFloatingPointTy();
+        if (op == "+") return fp ? builder->CreateFAdd(l, r) : builder->CreateAdd(l, r);
+        if (op == "*") return fp ? builder->CreateFMul(l, r) : builder->CreateMul(l, r);
+        if (op == "min") {
+            return fp ? builder->CreateMinNum(l, r) : builder->CreateBinaryIntrinsic(llvm::Intrinsic::smin, l, r);
+        }
+        return fp ? builder->CreateMaxNum(l, r) : builder->CreateBinaryIntrinsic(llvm::Intrinsic::smax, l, r);
+    }
+
+    /**
+     * @description:    generate a parallel for, the body is outlined to a
+     *                  function called by every thread of the runtime
+     * @param:          loop: for loop with parallel
+     * @return:         NaN as other loops
+     */
+    llvm::Value *llvm_parallel_for(For *loop) {
+        Token token = loop->getToken();
+        CanonicalLoop canonical = canonical_loop(loop);
+        llvm::Function *parent = builder->GetInsertBlock()->getParent();
+        llvm::PointerType *I8_PTR_TY = I8_TY->getPointerTo();
+
+        // bounds, step and chunk are computed once before the loop
+        llvm_debug_location(token.line, token.column);
+        llvm::Value *start = canonical.start->codeGen();
+        llvm::Type *var_ty = canonical.var->Ty.first != VOID_TY ? canonical.var->Ty.first : start->getType();
+        if (!var_ty->isIntegerTy() || var_ty->isIntegerTy(1)) {
+            throw ExceptionFactory<TypeException>(
+                    "loop variable of parallel for must be an integer, not '" + type_table.name(var_ty) + "'",
+                    canonical.var->getToken().line, canonical.var->getToken().column);
+        }
+        start = type_conv(canonical.var, start, start->getType(), var_ty);
+
+        auto to_i64 = [&](llvm::Value *v, shared_ptr<AST> ast) -> llvm::Value * {
+            if (!v->getType()->isIntegerTy()) {
+                throw ExceptionFactory<TypeException>(
+                        "bounds, step and chunk of parallel for must be integers, not '" +
+                        type_table.name(v->getType()) + "'",
+                        ast->getToken().line, ast->getToken().column);
+            }
+            return builder->CreateSExtOrTrunc(v, I64_TY);
+        };
+
+        llvm::Value *first = builder->CreateSExt(start, I64_TY, "parallel.start");
+        llvm::Value *last = to_i64(canonical.end->codeGen(), canonical.end);
+        llvm::Value *step = to_i64(canonical.step->codeGen(), canonical.step);
+        if (auto *c = llvm::dyn_cast<llvm::ConstantInt>(step)) {
+            if (c->getSExtValue() <= 0) {
+                throw ExceptionFactory<LogicException>(
+                        "step of parallel for must be positive",
+                        canonical.step->getToken().line, canonical.step->getToken().column);
+            }
+        }
+
+        // number of iterations, 0 if the loop is not entered
+        bool down = canonical.cmp == GT || canonical.cmp == GE;
+        llvm::Value *distance = down ? builder->CreateSub(first, last) : builder->CreateSub(last, first);
+        llvm::Value *zero = llvm::ConstantInt::get(I64_TY, 0);
+        llvm::Value *one = llvm::ConstantInt::get(I64_TY, 1);
+        llvm::Value *count;
+        if (canonical.cmp == LT || canonical.cmp == GT) {
+            count = builder->CreateSDiv(builder->CreateAdd(distance, builder->CreateSub(step, one)), step);
+            count = builder->CreateSelect(builder->CreateICmpSGT(distance, zero), count, zero, "parallel.count");
+        } else {
+            count = builder->CreateAdd(builder->CreateSDiv(distance, step), one);
+            count = builder->CreateSelect(builder->CreateICmpSGE(distance, zero), count, zero, "parallel.count");
+        }
+
+        llvm::Value *chunk = zero;
+        if (loop->parallel.chunk) chunk = to_i64(loop->parallel.chunk->codeGen(), loop->parallel.chunk);
+
+        struct Reduction {
+            string op;
+            string id;
+            llvm::AllocaInst *shared;
+            llvm::AllocaInst *local;
+        };
+        vector<Reduction> reductions;
+        for (auto &i: loop->parallel.reductions) {
+            Reduction r{i.first, i.second.getValue().any_cast<string>(), nullptr, nullptr};
+            r.shared = symbol_table->find(r.id);
+            if (!r.shared) {
+                throw ExceptionFactory<MissingException>(
+                        "reduction variable '" + r.id + "' is not a local variable",
+                        i.second.line, i.second.column);
+            }
+            llvm::Type *Ty = r.shared->getAllocatedType();
+            llvm::Type *scalar = Ty->getScalarType();
+            bool reducible = (Ty->isIntegerTy() || Ty->isFloatingPointTy() || Ty->isVectorTy()) &&
+                             (scalar->isIntegerTy() || scalar->isFloatingPointTy()) && !scalar->isIntegerTy(1);
+            if (!reducible) {
+                throw ExceptionFactory<TypeException>(
+                        "cannot reduce '" + r.id + "' of type '" + type_table.name(Ty) + "'",
+                        i.second.line, i.second.column);
+            }
+            reductions.push_back(r);
+        }
+
+        llvm::BasicBlock *parentBB = builder->GetInsertBlock();
+        llvm::DebugLoc parent_loc = builder->getCurrentDebugLocation();
+
+        llvm::FunctionType *body_ty = llvm::FunctionType::get(VOID_TY, {I8_PTR_TY, I8_PTR_TY}, false);
+        llvm::Function *body = llvm::Function::Create(
+                body_ty, llvm::Function::InternalLinkage, parent->getName() + ".parallel", the_module);
+        body->addFnAttr(llvm::Attribute::NoUnwind);
+        llvm::Argument *ctx_arg = body->getArg(0);
+        llvm::Argument *loop_arg = body->getArg(1);
+        ctx_arg->setName("ctx");
+        loop_arg->setName("loop");
+        parallel_bodies.insert(body);
+
+        llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*the_context, "entry", body);
+        llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(*the_context, "parallel.next", body);
+        llvm::BasicBlock *chunkBB = llvm::BasicBlock::Create(*the_context, "parallel.chunk", body);
+        llvm::BasicBlock *headBB = llvm::BasicBlock::Create(*the_context, "loop.head", body);
+        llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(*the_context, "loop.body", body);
+        llvm::BasicBlock *adjBB = llvm::BasicBlock::Create(*the_context, "loop.adjust");
+        llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(*the_context, "parallel.done");
+        // target of break, which can't leave a thread of the loop
+        llvm::BasicBlock *breakBB = llvm::BasicBlock::Create(*the_context, "parallel.break");
+
+        // on errors in the body the enclosing function continues as if the
+        // loop was not there
+        size_t depth = symbol_table->depth();
+        try {
+            builder->SetInsertPoint(entryBB);
+            symbol_table->push(entryBB);
+            symbol_table->setLoopExit(breakBB);
+            symbol_table->setLoopEntry(adjBB);
+            if (auto scope = llvm_debug_function(body, body->getName().str(), token.line)) {
+                symbol_table->setDebugScope(scope);
+            }
+
+            llvm::AllocaInst *begin_addr = allocaBlockEntry(body, "begin", I64_TY);
+            llvm::AllocaInst *end_addr = allocaBlockEntry(body, "end", I64_TY);
+            llvm::AllocaInst *iter_addr = allocaBlockEntry(body, "iter", I64_TY);
+            llvm::AllocaInst *var_addr = allocaBlockEntry(body, canonical.var->id, var_ty);
+            symbol_table->insert(canonical.var->id, var_addr, true);
+            for (auto &r: reductions) {
+                r.local = allocaBlockEntry(body, r.id, r.shared->getAllocatedType());
+                builder->CreateStore(reduction_identity(r.op, r.shared->getAllocatedType()), r.local);
+                symbol_table->insert(r.id, r.local, true);
+            }
+            builder->CreateBr(nextBB);
+
+            // take chunks until the iterations are used up
+            builder->SetInsertPoint(nextBB);
+            auto next = the_module->getOrInsertFunction(
+                    PARALLEL_NEXT_FUNCTION, I32_TY, I8_PTR_TY, I64_TY->getPointerTo(), I64_TY->getPointerTo());
+            llvm::Value *more = builder->CreateCall(next, {loop_arg, begin_addr, end_addr});
+            builder->CreateCondBr(builder->CreateICmpNE(more, llvm::ConstantInt::get(I32_TY, 0)), chunkBB, doneBB);
+
+            builder->SetInsertPoint(chunkBB);
+            llvm::Value *end = builder->CreateLoad(I64_TY, end_addr, "end");
+            builder->CreateStore(builder->CreateLoad(I64_TY, begin_addr), iter_addr);
+            builder->CreateBr(headBB);
+
+            builder->SetInsertPoint(headBB);
+            llvm_debug_location(token.line, token.column);
+            llvm::Value *iter = builder->CreateLoad(I64_TY, iter_addr, "iter");
+            builder->CreateCondBr(builder->CreateICmpSLT(iter, end), loopBB, nextBB);
+
+            builder->SetInsertPoint(loopBB);
+            llvm::Value *offset = builder->CreateMul(iter, step);
+            llvm::Value *i = down ? builder->CreateSub(first, offset) : builder->CreateAdd(first, offset);
+            builder->CreateStore(builder->CreateTrunc(i, var_ty), var_addr);
+
+            symbol_table->push(loopBB);
+            llvm::Value *ret = loop->compound->codeGen();
+            if (!((static_pointer_cast<Compound>(loop->compound))->child.empty()) && (!ret)) {
+                return nullptr;
+            }
+            symbol_table->pop();
+
+            if (!builder->GetInsertBlock()->getTerminator()) {
+                builder->CreateBr(adjBB);
+            }
+
+            body->getBasicBlockList().push_back(adjBB);
+            builder->SetInsertPoint(adjBB);
+            llvm_debug_location(token.line, token.column);
+            iter = builder->CreateLoad(I64_TY, iter_addr);
+            builder->CreateStore(builder->CreateNSWAdd(iter, llvm::ConstantInt::get(I64_TY, 1)), iter_addr);
+            builder->CreateBr(headBB);
+            llvm_set_loop_hint(loop->hint, headBB, chunkBB);
+
+            // partial results of this thread go to the variables of the loop
+            body->getBasicBlockList().push_back(doneBB);
+            builder->SetInsertPoint(doneBB);
+            if (!reductions.empty()) {
+                auto lock = the_module->getOrInsertFunction(PARALLEL_LOCK_FUNCTION, VOID_TY, I8_PTR_TY);
+                auto unlock = the_module->getOrInsertFunction(PARALLEL_UNLOCK_FUNCTION, VOID_TY, I8_PTR_TY);
+                builder->CreateCall(lock, {loop_arg});
+                for (auto &r: reductions) {
+                    llvm::Type *Ty = r.shared->getAllocatedType();
+                    llvm::Value *v = reduction_combine(
+                            r.op, builder->CreateLoad(Ty, r.shared), builder->CreateLoad(Ty, r.local));
+                    builder->CreateStore(v, r.shared);
+                }
+                builder->CreateCall(unlock, {loop_arg});
+            }
+            builder->CreateRetVoid();
+            symbol_table->pop();
+
+            if (!breakBB->use_empty()) {
+                throw ExceptionFactory<LogicException>(
+                        "break is not allowed in parallel for",
+                        token.line, token.column);
+            }
+            delete breakBB;
+        } catch (...) {
+            while (symbol_table->depth() > depth) symbol_table->pop();
+            builder->SetInsertPoint(parentBB);
+            builder->SetCurrentDebugLocation(parent_loc);
+            parallel_bodies.erase(body);
+            vector<llvm::BasicBlock *> detached;
+            for (auto BB: {adjBB, doneBB, breakBB}) {
+                if (!BB->getParent()) detached.push_back(BB);
+            }
+            body->dropAllReferences();
+            body->eraseFromParent();
+            for (auto BB: detached) delete BB;
+            throw;
+        }
+
+        // values of the enclosing function are passed by ctx
+        vector<llvm::Value *> captures;
+        set<llvm::Value *> captured;
+        for (auto &BB: *body) {
+            for (auto &I: BB) {
+                for (auto &op: I.operands()) {
+                    llvm::Function *owner = nullptr;
+                    if (auto inst = llvm::dyn_cast<llvm::Instruction>(op.get())) owner = inst->getFunction();
+                    else if (auto arg = llvm::dyn_cast<llvm::Argument>(op.get())) owner = arg->getParent();
+                    if (owner && owner != body && captured.insert(op.get()).second) captures.push_back(op.get());
+                }
+            }
+        }
+
+        vector<llvm::Type *> field_types;
+        for (auto v: captures) field_types.push_back(v->getType());
+        llvm::StructType *ctx_ty = llvm::StructType::get(*the_context, field_types);
+
+        llvm::IRBuilder<> entry(entryBB, entryBB->begin());
+        llvm::Value *ctx = entry.CreateBitCast(ctx_arg, ctx_ty->getPointerTo());
+        for (unsigned idx = 0; idx < captures.size(); idx++) {
+            llvm::Value *v = entry.CreateLoad(field_types[idx], entry.CreateStructGEP(ctx_ty, ctx, idx));
+            captures[idx]->replaceUsesWithIf(v, [&](llvm::Use &U) {
+                auto user = llvm::dyn_cast<llvm::Instruction>(U.getUser());
+                return user && user->getFunction() == body;
+            });
+        }
+
+        parallel_bodies.erase(body);
+        llvm_debug_function_end(body);
+        eraseDeadAggregateLoads(body);
+        if (llvm::verifyFunction(*body, &llvm::outs())) {
+            throw ExceptionFactory<IRErrException>(
+                    "some errors occurred when generating parallel for",
+                    token.line, token.column);
+        }
+
+        builder->SetInsertPoint(parentBB);
+        builder->SetCurrentDebugLocation(parent_loc);
+        llvm::Value *ctx_ptr = llvm::ConstantPointerNull::get(I8_PTR_TY);
+        if (!captures.empty()) {
+            llvm::AllocaInst *ctx_addr = allocaBlockEntry(parent, "parallel.ctx", ctx_ty);
+            for (unsigned idx = 0; idx < captures.size(); idx++) {
+                builder->CreateStore(captures[idx], builder->CreateStructGEP(ctx_ty, ctx_addr, idx));
+            }
+            ctx_ptr = builder->CreateBitCast(ctx_addr, I8_PTR_TY);
+        }
+
+        auto parallel_for = the_module->getOrInsertFunction(
+                PARALLEL_FOR_FUNCTION, VOID_TY, body_ty->getPointerTo(), I8_PTR_TY, I64_TY, I32_TY, I64_TY);
+        builder->CreateCall(parallel_for, {body, ctx_ptr, count,
+                                           llvm::ConstantInt::get(I32_TY, loop->parallel.schedule), chunk});
+
+        return llvm::ConstantFP::getNaN(F64_TY);
+    }
+}
@@ -0,0 +1,279 @@
+/*
+ * CGProfile.cpp 2025
+ *
+ * profile guided optimization: counter instrumentation and profile use
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * -fprofile-generate gives every function a private counter array:
+ *
+ *      counters[0]         times the function is entered
+ *      counters[1 + 2i]    times conditional branch i goes to true side
+ *      counters[2 + 2i]    times conditional branch i goes to false side
+ *
+ * and registers a record {name, cfg hash, counter count, counters} per
+ * function to the runtime in libavsi (profile.c) by a module constructor.
+ * the runtime merges the counts into a text file at exit, one line per
+ * function:
+ *
+ *      name hash n c0 c1 ... c(n-1)
+ *
+ * -fprofile-use reads the file and puts the counts back as function entry
+ * counts, branch weights and a module profile summary, which are used by
+ * the inliner, branch probability and block placement.
+ *
+ * instrumentation and annotation both run on the module right after code
+ * generation, so they see the same branches in the same order.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+
+#include "../inc/AST.h"
+#include "../inc/FileName.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/ProfileSummary.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include "Exception.h"
+
+extern bool opt_verbose;
+
+namespace AVSI {
+    using namespace std;
+
+    extern string module_name;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+
+#define PROFILE_REGISTER_FUNCTION   "__avsi_prof_register"
+
+    /**
+     * @description:    get name of function in profile. private functions of
+     *                  different modules may have the same name
+     * @param:          fun: function
+     * @return:         name in profile
+     */
+    static string profile_function_name(llvm::Function &fun) {
+        if (fun.hasLocalLinkage()) return module_name + ":" + fun.getName().str();
+        return fun.getName().str();
+    }
+
+    /**
+     * @description:    get conditional branches of function in order
+     * @param:          fun: function
+     * @return:         conditional branches
+     */
+    static vector<llvm::BranchInst *> profile_branches(llvm::Function &fun) {
+        vector<llvm::BranchInst *> branches;
+        for (auto &BB: fun) {
+            auto br = llvm::dyn_cast<llvm::BranchInst>(BB.getTerminator());
+            if (br && br->isConditional()) branches.push_back(br);
+        }
+        return branches;
+    }
+
+    /**
+     * @description:    hash of control flow graph, a profile is only used if
+     *                  the function is not changed since it is collected
+     * @param:          fun: function
+     * @return:         FNV-1a hash of successor counts of each block
+     */
+    static uint64_t profile_cfg_hash(llvm::Function &fun) {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (auto &BB: fun) {
+            auto term = BB.getTerminator();
+            hash = (hash ^ (term ? term->getNumSuccessors() : 0)) * 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @description:    insert counters to all defined functions and register
+     *                  them to profile runtime
+     * @param:          filename: profile written by the program at exit
+     * @return:         none
+     */
+    void llvm_profile_instrument(string filename) {
+        auto i8p = llvm::Type::getInt8PtrTy(*the_context);
+        auto i32 = llvm::Type::getInt32Ty(*the_context);
+        auto i64 = llvm::Type::getInt64Ty(*the_context);
+        auto record_ty = llvm::StructType::get(*the_context, {i8p, i64, i32, i64->getPointerTo()});
+
+        vector<llvm::Function *> functions;
+        for (auto &fun: the_module->functions()) {
+            if (!fun.isDeclaration() && !fun.hasAvailableExternallyLinkage()) functions.push_back(&fun);
+        }
+        if (functions.empty()) return;
+
+        llvm::IRBuilder<> builder(*the_context);
+        vector<llvm::Constant *> records;
+
+        for (auto fun: functions) {
+            auto branches = profile_branches(*fun);
+            uint32_t n = 1 + 2 * branches.size();
+            string name = profile_function_name(*fun);
+
+            auto counters_ty = llvm::ArrayType::get(i64, n);
+            auto counters = new llvm::GlobalVariable(
+                    *the_module, counters_ty, false,
+                    llvm::GlobalValue::PrivateLinkage,
+                    llvm::ConstantAggregateZero::get(counters_ty),
+                    "__avsi_prof_cnt." + fun->getName());
+
+            auto increase = [&](llvm::Value *index) {
+                auto zero = llvm::ConstantInt::get(i64, 0);
+                auto ptr = builder.CreateInBoundsGEP(counters_ty, counters, {zero, index});
+                auto count = builder.CreateLoad(i64, ptr);
+                builder.CreateStore(builder.CreateAdd(count, llvm::ConstantInt::get(i64, 1)), ptr);
+            };
+
+            // hash is taken before counters change the function
+            auto hash = profile_cfg_hash(*fun);
+
+            builder.SetInsertPoint(&*fun->getEntryBlock().getFirstInsertionPt());
+            increase(llvm::ConstantInt::get(i64, 0));
+
+            for (uint32_t i = 0; i < branches.size(); i++) {
+                builder.SetInsertPoint(branches[i]);
+                auto index = builder.CreateSelect(
+                        branches[i]->getCondition(),
+                        llvm::ConstantInt::get(i64, 1 + 2 * i),
+                        llvm::ConstantInt::get(i64, 2 + 2 * i));
+                increase(index);
+            }
+
+            auto zero = llvm::ConstantInt::get(i32, 0);
+            records.push_back(llvm::ConstantStruct::get(record_ty, {
+                    llvm::ConstantExpr::getPointerCast(
+                            builder.CreateGlobalStringPtr(name, "__avsi_prof_name", 0, the_module), i8p),
+                    llvm::ConstantInt::get(i64, hash),
+                    llvm::ConstantInt::get(i32, n),
+                    llvm::ConstantExpr::getInBoundsGetElementPtr(counters_ty, counters,
+                                                                 (llvm::ArrayRef<llvm::Constant *>) {zero, zero})
+            }));
+        }
+
+        auto records_ty = llvm::ArrayType::get(record_ty, records.size());
+        auto records_var = new llvm::GlobalVariable(
+                *the_module, records_ty, false,
+                llvm::GlobalValue::PrivateLinkage,
+                llvm::ConstantArray::get(records_ty, records),
+                "__avsi_prof_records");
+
+        // void __avsi_prof_register(char *file, record *records, i32 n)
+        auto register_ty = llvm::FunctionType::get(
+                llvm::Type::getVoidTy(*the_context),
+                {i8p, record_ty->getPointerTo(), i32}, false);
+        auto register_fun = the_module->getOrInsertFunction(PROFILE_REGISTER_FUNCTION, register_ty);
+
+        auto ctor = llvm::Function::Create(
+                llvm::FunctionType::get(llvm::Type::getVoidTy(*the_context), false),
+                llvm::GlobalValue::InternalLinkage,
+                "__avsi_prof_init", the_module);
+        builder.SetInsertPoint(llvm::BasicBlock::Create(*the_context, "entry", ctor));
+        auto zero = llvm::ConstantInt::get(i32, 0);
+        builder.CreateCall(register_fun, {
+                builder.CreateGlobalStringPtr(filename, "__avsi_prof_file", 0, the_module),
+                builder.CreateInBoundsGEP(records_ty, records_var, {zero, zero}),
+                llvm::ConstantInt::get(i32, records.size())
+        });
+        builder.CreateRetVoid();
+
+        llvm::appendToGlobalCtors(*the_module, ctor, 0);
+    }
+
+    /**
+     * @description:    annotate functions with counts collected by a program
+     *                  built with -fprofile-generate
+     * @param:          filename: profile file
+     * @return:         none
+     */
+    void llvm_profile_annotate(string filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            throw ExceptionFactory<SysErrException>(
+                    "can't open profile '" + filename + "'",
+                    0, 0);
+        }
+
+        map<string, pair<uint64_t, vector<uint64_t>>> profile;
+        string line;
+        while (getline(file, line)) {
+            istringstream is(line);
+            string name;
+            uint64_t hash = 0, n = 0;
+            if (!(is >> name >> hash >> n)) continue;
+            vector<uint64_t> counts(n);
+            for (auto &i: counts) is >> i;
+            if (is.fail()) continue;
+            profile[name] = {hash, counts};
+        }
+
+        llvm::InstrProfSummaryBuilder summary(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+        llvm::MDBuilder md(*the_context);
+        bool found = false;
+
+        for (auto &fun: the_module->functions()) {
+            if (fun.isDeclaration() || fun.hasAvailableExternallyLinkage()) continue;
+
+            auto name = profile_function_name(fun);
+            auto iter = profile.find(name);
+            if (iter == profile.end()) continue;
+
+            auto branches = profile_branches(fun);
+            auto &counts = iter->second.second;
+            if (iter->second.first != profile_cfg_hash(fun) || counts.size() != 1 + 2 * branches.size()) {
+                Warning("profile of function '" + fun.getName().str() + "' is out of date, ignored", 0, 0);
+                continue;
+            }
+
+            found = true;
+            fun.setEntryCount(llvm::Function::ProfileCount(counts[0], llvm::Function::PCT_Real));
+            // the first count is taken as entry count, as ours
+            summary.addRecord(llvm::InstrProfRecord(counts));
+
+            for (size_t i = 0; i < branches.size(); i++) {
+                uint64_t taken = counts[1 + 2 * i], not_taken = counts[2 + 2 * i];
+                // weights are 32 bits, scale them down keeping the ratio
+                uint64_t scale = max(taken, not_taken) / UINT32_MAX + 1;
+                branches[i]->setMetadata(
+                        llvm::LLVMContext::MD_prof,
+                        md.createBranchWeights(taken / scale + 1, not_taken / scale + 1));
+            }
+        }
+
+        if (found) {
+            the_module->setProfileSummary(summary.getSummary()->getMD(*the_context),
+                                          llvm::ProfileSummary::PSK_Instr);
+        }
+        if (opt_verbose) llvm::outs() << "Read profile " << filename << "\n";
+    }
+}
@@ -79,8 +79,6 @@ namespace AVSI {
     extern llvm::LLVMContext *the_context;
     extern llvm::Module *the_module;
     extern llvm::IRBuilder<> *builder;
-    extern llvm::legacy::FunctionPassManager *the_function_fpm;
-    extern llvm::legacy::PassManager *the_module_fpm;
 
     extern llvm::TargetMachine *TheTargetMachine;
 
@@ -111,8 +109,7 @@ namespace AVSI {
     extern set<llvm::Type *> simple_types;
     extern map<llvm::Type *, uint8_t> simple_types_map;
 
-    extern map<llvm::Type *, string> type_name;
-    extern map<llvm::Type *, uint32_t> type_size;
+    extern TypeTable type_table;
 
     extern map<string, string> module_name_alias;
 
@@ -121,6 +118,15 @@ namespace AVSI {
     map<string, function<llvm::Value*(FunctionCall*)>> special_function_list = {
         {"min", SF_min},
         {"max", SF_max},
+        {"vsplat", SF_vsplat},
+        {"vshuffle", SF_vshuffle},
+        {"vselect", SF_vselect},
+        {"vany", SF_vany},
+        {"vall", SF_vall},
+        {"vsum", SF_vsum},
+        {"vmin", SF_vmin},
+        {"vmax", SF_vmax},
+        {"vdot", SF_vdot},
     };
 
     /*******************************************************
@@ -163,14 +169,14 @@ namespace AVSI {
 
         if (simple_types.find(l_type) == simple_types.end()) {
             throw ExceptionFactory<MathException>(
-                "unsupported left type '" + type_name[l_type] + "' and '" + type_name[r_type] + "' to binary expression",
+                "unsupported left type '" + type_table.name(l_type) + "' and '" + type_table.name(r_type) + "' to binary expression",
                 ast->getToken().line, ast->getToken().column
             );
         }
 
         if (simple_types.find(r_type) == simple_types.end()) {
             throw ExceptionFactory<MathException>(
-                "unsupported right type '" + type_name[r_type] + "' and '" + type_name[r_type] + "' to binary expression",
+                "unsupported right type '" + type_table.name(r_type) + "' and '" + type_table.name(r_type) + "' to binary expression",
                 ast->getToken().line, ast->getToken().column
             );
         }
@@ -222,6 +228,106 @@ namespace AVSI {
         return float_point;
     }
 
+    /**
+     * @description:    convert operands of a vector builtin to the same vector
+     *                  type, a scalar is broadcast to the other operand
+     * @param           ast: the function call AST
+     * @param           lv: the left operand, replaced by the converted one
+     * @param           rv: the right operand, replaced by the converted one
+     * @return:         none
+     */
+    void SF_convert_vector_operand(FunctionCall *ast, llvm::Value *&lv, llvm::Value *&rv) {
+        if (!lv || !rv) {
+            throw ExceptionFactory<IRErrException>(
+                "left or right operand must have a value",
+                ast->getToken().line, ast->getToken().column
+            );
+        }
+
+        auto l_type = lv->getType();
+        auto r_type = rv->getType();
+        if (!l_type->isVectorTy()) lv = type_conv(ast, lv, l_type, r_type);
+        else if (!r_type->isVectorTy()) rv = type_conv(ast, rv, r_type, l_type);
+
+        if (lv->getType() != rv->getType()) {
+            throw ExceptionFactory<MathException>(
+                "unmatched vector types '" + type_table.name(lv->getType()) + "' and '" + type_table.name(rv->getType()) + "'",
+                ast->getToken().line, ast->getToken().column
+            );
+        }
+    }
+
+    /**
+     * @description:    generate an argument which must be a vector
+     * @param           ast: the function call AST
+     * @param           index: index of argument
+     * @return:         value of vector type
+     */
+    static llvm::Value *SF_vector_argument(FunctionCall *ast, size_t index) {
+        auto v = ast->paramList[index]->codeGen();
+        if (!v || !v->getType()->isVectorTy()) {
+            throw ExceptionFactory<TypeException>(
+                "argument " + to_string(index + 1) + " of function " + ast->id + " must be a vector",
+                ast->paramList[index]->getToken().line,
+                ast->paramList[index]->getToken().column
+            );
+        }
+        return v;
+    }
+
+    /**
+     * @description:    generate a mask argument, vec[bool:N]. an integer
+     *                  vector is true where the element is not 0
+     * @param           ast: the function call AST
+     * @param           index: index of argument
+     * @return:         value of i1 vector type
+     */
+    static llvm::Value *SF_mask_argument(FunctionCall *ast, size_t index) {
+        auto v = SF_vector_argument(ast, index);
+        if (v->getType()->getScalarType() == I1_TY) return v;
+        if (v->getType()->isFPOrFPVectorTy()) {
+            throw ExceptionFactory<TypeException>(
+                "argument " + to_string(index + 1) + " of function " + ast->id + " must be a mask",
+                ast->paramList[index]->getToken().line,
+                ast->paramList[index]->getToken().column
+            );
+        }
+        return builder->CreateICmpNE(v, llvm::Constant::getNullValue(v->getType()), "mask");
+    }
+
+    /**
+     * @description:    generate an argument which must be an integer constant
+     * @param           ast: the function call AST
+     * @param           index: index of argument
+     * @return:         value of the constant
+     */
+    static int64_t SF_constant_argument(FunctionCall *ast, size_t index) {
+        auto c = llvm::dyn_cast_or_null<llvm::ConstantInt>(ast->paramList[index]->codeGen());
+        if (!c) {
+            throw ExceptionFactory<TypeException>(
+                "argument " + to_string(index + 1) + " of function " + ast->id + " must be an integer constant",
+                ast->paramList[index]->getToken().line,
+                ast->paramList[index]->getToken().column
+            );
+        }
+        return c->getSExtValue();
+    }
+
+    static void SF_check_argument_count(FunctionCall *ast, size_t min_count, size_t max_count) {
+        size_t n = ast->paramList.size();
+        if (n < min_count || n > max_count) {
+            string count = min_count == max_count
+                           ? to_string(min_count)
+                           : (max_count == SIZE_MAX ? "at least " + to_string(min_count)
+                                                    : to_string(min_count) + " or " + to_string(max_count));
+            throw ExceptionFactory<SysErrException>(
+                "function " + ast->id + " requires " + count + " argument" + (max_count == 1 ? "" : "s"),
+                ast->getToken().line,
+                ast->getToken().column
+            );
+        }
+    }
+
     bool SF_is_builtin(FunctionCall *ast) {
         if (!ast->getToken().getModInfo().empty()) {
             return false;
@@ -258,6 +364,12 @@ namespace AVSI {
         auto lv = ast->paramList[0]->codeGen();
         auto rv = ast->paramList[1]->codeGen();
 
+        if (lv && rv && (lv->getType()->isVectorTy() || rv->getType()->isVectorTy())) {
+            SF_convert_vector_operand(ast, lv, rv);
+            if (lv->getType()->isFPOrFPVectorTy()) return builder->CreateMinNum(lv, rv, "vmin");
+            return builder->CreateBinaryIntrinsic(llvm::Intrinsic::smin, lv, rv, nullptr, "vmin");
+        }
+
         auto float_point = SF_convert_binop_operand(ast, lv, rv);
         
         llvm::Value *cmp_value_boolean;
@@ -313,6 +425,12 @@ namespace AVSI {
         auto lv = ast->paramList[0]->codeGen();
         auto rv = ast->paramList[1]->codeGen();
 
+        if (lv && rv && (lv->getType()->isVectorTy() || rv->getType()->isVectorTy())) {
+            SF_convert_vector_operand(ast, lv, rv);
+            if (lv->getType()->isFPOrFPVectorTy()) return builder->CreateMaxNum(lv, rv, "vmax");
+            return builder->CreateBinaryIntrinsic(llvm::Intrinsic::smax, lv, rv, nullptr, "vmax");
+        }
+
         auto float_point = SF_convert_binop_operand(ast, lv, rv);
         
         llvm::Value *cmp_value_boolean;
@@ -355,4 +473,190 @@ namespace AVSI {
             return PN;
         }   
     }
+
+    /**
+     * @description:    vsplat(x, n), vector of n elements of x
+     * @param           ast: the function call AST
+     * @return:         vec[typeof x:n]
+     */
+    llvm::Value *SF_vsplat(FunctionCall *ast) {
+        SF_check_argument_count(ast, 2, 2);
+
+        auto v = ast->paramList[0]->codeGen();
+        auto n = SF_constant_argument(ast, 1);
+        if (!v || simple_types.find(v->getType()) == simple_types.end()) {
+            throw ExceptionFactory<TypeException>(
+                "argument 1 of function vsplat must be a simple type",
+                ast->getToken().line, ast->getToken().column
+            );
+        }
+        if (n <= 0) {
+            throw ExceptionFactory<LogicException>(
+                "length of vector must be positive",
+                ast->getToken().line, ast->getToken().column
+            );
+        }
+        return builder->CreateVectorSplat(n, v, "vsplat");
+    }
+
+    /**
+     * @description:    vshuffle(a, i0, i1, ...) picks a[i0], a[i1], ... and
+     *                  vshuffle(a, b, i0, i1, ...) picks from a and b, where
+     *                  b[j] is numbered N + j. indexes are constants, so the
+     *                  shuffle is one shufflevector
+     * @param           ast: the function call AST
+     * @return:         vector with one element for each index
+     */
+    llvm::Value *SF_vshuffle(FunctionCall *ast) {
+        SF_check_argument_count(ast, 2, SIZE_MAX);
+
+        auto a = SF_vector_argument(ast, 0);
+        auto count = llvm::cast<llvm::FixedVectorType>(a->getType())->getNumElements();
+
+        size_t first = 1;
+        llvm::Value *b = nullptr;
+        if (ast->paramList.size() > 2) {
+            auto second = ast->paramList[1]->codeGen();
+            if (second && second->getType()->isVectorTy()) {
+                if (second->getType() != a->getType()) {
+                    throw ExceptionFactory<TypeException>(
+                        "unmatched vector types '" + type_table.name(a->getType()) + "' and '" + type_table.name(second->getType()) + "'",
+                        ast->getToken().line, ast->getToken().column
+                    );
+                }
+                b = second;
+                first = 2;
+            }
+        }
+
+        vector<int> mask;
+        int64_t limit = b ? 2 * count : count;
+        for (size_t i = first; i < ast->paramList.size(); i++) {
+            auto index = SF_constant_argument(ast, i);
+            if (index < 0 || index >= limit) {
+                throw ExceptionFactory<LogicException>(
+                    "index " + to_string(index) + " of vshuffle is out of range [0, " + to_string(limit) + ")",
+                    ast->paramList[i]->getToken().line, ast->paramList[i]->getToken().column
+                );
+            }
+            mask.push_back((int) index);
+        }
+
+        if (b) return builder->CreateShuffleVector(a, b, mask, "vshuffle");
+        return builder->CreateShuffleVector(a, mask, "vshuffle");
+    }
+
+    /**
+     * @description:    vselect(mask, a, b), a where mask is true, otherwise b.
+     *                  scalars are broadcast
+     * @param           ast: the function call AST
+     * @return:         vector of the type of a or b
+     */
+    llvm::Value *SF_vselect(FunctionCall *ast) {
+        SF_check_argument_count(ast, 3, 3);
+
+        auto mask = SF_mask_argument(ast, 0);
+        auto count = llvm::cast<llvm::FixedVectorType>(mask->getType())->getNumElements();
+        auto lv = ast->paramList[1]->codeGen();
+        auto rv = ast->paramList[2]->codeGen();
+        if (lv && !lv->getType()->isVectorTy() && rv && !rv->getType()->isVectorTy()) {
+            lv = type_conv(ast, lv, lv->getType(), llvm::FixedVectorType::get(lv->getType(), count));
+        }
+        SF_convert_vector_operand(ast, lv, rv);
+
+        if (llvm::cast<llvm::FixedVectorType>(lv->getType())->getNumElements() != count) {
+            throw ExceptionFactory<TypeException>(
+                "length of mask and vector of vselect are different",
+                ast->getToken().line, ast->getToken().column
+            );
+        }
+        return builder->CreateSelect(mask, lv, rv, "vselect");
+    }
+
+    /**
+     * @description:    vany(mask), true if any element of mask is true
+     * @param           ast: the function call AST
+     * @return:         bool
+     */
+    llvm::Value *SF_vany(FunctionCall *ast) {
+        SF_check_argument_count(ast, 1, 1);
+        return builder->CreateOrReduce(SF_mask_argument(ast, 0));
+    }
+
+    /**
+     * @description:    vall(mask), true if every element of mask is true
+     * @param           ast: the function call AST
+     * @return:         bool
+     */
+    llvm::Value *SF_vall(FunctionCall *ast) {
+        SF_check_argument_count(ast, 1, 1);
+        return builder->CreateAndReduce(SF_mask_argument(ast, 0));
+    }
+
+    /**
+     * @description:    sum of elements. floating point elements may be added
+     *                  in any order, so the sum is a tree of vector adds
+     * @param           v: vector
+     * @return:         sum
+     */
+    static llvm::Value *SF_reduce_add(llvm::Value *v) {
+        if (!v->getType()->isFPOrFPVectorTy()) return builder->CreateAddReduce(v);
+
+        auto sum = builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(v->getType()->getScalarType()), v);
+        llvm::FastMathFlags FMF;
+        FMF.setAllowReassoc();
+        sum->setFastMathFlags(FMF);
+        return sum;
+    }
+
+    /**
+     * @description:    vsum(v), sum of elements of v
+     * @param           ast: the function call AST
+     * @return:         element type of v
+     */
+    llvm::Value *SF_vsum(FunctionCall *ast) {
+        SF_check_argument_count(ast, 1, 1);
+        return SF_reduce_add(SF_vector_argument(ast, 0));
+    }
+
+    /**
+     * @description:    vmin(v), the minimum element of v
+     * @param           ast: the function call AST
+     * @return:         element type of v
+     */
+    llvm::Value *SF_vmin(FunctionCall *ast) {
+        SF_check_argument_count(ast, 1, 1);
+        auto v = SF_vector_argument(ast, 0);
+        if (v->getType()->isFPOrFPVectorTy()) return builder->CreateFPMinReduce(v);
+        return builder->CreateIntMinReduce(v, v->getType()->getScalarType() != I1_TY);
+    }
+
+    /**
+     * @description:    vmax(v), the maximum element of v
+     * @param           ast: the function call AST
+     * @return:         element type of v
+     */
+    llvm::Value *SF_vmax(FunctionCall *ast) {
+        SF_check_argument_count(ast, 1, 1);
+        auto v = SF_vector_argument(ast, 0);
+        if (v->getType()->isFPOrFPVectorTy()) return builder->CreateFPMaxReduce(v);
+        return builder->CreateIntMaxReduce(v, v->getType()->getScalarType() != I1_TY);
+    }
+
+    /**
+     * @description:    vdot(a, b), sum of a[i] * b[i]
+     * @param           ast: the function call AST
+     * @return:         element type of a and b
+     */
+    llvm::Value *SF_vdot(FunctionCall *ast) {
+        SF_check_argument_count(ast, 2, 2);
+        auto lv = SF_vector_argument(ast, 0);
+        auto rv = SF_vector_argument(ast, 1);
+        SF_convert_vector_operand(ast, lv, rv);
+
+        auto mul = lv->getType()->isFPOrFPVectorTy()
+                   ? builder->CreateFMul(lv, rv, "vdot.mul")
+                   : builder->CreateMul(lv, rv, "vdot.mul");
+        return SF_reduce_add(mul);
+    }
 }
@@ -0,0 +1,296 @@
+/*
+ * CGTarget.cpp 2025
+ *
+ * function multiversioning by target_clones
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * a function marked with
+ *
+ *      target_clones("avx2", "avx512f", "default") function foo(...)
+ *
+ * is compiled once for every target. the versions are private functions
+ * foo.avx2, foo.avx512f and foo.default, and foo becomes an ifunc whose
+ * resolver asks the runtime in libavsi (cpu.c) which features the cpu has
+ * and returns the best version. the dynamic loader runs the resolver once
+ * at startup, calls of foo then go straight to the chosen version.
+ *
+ * --run compiles for the machine it runs on, so the version is chosen here
+ * and no ifunc is made. jit and ThinLTO of llvm 14 can't define an ifunc of
+ * imported modules or in bitcode, there it is replaced by a function which
+ * calls the resolver at the first call and jumps to the chosen version.
+ */
+
+#include <algorithm>
+
+#include "../inc/AST.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include "Exception.h"
+
+extern bool opt_run;
+
+namespace AVSI {
+    using namespace std;
+
+    extern llvm::LLVMContext *the_context;
+    extern llvm::Module *the_module;
+    extern llvm::TargetMachine *TheTargetMachine;
+
+#define CPU_SUPPORTS_FUNCTION   "__avsi_cpu_supports"
+#define TARGET_CLONES_ATTR      "avsi-target-clones"
+#define TARGET_DEFAULT          "default"
+
+    /*
+     * targets known by the runtime, a later one is preferred when the cpu
+     * has both. names are those of llvm target features
+     */
+    static const vector<string> clone_targets = {
+            "sse3", "ssse3", "sse4.1", "sse4.2", "popcnt",
+            "avx", "fma", "bmi", "bmi2", "avx2",
+            "avx512f", "avx512cd", "avx512dq", "avx512bw", "avx512vl"
+    };
+
+    static int target_priority(const string &target) {
+        for (int i = 0; i < clone_targets.size(); i++) {
+            if (clone_targets[i] == target) return i;
+        }
+        return -1;
+    }
+
+    /**
+     * @description:    check targets of target_clones and mark function
+     * @param:          fun: function
+     * @param:          targets: targets in attribute
+     * @param:          line: line of function
+     * @param:          col: column of function
+     * @return:         none
+     */
+    void llvm_set_target_clones(llvm::Function *fun, vector<string> targets, int line, int col) {
+        string value;
+        bool has_default = false;
+        for (int i = 0; i < targets.size(); i++) {
+            if (targets[i] == TARGET_DEFAULT) {
+                has_default = true;
+            } else if (target_priority(targets[i]) < 0) {
+                throw ExceptionFactory<LogicException>(
+                        "unsupported target '" + targets[i] + "' in target_clones",
+                        line, col);
+            }
+            for (int j = 0; j < i; j++) {
+                if (targets[j] == targets[i]) {
+                    throw ExceptionFactory<LogicException>(
+                            "duplicate target '" + targets[i] + "' in target_clones",
+                            line, col);
+                }
+            }
+            if (!value.empty()) value += ",";
+            value += targets[i];
+        }
+        if (!has_default) {
+            throw ExceptionFactory<LogicException>(
+                    "target_clones needs a 'default' version",
+                    line, col);
+        }
+
+        fun->addFnAttr(TARGET_CLONES_ATTR, value);
+    }
+
+    /**
+     * @description:    features of a version, those of -march/-mattr and target
+     * @param:          target: target of target_clones
+     * @return:         value of "target-features" attribute
+     */
+    static string clone_features(const string &target) {
+        string features = TheTargetMachine->getTargetFeatureString().str();
+        if (!features.empty()) features += ",";
+        return features + "+" + target;
+    }
+
+    /**
+     * @description:    build resolver of ifunc, it returns the version of
+     *                  highest priority which the cpu supports
+     * @param:          resolver: empty resolver function
+     * @param:          versions: target and function of every version
+     * @return:         none
+     */
+    static void build_resolver(llvm::Function *resolver, vector<pair<string, llvm::Function *>> versions) {
+        auto supports = the_module->getOrInsertFunction(
+                CPU_SUPPORTS_FUNCTION,
+                llvm::FunctionType::get(llvm::Type::getInt32Ty(*the_context),
+                                        {llvm::Type::getInt8PtrTy(*the_context)}, false));
+
+        // default has the lowest priority and comes last
+        std::stable_sort(versions.begin(), versions.end(), [](auto &a, auto &b) {
+            return target_priority(a.first) > target_priority(b.first);
+        });
+
+        llvm::IRBuilder<> b(llvm::BasicBlock::Create(*the_context, "entry", resolver));
+        for (auto &i: versions) {
+            if (i.first == TARGET_DEFAULT) {
+                b.CreateRet(i.second);
+                return;
+            }
+
+            auto has = b.CreateCall(supports, {b.CreateGlobalStringPtr(i.first, "target." + i.first)});
+            auto yes = llvm::BasicBlock::Create(*the_context, i.first, resolver);
+            auto no = llvm::BasicBlock::Create(*the_context, "next", resolver);
+            b.CreateCondBr(b.CreateICmpNE(has, b.getInt32(0)), yes, no);
+
+            b.SetInsertPoint(yes);
+            b.CreateRet(i.second);
+            b.SetInsertPoint(no);
+        }
+    }
+
+    /**
+     * @description:    pick version for the cpu running the compiler
+     * @param:          targets: targets of target_clones
+     * @return:         target
+     */
+    static string host_target(vector<string> targets) {
+        llvm::StringMap<bool> features;
+        llvm::sys::getHostCPUFeatures(features);
+
+        string best = TARGET_DEFAULT;
+        for (auto &i: targets) {
+            if (i == TARGET_DEFAULT || !features.lookup(i)) continue;
+            if (best == TARGET_DEFAULT || target_priority(i) > target_priority(best)) best = i;
+        }
+        return best;
+    }
+
+    /**
+     * @description:    make versions and ifunc for every function marked by
+     *                  target_clones
+     * @return:         none
+     */
+    void llvm_emit_target_clones() {
+        vector<llvm::Function *> funs;
+        for (auto &fun: the_module->functions()) {
+            if (fun.hasFnAttribute(TARGET_CLONES_ATTR)) funs.push_back(&fun);
+        }
+
+        for (auto fun: funs) {
+            vector<string> targets;
+            llvm::SmallVector<llvm::StringRef, 4> parts;
+            fun->getFnAttribute(TARGET_CLONES_ATTR).getValueAsString().split(parts, ",");
+            for (auto &i: parts) targets.push_back(i.str());
+            fun->removeFnAttr(TARGET_CLONES_ATTR);
+            if (fun->isDeclaration()) continue;
+
+            if (opt_run) {
+                string target = host_target(targets);
+                if (target != TARGET_DEFAULT) fun->addFnAttr("target-features", clone_features(target));
+                continue;
+            }
+
+            string name = fun->getName().str();
+            auto linkage = fun->getLinkage();
+
+            vector<pair<string, llvm::Function *>> versions;
+            for (auto &target: targets) {
+                if (target == TARGET_DEFAULT) continue;
+                llvm::ValueToValueMapTy VMap;
+                llvm::Function *clone = llvm::CloneFunction(fun, VMap);
+                clone->setName(name + "." + target);
+                clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+                clone->addFnAttr("target-features", clone_features(target));
+                versions.emplace_back(target, clone);
+            }
+            fun->setName(name + "." TARGET_DEFAULT);
+            fun->setLinkage(llvm::GlobalValue::InternalLinkage);
+            versions.emplace_back(TARGET_DEFAULT, fun);
+
+            auto resolver = llvm::Function::Create(
+                    llvm::FunctionType::get(fun->getType(), false),
+                    llvm::GlobalValue::InternalLinkage,
+                    name + ".resolver",
+                    the_module);
+            auto ifunc = llvm::GlobalIFunc::create(
+                    fun->getFunctionType(), fun->getAddressSpace(),
+                    linkage, name, resolver, the_module);
+
+            // calls and recursive calls of every version go through ifunc
+            fun->replaceAllUsesWith(ifunc);
+            build_resolver(resolver, versions);
+        }
+    }
+
+    /**
+     * @description:    replace ifuncs by functions which call the resolver
+     *                  once and jump to the chosen version. jit and ThinLTO
+     *                  of llvm 14 can't define ifunc
+     * @param:          M: module
+     * @return:         none
+     */
+    void llvm_lower_ifuncs(llvm::Module &M) {
+        vector<llvm::GlobalIFunc *> ifuncs;
+        for (auto &ifunc: M.ifuncs()) {
+            ifuncs.push_back(&ifunc);
+        }
+
+        for (auto ifunc: ifuncs) {
+            auto FT = llvm::cast<llvm::FunctionType>(ifunc->getValueType());
+            string name = ifunc->getName().str();
+            ifunc->setName(name + ".ifunc");
+
+            auto chosen = new llvm::GlobalVariable(
+                    M, FT->getPointerTo(), false, llvm::GlobalValue::InternalLinkage,
+                    llvm::ConstantPointerNull::get(FT->getPointerTo()), name + ".chosen");
+            auto fun = llvm::Function::Create(FT, ifunc->getLinkage(), name, M);
+
+            llvm::IRBuilder<> b(llvm::BasicBlock::Create(M.getContext(), "entry", fun));
+            auto resolve = llvm::BasicBlock::Create(M.getContext(), "resolve", fun);
+            auto call = llvm::BasicBlock::Create(M.getContext(), "call", fun);
+            auto cached = b.CreateLoad(FT->getPointerTo(), chosen);
+            b.CreateCondBr(b.CreateIsNull(cached), resolve, call);
+
+            b.SetInsertPoint(resolve);
+            auto resolver = ifunc->getResolverFunction();
+            auto resolved = b.CreateBitCast(b.CreateCall(resolver->getFunctionType(), resolver), FT->getPointerTo());
+            b.CreateStore(resolved, chosen);
+            b.CreateBr(call);
+
+            b.SetInsertPoint(call);
+            auto target = b.CreatePHI(FT->getPointerTo(), 2);
+            target->addIncoming(cached, &fun->getEntryBlock());
+            target->addIncoming(resolved, resolve);
+            vector<llvm::Value *> args;
+            for (auto &arg: fun->args()) args.push_back(&arg);
+            auto ret = b.CreateCall(FT, target, args);
+            ret->setTailCallKind(llvm::CallInst::TCK_MustTail);
+            if (FT->getReturnType()->isVoidTy()) b.CreateRetVoid();
+            else b.CreateRet(ret);
+
+            ifunc->replaceAllUsesWith(fun);
+            ifunc->eraseFromParent();
+        }
+    }
+}
@@ -28,6 +28,7 @@
 
 #include <cstdlib>
 #include <set>
+#include <algorithm>
 #include <cstdint>
 #include <unistd.h>
 #include <sys/wait.h>
@@ -35,6 +36,7 @@
 #include "../inc/AST.h"
 #include "../inc/SymbolTable.h"
 #include "../inc/FileName.h"
+#include "../inc/TimeReport.h"
 #include <filesystem>
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
@@ -46,7 +48,38 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/MCAsmBackend.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCObjectWriter.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
+#include "llvm/MC/MCParser/MCTargetAsmParser.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar/EarlyCSE.h"
+#include "llvm/Transforms/Scalar/InductiveRangeCheckElimination.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Scalar/LoopRotation.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Transforms/Utils/LCSSA.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "llvm/Transforms/IPO.h"
@@ -68,11 +101,30 @@ extern bool opt_reliance;
 extern bool opt_verbose;
 extern bool opt_warning;
 extern bool opt_optimize;
+extern int opt_level;
+extern int opt_size_level;
 extern bool opt_pic;
+extern bool opt_debug;
+extern bool opt_time_report;
+extern bool opt_lto;
+extern bool opt_thin_lto;
+extern std::string profile_generate_file;
+extern std::string profile_use_file;
+extern std::string target_cpu;
+extern std::string target_features;
+extern uint64_t constexpr_steps;
+extern uint64_t constexpr_memory;
+extern bool opt_bounds_check;
+extern std::string remark_pass;
+extern std::string remark_pass_missed;
+extern std::string remark_pass_analysis;
 
 namespace AVSI {
     using namespace std;
 
+#define BOUNDS_FAIL_FUNCTION    "__avsi_bounds_fail"
+#define BOUNDS_FILE_NAME        "__avsi_bounds_file"
+
     /*******************************************************
      *                      llvm base                      *
      *******************************************************/
@@ -84,8 +136,6 @@ namespace AVSI {
     extern llvm::LLVMContext *the_context;
     extern llvm::Module *the_module;
     extern llvm::IRBuilder<> *builder;
-    extern llvm::legacy::FunctionPassManager *the_function_fpm;
-    extern llvm::legacy::PassManager *the_module_fpm;
     extern llvm::TargetMachine *TheTargetMachine;
 
     extern llvm::BasicBlock *global_insert_point;
@@ -110,16 +160,18 @@ namespace AVSI {
     extern SymbolTable *symbol_table;
 
     extern map<string, StructDef *> struct_types;
+    extern llvm::DenseMap<llvm::Type *, StructDef *> struct_defs;
     extern map<string, GenericDef *> generic_function;
     extern map<std::string, llvm::FunctionType *> function_protos;
     extern set<llvm::Type *> simple_types;
     extern map<llvm::Type *, uint8_t> simple_types_map;
 
-    extern map<llvm::Type *, string> type_name;
-    extern map<llvm::Type *, uint32_t> type_size;
+    extern TypeTable type_table;
 
     extern map<string, string> module_name_alias;
 
+    extern set<string> imported_bitcode;
+
     extern map<TokenType, llvm::Type *> token_to_simple_types;
 
     extern map<string, llvm::Constant *> const_string_pool;
@@ -127,44 +179,6 @@ namespace AVSI {
     /*******************************************************
      *                     function                        *
      *******************************************************/
-    void llvm_module_fpm_init() {
-        if (opt_optimize) {
-            the_function_fpm->add(llvm::createReassociatePass());
-            the_function_fpm->add(llvm::createConstantHoistingPass());
-            the_function_fpm->add(llvm::createInstructionCombiningPass());
-            the_function_fpm->add(llvm::createReassociatePass());
-            the_function_fpm->add(llvm::createCFGSimplificationPass());
-            the_function_fpm->add(llvm::createDeadCodeEliminationPass());
-            the_function_fpm->add(llvm::createFlattenCFGPass());
-            the_function_fpm->add(llvm::createGVNPass());
-            the_function_fpm->add(llvm::createLICMPass());
-            the_function_fpm->add(llvm::createLoopSinkPass());
-            the_function_fpm->add(llvm::createLoopInstSimplifyPass());
-            the_function_fpm->add(llvm::createLoopFlattenPass());
-            the_function_fpm->add(llvm::createLoopRotatePass());
-            the_function_fpm->add(llvm::createLoopIdiomPass());
-            the_function_fpm->add(llvm::createLoopPredicationPass());
-            the_function_fpm->add(llvm::createLoopVersioningLICMPass());
-            the_function_fpm->add(llvm::createLoopDistributePass());
-            the_function_fpm->add(llvm::createLoopFusePass());
-            the_function_fpm->add(llvm::createGVNHoistPass());
-            the_function_fpm->add(llvm::createSpeculativeExecutionPass());
-            the_function_fpm->add(llvm::createIndVarSimplifyPass());
-
-
-            the_function_fpm->add(llvm::createReassociatePass());
-            the_function_fpm->add(llvm::createConstantHoistingPass());
-            the_function_fpm->add(llvm::createInstructionCombiningPass());
-            the_function_fpm->add(llvm::createDeadStoreEliminationPass());
-            the_function_fpm->add(llvm::createAggressiveDCEPass());
-            the_function_fpm->add(llvm::createAggressiveInstCombinerPass()); 
-        }
-        the_function_fpm->doInitialization();
-
-        the_module_fpm->add(llvm::createFunctionInliningPass());
-        the_module_fpm->add(llvm::createAlwaysInlinerLegacyPass());
-    }
-
     /**
      * @description:    import specific module
      * @param:          path: path to module, both absolute and relative
@@ -176,6 +190,8 @@ namespace AVSI {
      * @return:         none
      */
     void llvm_import_module(vector<string> path, string mod, int line, int col, string as) {
+        TimeScope time_scope("import " + getpathListToUnresolved(path) + (path.empty() ? "" : "::") + mod);
+
         // to check absolute or relative path
         auto module_path_size = module_path.size();
         bool is_absolute_module_path = true;
@@ -248,9 +264,9 @@ namespace AVSI {
         // so create a backup
         string module_file_system_path_backup = module_file_system_path;
         if (std::filesystem::is_directory(std::filesystem::path(module_file_system_path))) {
-            module_file_system_path += SYSTEM_PATH_DIVIDER + mod + ".bc";
+            module_file_system_path += SYSTEM_PATH_DIVIDER + mod + ".avsii";
         } else {
-            module_file_system_path += ".bc";
+            module_file_system_path += ".avsii";
         }
         if (std::filesystem::is_directory(std::filesystem::path(module_source_file_system_path))) {
             module_source_file_system_path += SYSTEM_PATH_DIVIDER + string(MODULE_INIT_NAME) + ".sl";
@@ -260,6 +276,26 @@ namespace AVSI {
         std::filesystem::path bcfile = module_file_system_path;
         std::filesystem::path sourcefile = module_source_file_system_path;
 
+        // modules importing current one are passed down by "--import-chain",
+        // a circular import is found before anything is compiled
+        vector<string> chain = import_chain;
+        chain.push_back(std::filesystem::weakly_canonical(std::filesystem::absolute(input_file_name_raw)).string());
+        if (std::filesystem::exists(sourcefile)) {
+            string source = std::filesystem::weakly_canonical(std::filesystem::absolute(sourcefile)).string();
+            auto cycle_begin = find(chain.begin(), chain.end(), source);
+            if (cycle_begin != chain.end()) {
+                string cycle;
+                for (auto i = cycle_begin; i != chain.end(); i++) {
+                    cycle += std::filesystem::proximate(*i, compiler_exec_path).string() + " -> ";
+                }
+                cycle += std::filesystem::proximate(source, compiler_exec_path).string();
+
+                throw ExceptionFactory<LogicException>(
+                        "circular import: " + cycle,
+                        line, col);
+            }
+        }
+
         // if bc file is not exist or source file changed,
         // compile files recursively
         if (
@@ -275,10 +311,21 @@ namespace AVSI {
             } else if (pid > 1) {
                 wait(&status);
 
+                if (opt_time_report) {
+                    time_report_attach(output_root_path + SYSTEM_PATH_DIVIDER + ".time-report." + to_string(pid) + ".json");
+                }
+
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    throw ExceptionFactory<LogicException>(
+                            "failed to build module " + getpathListToUnresolved(path) +
+                            (path.empty() ? "" : "::") + mod,
+                            line, col);
+                }
+
                 if (std::filesystem::is_directory(std::filesystem::path(module_file_system_path_backup))) {
-                    module_file_system_path = module_file_system_path_backup + SYSTEM_PATH_DIVIDER + mod + ".bc";
+                    module_file_system_path = module_file_system_path_backup + SYSTEM_PATH_DIVIDER + mod + ".avsii";
                 } else {
-                    module_file_system_path = module_file_system_path_backup + ".bc";
+                    module_file_system_path = module_file_system_path_backup + ".avsii";
                 }
                 bcfile = module_file_system_path;
             } else {
@@ -294,10 +341,26 @@ namespace AVSI {
 
                 if (opt_verbose) args.push_back("-v");
                 if (opt_warning) args.push_back("-W");
-                if (opt_optimize) args.push_back("-O");
+                string opt_flag = "-O" + (opt_size_level ? string(opt_size_level == 1 ? "s" : "z") : to_string(opt_level));
+                if (opt_optimize) args.push_back(opt_flag.c_str());
                 if (opt_ir) args.push_back("-l");
 
                 if (opt_pic) args.push_back("-fpic");
+                if (opt_bounds_check) args.push_back("-fbounds-check");
+                if (opt_debug) args.push_back("-g");
+                if (opt_lto) args.push_back(opt_thin_lto ? "--lto=thin" : "--lto");
+                string profile_generate_flag = "-fprofile-generate=" + profile_generate_file;
+                string profile_use_flag = "-fprofile-use=" + profile_use_file;
+                if (!profile_generate_file.empty()) args.push_back(profile_generate_flag.c_str());
+                if (!profile_use_file.empty()) args.push_back(profile_use_flag.c_str());
+                string constexpr_steps_flag = "-fconstexpr-steps=" + to_string(constexpr_steps);
+                string constexpr_memory_flag = "-fconstexpr-memory=" + to_string(constexpr_memory);
+                args.push_back(constexpr_steps_flag.c_str());
+                args.push_back(constexpr_memory_flag.c_str());
+                string march_flag = "--march=" + target_cpu;
+                string mattr_flag = "--mattr=" + target_features;
+                if (target_cpu != "generic") args.push_back(march_flag.c_str());
+                if (!target_features.empty()) args.push_back(mattr_flag.c_str());
 
                 // include path
                 for(int i = 1; i < include_path.size(); i++) {
@@ -320,6 +383,20 @@ namespace AVSI {
                     args.push_back(p.c_str());
                 }
 
+                for (auto &i: chain) {
+                    args.push_back("--import-chain");
+                    args.push_back(i.c_str());
+                }
+
+                // child writes its report to a file named by its pid
+                string time_report_file =
+                        output_root_path + SYSTEM_PATH_DIVIDER + ".time-report." + to_string(getpid()) + ".json";
+                if (opt_time_report) {
+                    args.push_back("--time-report=json");
+                    args.push_back("--time-report-output");
+                    args.push_back(time_report_file.c_str());
+                }
+
                 args.push_back((char const *)0);
 
                 clog << "importing "
@@ -357,9 +434,9 @@ namespace AVSI {
                 }
                 module_file_system_path += SYSTEM_PATH_DIVIDER + mod;
                 if (std::filesystem::is_directory(std::filesystem::path(module_file_system_path))) {
-                    module_file_system_path += SYSTEM_PATH_DIVIDER + mod + ".bc";
+                    module_file_system_path += SYSTEM_PATH_DIVIDER + mod + ".avsii";
                 } else {
-                    module_file_system_path += ".bc";
+                    module_file_system_path += ".avsii";
                 }
                 bcfile = module_file_system_path;
 
@@ -388,119 +465,108 @@ namespace AVSI {
             exit(-1);
         }
 
-        // read bc file to memory buffer
-        auto mbuf = llvm::MemoryBuffer::getFile(bcfile.c_str());
-        if (!mbuf) {
-            if (!std::filesystem::exists(bcfile)) {
-                string unparsed_name;
-                for (string i: path) {
-                    unparsed_name += i + "::";
-                }
-                unparsed_name += mod;
-
-                throw ExceptionFactory<MissingException>(
-                        "error occurred when reading module " + unparsed_name,
-                        line, col);
-            }
+        // only the interface file is read, function bodies are never loaded
+        string unparsed_name;
+        for (string i: path) {
+            unparsed_name += i + "::";
         }
+        unparsed_name += mod;
 
-        // create and import module
-        llvm::SMDiagnostic smd = llvm::SMDiagnostic();
-        auto ir = llvm::parseIR(*mbuf.get(), smd, *the_context);
-        auto imported_module = ir.release();
-
-        if (imported_module == nullptr) {
-            string unparsed_name;
-            for (string i: path) {
-                unparsed_name += i + "::";
-            }
-            unparsed_name += mod;
-
-            smd.print(unparsed_name.c_str(), llvm::errs());
-            cout << smd.getLineContents().str() << " " << smd.getMessage().str() << endl;
-            throw ExceptionFactory<IRErrException>(
-                    "failed to import module " + unparsed_name,
-                    line, col);
-        }
+        llvm_import_interface(bcfile.string(), unparsed_name, line, col);
 
-        // import symbols
-        // import function
-        auto function_iter = imported_module->getFunctionList().begin();
-        while (function_iter != imported_module->getFunctionList().end()) {
-            auto fun = &(*function_iter);
-            the_module->getOrInsertFunction(fun->getName(), fun->getFunctionType(), fun->getAttributes());
-            function_iter++;
+        // bodies are only needed when optimizing
+        std::filesystem::path bitcode = bcfile;
+        bitcode.replace_extension(".bc");
+        if (opt_optimize && std::filesystem::exists(bitcode)) {
+            imported_bitcode.insert(std::filesystem::absolute(bitcode).string());
         }
 
-        // import global
-        auto global_iter = imported_module->getGlobalList().begin();
-        while (global_iter != imported_module->getGlobalList().end()) {
-            auto glb = &(*global_iter);
-            the_module->getOrInsertGlobal(glb->getName(), glb->getValueType());
-            global_iter++;
+        // recorded in bitcode, so --run finds modules imported by modules
+        if (std::filesystem::exists(bitcode)) {
+            auto imports = the_module->getOrInsertNamedMetadata(MODULE_IMPORTS_MD);
+            auto file = llvm::MDString::get(*the_context, std::filesystem::absolute(bitcode).string());
+            bool recorded = false;
+            for (auto node: imports->operands()) {
+                if (node->getOperand(0).get() == file) recorded = true;
+            }
+            if (!recorded) imports->addOperand(llvm::MDNode::get(*the_context, {file}));
         }
+    }
 
-        // import named metadata
-        auto md_iter = imported_module->getNamedMDList().begin();
-        while (md_iter != imported_module->getNamedMDList().end()) {
-            auto md = &(*md_iter);
-            if (the_module->getNamedMetadata(md->getName())) {
-                md_iter++;
+    /**
+     * @description:    make bodies of imported functions visible to the inliner.
+     *                  bitcode is memory-mapped and loaded lazily, only functions
+     *                  called by current module are materialized, and they are
+     *                  linked as available_externally so no code is emitted twice
+     * @return:         none
+     */
+    void llvm_link_imported_bodies() {
+        for (auto &file: imported_bitcode) {
+            auto mbuf = llvm::MemoryBuffer::getFile(file, false, false);
+            if (!mbuf) continue;
+
+            llvm::SMDiagnostic smd;
+            auto imported_module = llvm::getLazyIRModule(std::move(mbuf.get()), smd, *the_context);
+            if (!imported_module) {
+                Warning("failed to load " + file + ", cross-module inlining is disabled for it", 0, 0);
                 continue;
             }
-            auto new_md = the_module->getOrInsertNamedMetadata(md->getName());
-            for (auto node: md->operands()) {
-                new_md->addOperand(node);
-            }
-            md_iter++;
-        }
 
-        // import struct
-        auto struct_iter = imported_module->getIdentifiedStructTypes();
-        for (auto i: struct_iter) {
-            ::size_t size = i->getNumElements();
-            string id = string(i->getName());
-            auto md = imported_module->getOrInsertNamedMetadata("struct." + id);
-
-            StructDef *sd = new StructDef(i);
-            for (int j = 0; j < size; j++) {
-                auto member_name = llvm::dyn_cast<llvm::MDString>(
-                        llvm::dyn_cast<llvm::MDNode>(md->getOperand(j))->getOperand(0)
-                )->getString();
-                sd->members[string(member_name)] = j;
+            bool needed = false;
+            // target_clones versions are private, so an ifunc is only
+            // linked as a declaration
+            vector<llvm::GlobalIFunc *> ifuncs;
+            for (auto &ifunc: imported_module->ifuncs()) {
+                ifuncs.push_back(&ifunc);
+            }
+            for (auto ifunc: ifuncs) {
+                string name = ifunc->getName().str();
+                ifunc->setName("");
+                auto decl = llvm::Function::Create(
+                        llvm::cast<llvm::FunctionType>(ifunc->getValueType()),
+                        llvm::GlobalValue::ExternalLinkage, name, *imported_module);
+                ifunc->replaceAllUsesWith(decl);
+                ifunc->eraseFromParent();
             }
-            auto struct_type_size = llvm::dyn_cast<llvm::MDString>(
-                    llvm::dyn_cast<llvm::MDNode>(md->getOperand(size))->getOperand(0)
-            )->getString();
-            type_size[i] = stoi(string(struct_type_size));
-            auto struct_type_name = llvm::dyn_cast<llvm::MDString>(
-                    llvm::dyn_cast<llvm::MDNode>(md->getOperand(size + 1))->getOperand(0)
-            )->getString();
-            type_name[i] = struct_type_name;
-            struct_types[id] = sd;
-        }
 
-        // import gereric
-        for (auto i = imported_module->named_metadata_begin() ; i != imported_module->named_metadata_end(); i++) {
-            GenericDef *gd = new GenericDef();
-            if(i->getName().find("generic.") != string::npos) {
-                int idx = atoi(
-                    llvm::dyn_cast<llvm::MDString>(
-                            llvm::dyn_cast<llvm::MDNode>(i->getOperand(0))->getOperand(0)
-                    )->getString().str().c_str()
-                );
+            for (auto &fun: imported_module->functions()) {
+                if (!fun.hasExternalLinkage() || fun.isDeclaration()) continue;
 
-                gd->idx = idx;
+                auto local = the_module->getFunction(fun.getName());
+                if (local && local->isDeclaration() && !local->use_empty() &&
+                    !fun.hasFnAttribute(llvm::Attribute::NoInline)) {
+                    if (fun.materialize()) {
+                        fun.deleteBody();
+                        continue;
+                    }
+                    fun.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+                    needed = true;
+                } else {
+                    // drop the unread body without materializing it
+                    fun.deleteBody();
+                }
+            }
+            if (!needed) continue;
 
-                for (int j = 1; j < i->getNumOperands(); j++) {
-                    auto node = llvm::dyn_cast<llvm::MDNode>(i->getOperand(j));
-                    auto mapped_func_name = llvm::dyn_cast<llvm::MDString>(node->getOperand(0))->getString().str();
-                    auto ty_name = llvm::dyn_cast<llvm::MDString>(node->getOperand(1))->getString().str();
-                    gd->function_map[ty_name] = mapped_func_name;
+            for (auto &glb: imported_module->globals()) {
+                if (glb.hasExternalLinkage()) {
+                    glb.setInitializer(nullptr);
                 }
             }
 
-            generic_function[i->getName().substr(8).str()] = gd;
+            // struct.* and generic.* have been imported from interface
+            vector<llvm::NamedMDNode *> mds;
+            for (auto &md: imported_module->named_metadata()) {
+                mds.push_back(&md);
+            }
+            for (auto md: mds) {
+                imported_module->eraseNamedMetadata(md);
+            }
+
+            if (llvm::Linker::linkModules(*the_module, std::move(imported_module),
+                                          llvm::Linker::Flags::LinkOnlyNeeded)) {
+                Warning("failed to link " + file + ", cross-module inlining is disabled for it", 0, 0);
+            }
         }
     }
 
@@ -511,8 +577,6 @@ namespace AVSI {
     void llvm_global_context_reset() {
         // reset context and module
         delete TheTargetMachine;
-        delete the_function_fpm;
-        delete the_module_fpm;
         delete builder;
         delete the_module;
         delete the_context;
@@ -520,8 +584,6 @@ namespace AVSI {
         the_context = new llvm::LLVMContext();
         the_module = new llvm::Module("program", *the_context);
         builder = new llvm::IRBuilder<>(*the_context);
-        the_function_fpm = new llvm::legacy::FunctionPassManager(the_module);
-        the_module_fpm = new llvm::legacy::PassManager();
         TheTargetMachine = nullptr;
 
         // reset symbols
@@ -540,11 +602,12 @@ namespace AVSI {
 
         symbol_table = new SymbolTable();
         struct_types.clear();
+        struct_defs.clear();
         function_protos.clear();
         simple_types.clear();
         simple_types_map.clear();
-        type_name.clear();
-        type_size.clear();
+        type_table.clear();
+        llvm_generic_reset();
 
         simple_types = {
                 F64_TY, F32_TY,
@@ -565,33 +628,6 @@ namespace AVSI {
                 {I1_TY,   (uint8_t) 0x1},
                 {ISIZE_TY, PTR_SIZE == 8 ? (uint8_t) (0x1 << 4) : (uint8_t) (0x1 << 3)}
         };
-        type_name = {
-                {F64_TY, "f64"}, {F64_TY->getPointerTo(), "f64*"},
-                {F32_TY, "f32"}, {F32_TY->getPointerTo(), "f32*"},
-                {I128_TY, "i128"}, {I128_TY->getPointerTo(), "i128*"},
-                {I64_TY, "i64"}, {I64_TY->getPointerTo(), "i64*"},
-                {I32_TY, "i32"}, {I32_TY->getPointerTo(), "i32*"},
-                {I16_TY, "i16"}, {I16_TY->getPointerTo(), "i16*"},
-                {I8_TY, "i8"}, {I8_TY->getPointerTo(), "i8*"},
-                {I1_TY, "bool"}, {I1_TY->getPointerTo(), "bool*"},
-                {VOID_TY, "void"},
-                {ISIZE_TY, "isize"}, {ISIZE_TY->getPointerTo(), "isize*"},
-                {nullptr, "default"}
-        };
-        
-        type_size = {
-                {F64_TY, 8}, {F64_TY->getPointerTo(), 1},
-                {F32_TY, 4}, {F32_TY->getPointerTo(), 1},
-                {I128_TY, 16}, {I128_TY->getPointerTo(), 1},
-                {I64_TY, 8}, {I64_TY->getPointerTo(), 1},
-                {I32_TY, 4}, {I32_TY->getPointerTo(), 1},
-                {I16_TY, 2}, {I16_TY->getPointerTo(), 1},
-                {I8_TY, 1}, {I8_TY->getPointerTo(), 1},
-                {I1_TY, 1}, {I1_TY->getPointerTo(), 1},
-                {VOID_TY, 0},
-                {ISIZE_TY, PTR_SIZE}, {ISIZE_TY->getPointerTo(), 1},
-        };
-
         token_to_simple_types = {
                 {F64,   F64_TY},
                 {F32,   F32_TY},
@@ -638,18 +674,38 @@ namespace AVSI {
             return;
         }
 
-        auto CPU = "generic";
-        auto Features = "";
+        string CPU = target_cpu;
+        string Features = target_features;
+        if (CPU == "native") {
+            CPU = llvm::sys::getHostCPUName().str();
+
+            // -mattr is put last, so it can turn off features of host
+            llvm::SubtargetFeatures host_features;
+            llvm::StringMap<bool> features;
+            llvm::sys::getHostCPUFeatures(features);
+            for (auto &i: features) host_features.AddFeature(i.first(), i.second);
+            if (!Features.empty()) host_features.AddFeature(Features);
+            Features = host_features.getString();
+        }
 
         llvm::TargetOptions opt;
         auto RM = llvm::Optional<llvm::Reloc::Model>(opt_pic ? llvm::Reloc::PIC_ : llvm::Reloc::Static);
+        auto OL = llvm::CodeGenOpt::Default;
+        if (!opt_optimize) OL = llvm::CodeGenOpt::None;
+        else if (opt_level == 1) OL = llvm::CodeGenOpt::Less;
+        else if (opt_level == 3) OL = llvm::CodeGenOpt::Aggressive;
         TheTargetMachine =
-                Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM);
+                Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM, llvm::None, OL);
 
         the_module->setDataLayout(TheTargetMachine->createDataLayout());
     }
 
-    void llvm_emit_obj() {
+    /**
+     * @description:    get output file of current module
+     * @param:          ext: file extension, e.g. ".o"
+     * @return:         path to output file
+     */
+    static string llvm_output_file_name(string ext) {
         std::filesystem::path dir = filesystem::path(input_file_path_absolut).filename();
         string file_basename;
         if (input_file_name_no_suffix == MODULE_INIT_NAME)
@@ -661,8 +717,18 @@ namespace AVSI {
 
         auto Filename =
                 output_root_path + SYSTEM_PATH_DIVIDER + input_file_path_relative + SYSTEM_PATH_DIVIDER +
-                string(file_basename) + ".o";
+                string(file_basename) + ext;
         llvm_create_dir(filesystem::path(Filename).parent_path());
+        return Filename;
+    }
+
+    /**
+     * @description:    write a buffer to file at once
+     * @param:          Filename: path to file
+     * @param:          data: content
+     * @return:         none
+     */
+    static void llvm_write_file(string Filename, llvm::StringRef data) {
         std::error_code EC;
         llvm::raw_fd_ostream dest(Filename, EC, llvm::sys::fs::OF_None);
 
@@ -671,61 +737,130 @@ namespace AVSI {
             return;
         }
 
-        llvm::ValueToValueMapTy vmt;
-        auto clone = llvm::CloneModule(*the_module, vmt).release();
-
-        llvm::legacy::PassManager pass;
-        auto FileType = llvm::CGFT_ObjectFile;
-
-        if (TheTargetMachine->addPassesToEmitFile(pass, dest, nullptr, FileType)) {
-            llvm::errs() << "TheTargetMachine can't emit a file of this type";
-            return;
-        }
-
-        pass.run(*clone);
-        dest.flush();
+        dest << data;
+        dest.close();
 
         if (opt_verbose)
             llvm::outs() << "Wrote " << filesystem::absolute(filesystem::path(Filename)) << "\n";
+    }
 
-        dest.close();
+    /**
+     * @description:    assemble the assembly printed by code generator
+     * @param:          asm_text: assembly of current module
+     * @param:          dest: stream of object file
+     * @return:         true if succeeded
+     */
+    static bool llvm_assemble(llvm::StringRef asm_text, llvm::raw_pwrite_stream &dest) {
+        const llvm::Target &T = TheTargetMachine->getTarget();
+        const llvm::Triple &TT = TheTargetMachine->getTargetTriple();
+        const llvm::MCTargetOptions &MCOptions = TheTargetMachine->Options.MCOptions;
+
+        unique_ptr<llvm::MCRegisterInfo> MRI(T.createMCRegInfo(TT.str()));
+        unique_ptr<llvm::MCAsmInfo> MAI(T.createMCAsmInfo(*MRI, TT.str(), MCOptions));
+        unique_ptr<llvm::MCSubtargetInfo> STI(T.createMCSubtargetInfo(
+                TT.str(), TheTargetMachine->getTargetCPU(), TheTargetMachine->getTargetFeatureString()));
+        unique_ptr<llvm::MCInstrInfo> MCII(T.createMCInstrInfo());
+        if (!MRI || !MAI || !STI || !MCII) return false;
+
+        llvm::SourceMgr SrcMgr;
+        SrcMgr.AddNewSourceBuffer(llvm::MemoryBuffer::getMemBuffer(asm_text, "asm", false), llvm::SMLoc());
+
+        llvm::MCContext Ctx(TT, MAI.get(), MRI.get(), STI.get(), &SrcMgr, &MCOptions);
+        unique_ptr<llvm::MCObjectFileInfo> MOFI(
+                T.createMCObjectFileInfo(Ctx, TheTargetMachine->isPositionIndependent()));
+        Ctx.setObjectFileInfo(MOFI.get());
+
+        auto CE = T.createMCCodeEmitter(*MCII, *MRI, Ctx);
+        auto MAB = T.createMCAsmBackend(*STI, *MRI, MCOptions);
+        if (!CE || !MAB) return false;
+        auto OW = MAB->createObjectWriter(dest);
+
+        unique_ptr<llvm::MCStreamer> Str(T.createMCObjectStreamer(
+                TT, Ctx, unique_ptr<llvm::MCAsmBackend>(MAB), std::move(OW),
+                unique_ptr<llvm::MCCodeEmitter>(CE), *STI,
+                MCOptions.MCRelaxAll, MCOptions.MCIncrementalLinkerCompatible, false));
+
+        unique_ptr<llvm::MCAsmParser> Parser(llvm::createMCAsmParser(SrcMgr, Ctx, *Str, *MAI));
+        unique_ptr<llvm::MCTargetAsmParser> TAP(T.createMCAsmParser(*STI, *Parser, *MCII, MCOptions));
+        if (!TAP) return false;
+        Parser->setTargetParser(*TAP);
+
+        return !Parser->Run(false);
     }
 
-    void llvm_emit_asm() {
-        std::filesystem::path dir = filesystem::path(input_file_path_absolut).filename();
-        string file_basename;
-        if (input_file_name_no_suffix == MODULE_INIT_NAME)
-            file_basename = dir.string();
-        else if (input_file_name_no_suffix == MODULE_LIB_NAME)
-            file_basename = module_name_nopath;
-        else
-            file_basename = input_file_name_no_suffix;
+    /**
+     * @description:    run code generator once for object file, and assembly
+     *                  file if needed. when both are required, the object is
+     *                  assembled from the printed assembly instead of running
+     *                  instruction selection twice. it modifies the module, so
+     *                  it must be the last emission step
+     * @param:          emit_asm: also write .s file
+     * @return:         none
+     */
+    void llvm_emit_machine_code(bool emit_asm) {
+        llvm::SmallVector<char, 0> code;
+        llvm::raw_svector_ostream code_stream(code);
 
-        auto Filename =
-                output_root_path + SYSTEM_PATH_DIVIDER + input_file_path_relative + SYSTEM_PATH_DIVIDER +
-                string(file_basename) + ".s";
-        llvm_create_dir(filesystem::path(Filename).parent_path());
-        std::error_code EC;
-        llvm::raw_fd_ostream dest(Filename, EC, llvm::sys::fs::OF_None);
+        llvm::legacy::PassManager pass;
+        auto FileType = emit_asm ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
 
-        if (EC) {
-            llvm::errs() << "Could not open file: " << EC.message();
+        if (TheTargetMachine->addPassesToEmitFile(pass, code_stream, nullptr, FileType)) {
+            llvm::errs() << "TheTargetMachine can't emit a file of this type";
             return;
         }
 
-        llvm::legacy::PassManager pass;
-        auto FileType = llvm::CGFT_AssemblyFile;
+        pass.run(*the_module);
 
-        if (TheTargetMachine->addPassesToEmitFile(pass, dest, nullptr, FileType)) {
-            llvm::errs() << "TheTargetMachine can't emit a file of this type";
+        if (!emit_asm) {
+            llvm_write_file(llvm_output_file_name(".o"), llvm::StringRef(code.data(), code.size()));
             return;
         }
 
-        pass.run(*the_module);
-        dest.flush();
+        llvm_write_file(llvm_output_file_name(".s"), llvm::StringRef(code.data(), code.size()));
 
-        if (opt_verbose)
-            llvm::outs() << "Wrote " << filesystem::absolute(filesystem::path(Filename)) << "\n";
+        llvm::SmallVector<char, 0> obj;
+        llvm::raw_svector_ostream obj_stream(obj);
+        if (!llvm_assemble(llvm::StringRef(code.data(), code.size()), obj_stream)) {
+            throw ExceptionFactory<IRErrException>(
+                    "failed to assemble module " + input_file_name,
+                    0, 0);
+        }
+        llvm_write_file(llvm_output_file_name(".o"), llvm::StringRef(obj.data(), obj.size()));
+    }
+
+    /**
+     * @description:    clone current module. CloneModule of llvm 14 drops
+     *                  ifuncs of target_clones and leaves their users pointing
+     *                  into this module, so users are moved to placeholders
+     *                  while cloning and ifuncs are made again in the clone
+     * @return:         cloned module
+     */
+    static unique_ptr<llvm::Module> llvm_clone_module() {
+        vector<pair<llvm::GlobalIFunc *, llvm::Function *>> placeholders;
+        for (auto &ifunc: the_module->ifuncs()) {
+            auto placeholder = llvm::Function::Create(
+                    llvm::cast<llvm::FunctionType>(ifunc.getValueType()),
+                    llvm::GlobalValue::ExternalLinkage, ifunc.getName() + ".placeholder", the_module);
+            ifunc.replaceAllUsesWith(placeholder);
+            placeholders.emplace_back(&ifunc, placeholder);
+        }
+
+        llvm::ValueToValueMapTy vmt;
+        auto clone = llvm::CloneModule(*the_module, vmt);
+
+        for (auto &i: placeholders) {
+            auto ifunc = i.first;
+            auto cloned_placeholder = llvm::cast<llvm::Function>(vmt[i.second]);
+            auto cloned_ifunc = llvm::GlobalIFunc::create(
+                    ifunc->getValueType(), ifunc->getAddressSpace(), ifunc->getLinkage(), ifunc->getName(),
+                    llvm::cast<llvm::Constant>(vmt[ifunc->getResolver()]), clone.get());
+            cloned_placeholder->replaceAllUsesWith(cloned_ifunc);
+            cloned_placeholder->eraseFromParent();
+
+            i.second->replaceAllUsesWith(ifunc);
+            i.second->eraseFromParent();
+        }
+        return clone;
     }
 
     void llvm_emit_bitcode() {
@@ -747,41 +882,22 @@ namespace AVSI {
          * It is important to CLONE the module.
          * Generating bitcode directly may cause segmentation fault.
          */
-        llvm::ValueToValueMapTy vmt;
-        auto clone = llvm::CloneModule(*the_module, vmt).release();
-
-        vector<string> remove_list;
-        for (auto &fun: clone->functions()) {
-            if (fun.hasExternalLinkage()) {
-                fun.deleteBody();
-            } else {
-                remove_list.emplace_back(fun.getName());
-            }
-        }
-
-        for (const auto &fun_name: remove_list) {
-            auto fun = clone->getFunction(fun_name);
-            fun->replaceAllUsesWith(llvm::UndefValue::get((llvm::Type *) fun->getType()));
-            fun->eraseFromParent();
-        }
-
-        remove_list.clear();
-        for (auto &glb: clone->globals()) {
-            if (glb.getLinkage() == llvm::GlobalValue::LinkageTypes::PrivateLinkage) {
-                remove_list.emplace_back(string(glb.getName()));
-            }
-        }
-
-        for (const auto &glb_name: remove_list) {
-            auto glb = clone->getGlobalVariable(glb_name, true);
-            glb->replaceAllUsesWith(llvm::UndefValue::get((llvm::Type *) glb->getType()));
-            glb->eraseFromParent();
-        }
-
+        auto clone = llvm_clone_module().release();
 
+        // keep the whole module, "import" reads declarations from .avsii
+        // and bodies are loaded from here only when they are inlined
         std::error_code EC;
         llvm::raw_fd_ostream dest(Filename, EC, llvm::sys::fs::OF_None);
-        llvm::WriteBitcodeToFile(*clone, dest);
+        if (opt_thin_lto) {
+            llvm_lower_ifuncs(*clone);
+
+            // summary drives cross-module import and hash keys ThinLTO cache
+            llvm::ProfileSummaryInfo PSI(*clone);
+            auto index = llvm::buildModuleSummaryIndex(*clone, nullptr, &PSI);
+            llvm::WriteBitcodeToFile(*clone, dest, false, &index, true);
+        } else {
+            llvm::WriteBitcodeToFile(*clone, dest);
+        }
 
         dest.flush();
 
@@ -853,8 +969,161 @@ namespace AVSI {
         }
     }
 
+    /*
+     * prints remarks of -Rpass, -Rpass-missed and -Rpass-analysis for passes
+     * whose name matches, and warnings of loop hints the optimizer could
+     * not follow. other diagnostics go to the default printer of llvm
+     */
+    class RemarkHandler : public llvm::DiagnosticHandler {
+    private:
+        llvm::Regex passed;
+        llvm::Regex missed;
+        llvm::Regex analysis;
+        bool has_passed;
+        bool has_missed;
+        bool has_analysis;
+
+    public:
+        RemarkHandler()
+                : passed(remark_pass), missed(remark_pass_missed), analysis(remark_pass_analysis),
+                  has_passed(!remark_pass.empty()), has_missed(!remark_pass_missed.empty()),
+                  has_analysis(!remark_pass_analysis.empty()) {}
+
+        bool isAnyRemarkEnabled() const override {
+            return has_passed || has_missed || has_analysis;
+        }
+
+        bool isPassedOptRemarkEnabled(llvm::StringRef PassName) const override {
+            return has_passed && passed.match(PassName);
+        }
+
+        bool isMissedOptRemarkEnabled(llvm::StringRef PassName) const override {
+            return has_missed && missed.match(PassName);
+        }
+
+        bool isAnalysisRemarkEnabled(llvm::StringRef PassName) const override {
+            return has_analysis && analysis.match(PassName);
+        }
+
+        bool handleDiagnostics(const llvm::DiagnosticInfo &DI) override {
+            auto *opt = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&DI);
+            if (!opt) return false;
+
+            unsigned line = 0, column = 0;
+            if (opt->isLocationAvailable()) {
+                line = opt->getLocation().getLine();
+                column = opt->getLocation().getColumn();
+            }
+            int col = column ? (int) column - 1 : 0;
+
+            if (DI.getKind() == llvm::DK_OptimizationFailure) {
+                Warning(opt->getMsg(), line, col);
+                return true;
+            }
+
+            if (!opt->isEnabled()) return true;
+
+            string flag = "-Rpass-analysis";
+            if (DI.getKind() == llvm::DK_OptimizationRemark || DI.getKind() == llvm::DK_MachineOptimizationRemark) {
+                flag = "-Rpass";
+            } else if (DI.getKind() == llvm::DK_OptimizationRemarkMissed ||
+                       DI.getKind() == llvm::DK_MachineOptimizationRemarkMissed) {
+                flag = "-Rpass-missed";
+            }
+
+            // reasons of a loop hint not followed are printed without -R
+            string pass = opt->getPassName().str();
+            if (pass != llvm::OptimizationRemarkAnalysis::AlwaysPrint) flag += "=" + pass;
+            Remark(opt->getMsg() + " [" + flag + "]", line, col);
+            return true;
+        }
+    };
+
+    /**
+     * @description:    run LLVM default pipeline of the optimization level
+     *                  selected by -O0..-O3, -Os or -Oz. with --lto only the
+     *                  pre-link part runs, the rest is done by the linker
+     * @return:         none
+     */
     void llvm_run_optimization() {
-        the_module_fpm->run(*the_module);
+        // bodies of other modules are linked in by the link time optimizer
+        if (opt_optimize && !opt_lto) llvm_link_imported_bodies();
+
+        llvm::OptimizationLevel level = llvm::OptimizationLevel::O0;
+        if (opt_size_level == 1) level = llvm::OptimizationLevel::Os;
+        else if (opt_size_level == 2) level = llvm::OptimizationLevel::Oz;
+        else if (opt_level == 1) level = llvm::OptimizationLevel::O1;
+        else if (opt_level == 2) level = llvm::OptimizationLevel::O2;
+        else if (opt_level == 3) level = llvm::OptimizationLevel::O3;
+
+        // -march and -mattr are kept in functions for link time optimization,
+        // versions of target_clones have their own features
+        string CPU = TheTargetMachine->getTargetCPU().str();
+        string Features = TheTargetMachine->getTargetFeatureString().str();
+        for (auto &fun: the_module->functions()) {
+            if (fun.isDeclaration()) continue;
+            if (CPU != "generic") fun.addFnAttr("target-cpu", CPU);
+            if (!Features.empty() && !fun.hasFnAttribute("target-features")) fun.addFnAttr("target-features", Features);
+        }
+
+        // size levels are also read by passes and codegen from attributes
+        if (opt_size_level) {
+            for (auto &fun: the_module->functions()) {
+                if (fun.isDeclaration()) continue;
+                fun.addFnAttr(llvm::Attribute::OptimizeForSize);
+                if (opt_size_level == 2) fun.addFnAttr(llvm::Attribute::MinSize);
+            }
+        }
+
+        llvm::PipelineTuningOptions PTO;
+        PTO.LoopUnrolling = level.getSpeedupLevel() > 1;
+        PTO.LoopInterleaving = level.getSpeedupLevel() > 1;
+        PTO.LoopVectorization = level.getSpeedupLevel() > 1 && level.getSizeLevel() < 2;
+        PTO.SLPVectorization = level.getSpeedupLevel() > 1 && level.getSizeLevel() < 2;
+
+        llvm::LoopAnalysisManager LAM;
+        llvm::FunctionAnalysisManager FAM;
+        llvm::CGSCCAnalysisManager CGAM;
+        llvm::ModuleAnalysisManager MAM;
+
+        the_context->setDiagnosticHandler(std::make_unique<RemarkHandler>());
+
+        llvm::PassBuilder PB(TheTargetMachine, PTO);
+        // checks of -fbounds-check on induction variables are split out of
+        // loops by irce. it needs rotated loops, and has to run before
+        // indvars turns the checks into loop exits
+        if (opt_bounds_check) {
+            PB.registerPipelineStartEPCallback(
+                    [](llvm::ModulePassManager &MPM, llvm::OptimizationLevel Level) {
+                        if (Level == llvm::OptimizationLevel::O0) return;
+                        llvm::FunctionPassManager FPM;
+                        FPM.addPass(llvm::SROAPass());
+                        FPM.addPass(llvm::EarlyCSEPass());
+                        FPM.addPass(llvm::InstCombinePass());
+                        FPM.addPass(llvm::SimplifyCFGPass());
+                        FPM.addPass(llvm::LoopSimplifyPass());
+                        FPM.addPass(llvm::LCSSAPass());
+                        FPM.addPass(llvm::createFunctionToLoopPassAdaptor(llvm::LoopRotatePass()));
+                        FPM.addPass(llvm::IRCEPass());
+                        MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(FPM)));
+                    });
+        }
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        llvm::ModulePassManager MPM;
+        if (level == llvm::OptimizationLevel::O0)
+            MPM = PB.buildO0DefaultPipeline(level, opt_lto);
+        else if (opt_thin_lto)
+            MPM = PB.buildThinLTOPreLinkDefaultPipeline(level);
+        else if (opt_lto)
+            MPM = PB.buildLTOPreLinkDefaultPipeline(level);
+        else
+            MPM = PB.buildPerModuleDefaultPipeline(level);
+        MPM.run(*the_module, MAM);
     }
 
     void debug_type(llvm::Value *v) {
@@ -918,55 +1187,78 @@ namespace AVSI {
         return basicl == basicr;
     }
 
-    uint64_t registerType(llvm::Type *Ty) {
-        if (Ty == nullptr) {
-            return 0;
-        }
-
-        llvm::Constant *s = llvm::ConstantInt::get(I64_TY, the_module->getDataLayout().getTypeAllocSize(Ty));
-        auto size = llvm::dyn_cast<llvm::ConstantInt>(s)->getLimitedValue();
-        if (type_size.find(Ty) == type_size.end()) {
-            type_size[Ty] = size;
-        }
-        if (type_name.find(Ty) == type_name.end()) {
-            if (Ty->isArrayTy()) {
-                string name = "arr[";
-                registerType(Ty->getArrayElementType());
-                name += type_name[Ty->getArrayElementType()];
-                name += ";" + to_string(Ty->getArrayNumElements()) + "]";
-                type_name[Ty] = name;
-            } else if (Ty->isVectorTy()) {
-                string name = "vec[";
-                registerType(Ty->getScalarType());
-                name += type_name[Ty->getScalarType()];
-                name += ";" + to_string(((llvm::VectorType*)Ty)->getElementCount().getKnownMinValue()) + "]";
-                type_name[Ty] = name;
-            } else if (Ty->isPtrOrPtrVectorTy()) {
-                string name;
-                registerType(Ty->getPointerElementType());
-                name += type_name[Ty->getPointerElementType()] + "*";
-                type_name[Ty] = name;
-            } else if (Ty->isStructTy()) {
-                string name = "AnonymousObj{";
-                int ele_num = Ty->getStructNumElements();
-                bool first_flag = true;
-                for (int i = 0; i < ele_num; i++) {
-                    if (!first_flag) {
-                        name += ",";
-                    }
-                    first_flag = false;
-                    auto ty = Ty->getStructElementType(i);
-                    registerType(ty);
-                    name += type_name[ty];
+    /**
+     * @description:    mangled names a function call may refer to
+     * @param:          modinfo: module path written before function name
+     * @param:          id: function name
+     * @return:         candidate names, in order of lookup
+     */
+    vector<string> getFunctionNameCandidates(vector<string> modinfo, string id) {
+        vector<string> func_names;
+        if (modinfo.empty()) {
+            // function in currnet module
+            func_names.push_back(getFunctionNameMangling(module_path_with_module_name, id));
+        } else if (modinfo[0] == "root") {
+            // absolute path
+            vector<string> p;
+            modinfo.erase(modinfo.begin());
+            p.insert(p.end(), package_path.begin(), package_path.end());
+            p.insert(p.end(), modinfo.begin(), modinfo.end());
+            func_names.push_back(getFunctionNameMangling(p, id));
+        } else {
+            // may be relative path
+            auto fun_path = module_path;
+            fun_path.insert(fun_path.end(), modinfo.begin(), modinfo.end());
+            func_names.push_back(getFunctionNameMangling(fun_path, id));
+            // may be alias
+            string head = modinfo[0];
+            if (module_name_alias.find(head) != module_name_alias.end()) {
+                auto path_cut = modinfo;
+                path_cut.erase(path_cut.begin());
+                head = module_name_alias[head];
+                auto head_to_origin = getpathUnresolvedToList(head);
+                for (auto i: path_cut) {
+                    head_to_origin.push_back(i);
                 }
-                name += "}";
-                type_name[Ty] = name;
-            } else {
-                type_name[Ty] = "unnamedType";
+                func_names.push_back(getFunctionNameMangling(head_to_origin, id));
             }
+            // may be absolute
+            func_names.push_back(getFunctionNameMangling(modinfo, id));
+        }
+        return func_names;
+    }
+
+    /**
+     * @description:    register a struct type, offsets of members are
+     *                  computed by data layout of target
+     * @param:          id: name of struct
+     * @param:          Ty: llvm type of struct
+     * @param:          member_names: name of each member, empty if no name
+     * @return:         definition of struct
+     */
+    StructDef *registerStruct(string id, llvm::StructType *Ty, vector<string> member_names) {
+        StructDef *sd = new StructDef(Ty);
+        sd->id = id;
+        auto layout = the_module->getDataLayout().getStructLayout(Ty);
+        for (unsigned i = 0; i < member_names.size(); i++) {
+            if (member_names[i].empty()) continue;
+            sd->members[member_names[i]] = StructMember{(int) i, layout->getElementOffset(i)};
         }
+        sd->member_names = member_names;
+
+        struct_types[id] = sd;
+        struct_defs[Ty] = sd;
+        return sd;
+    }
 
-        return size;
+    /**
+     * @description:    find definition of a struct by its llvm type
+     * @param:          Ty: llvm type of struct
+     * @return:         definition of struct, nullptr if it is not registered
+     */
+    StructDef *findStructDef(llvm::Type *Ty) {
+        auto def = struct_defs.find(Ty);
+        return def == struct_defs.end() ? nullptr : def->second;
     }
 
     /**
@@ -987,6 +1279,162 @@ namespace AVSI {
                 name.c_str());
     }
 
+    /**
+     * @description:    attach loop hints to the back edges of a loop as
+     *                  llvm.loop metadata. no_alias puts memory accesses of
+     *                  the loop into an access group, so the vectorizer takes
+     *                  the iterations as independent without checking them
+     * @param:          hint: hints written before the loop
+     * @param:          header: target of back edges
+     * @param:          preheader: block entering the loop, every other
+     *                  predecessor of header is a back edge. blocks of the
+     *                  loop are from header to the end of function
+     * @return:         none
+     */
+    void llvm_set_loop_hint(const LoopHint &hint, llvm::BasicBlock *header, llvm::BasicBlock *preheader) {
+        if (hint.empty()) return;
+
+        llvm::SmallVector<llvm::Metadata *, 8> props;
+        // operand 0 is the loop id itself
+        props.push_back(nullptr);
+
+        auto property = [&](const char *name, llvm::Constant *value) {
+            llvm::SmallVector<llvm::Metadata *, 2> ops = {llvm::MDString::get(*the_context, name)};
+            if (value) ops.push_back(llvm::ConstantAsMetadata::get(value));
+            props.push_back(llvm::MDNode::get(*the_context, ops));
+        };
+        auto count = [&](int n) -> llvm::Constant * {
+            return llvm::ConstantInt::get(llvm::Type::getInt32Ty(*the_context), n);
+        };
+        auto power_of_two = [&](int n, const string &name) {
+            if (n > 1 && (n & (n - 1))) {
+                Warning(name + " count " + to_string(n) + " is not a power of two, ignored by the vectorizer",
+                        hint.line, hint.column);
+            }
+        };
+
+        if (hint.unroll == 0) {
+            property("llvm.loop.unroll.enable", nullptr);
+        } else if (hint.unroll == 1) {
+            property("llvm.loop.unroll.disable", nullptr);
+        } else if (hint.unroll > 1) {
+            property("llvm.loop.unroll.count", count(hint.unroll));
+        }
+
+        // vectorize(1) keeps the loop scalar, interleave alone still asks for
+        // the vectorizer, which may interleave a scalar loop
+        if (hint.vectorize == 1) {
+            property("llvm.loop.vectorize.width", count(1));
+        } else if (hint.vectorize >= 0 || hint.interleave >= 0) {
+            property("llvm.loop.vectorize.enable", llvm::ConstantInt::getTrue(*the_context));
+            power_of_two(hint.vectorize, "vectorize");
+            if (hint.vectorize > 1) property("llvm.loop.vectorize.width", count(hint.vectorize));
+        }
+        if (hint.interleave > 0) {
+            power_of_two(hint.interleave, "interleave");
+            property("llvm.loop.interleave.count", count(hint.interleave));
+        }
+
+        if (hint.no_alias) {
+            llvm::MDNode *group = llvm::MDNode::getDistinct(*the_context, {});
+            llvm::Function *fun = header->getParent();
+            for (auto BB = header->getIterator(); BB != fun->end(); BB++) {
+                for (auto &I: *BB) {
+                    if (!I.mayReadOrWriteMemory()) continue;
+                    // accesses of an inner no_alias loop are in both groups
+                    I.setMetadata(llvm::LLVMContext::MD_access_group,
+                                  llvm::uniteAccessGroups(I.getMetadata(llvm::LLVMContext::MD_access_group), group));
+                }
+            }
+            props.push_back(llvm::MDNode::get(
+                    *the_context, {llvm::MDString::get(*the_context, "llvm.loop.parallel_accesses"), group}));
+        }
+
+        llvm::MDNode *loop_id = llvm::MDNode::getDistinct(*the_context, props);
+        loop_id->replaceOperandWith(0, loop_id);
+
+        for (auto BB: llvm::predecessors(header)) {
+            if (BB == preheader) continue;
+            BB->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop, loop_id);
+        }
+    }
+
+    /**
+     * @description:    a vector reached by a pointer may point into an array
+     *                  of its elements, which is only aligned as the element.
+     *                  lower the alignment of the access so it is not a fault
+     * @param:          inst: load or store of a vector
+     * @param:          ptr: address of the access
+     * @return:         none
+     */
+    void llvm_vector_access_align(llvm::Instruction *inst, llvm::Value *ptr) {
+        llvm::Type *ty = ptr->getType()->getPointerElementType();
+        if (!ty->isVectorTy()) return;
+
+        llvm::Value *base = ptr->stripPointerCasts();
+        if (llvm::isa<llvm::AllocaInst>(base) || llvm::isa<llvm::GlobalVariable>(base)) return;
+
+        llvm::Align align = the_module->getDataLayout().getABITypeAlign(ty->getScalarType());
+        if (auto *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+            load->setAlignment(align);
+        } else if (auto *st = llvm::dyn_cast<llvm::StoreInst>(inst)) {
+            st->setAlignment(align);
+        }
+    }
+
+    /**
+     * @description:    -fbounds-check, abort by __avsi_bounds_fail in libavsi
+     *                  if index is not less than len. the compare is unsigned,
+     *                  so a negative index fails too. the optimizer removes
+     *                  checks proven true, irce splits the others out of loops
+     * @param:          index: integer index
+     * @param:          len: length of array
+     * @param:          line: line of index
+     * @param:          column: column of index
+     * @return:         none
+     */
+    void llvm_bounds_check(llvm::Value *index, uint64_t len, int line, int column) {
+        auto c = llvm::dyn_cast<llvm::ConstantInt>(index);
+        if (c && !c->isNegative() && c->getValue().getLimitedValue() < len) return;
+
+        auto fail_ty = llvm::FunctionType::get(VOID_TY, {I64_TY, I64_TY, I8_TY->getPointerTo(), I32_TY, I32_TY}, false);
+        auto fail = the_module->getOrInsertFunction(BOUNDS_FAIL_FUNCTION, fail_ty);
+        if (auto f = llvm::dyn_cast<llvm::Function>(fail.getCallee())) {
+            f->setDoesNotReturn();
+            f->setDoesNotThrow();
+            f->addFnAttr(llvm::Attribute::Cold);
+        }
+
+        auto file = the_module->getNamedGlobal(BOUNDS_FILE_NAME);
+        if (!file) {
+            auto init = llvm::ConstantDataArray::getString(*the_context, input_file_name);
+            file = new llvm::GlobalVariable(*the_module, init->getType(), true,
+                                            llvm::GlobalValue::PrivateLinkage, init, BOUNDS_FILE_NAME);
+            file->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        }
+
+        auto the_function = builder->GetInsertBlock()->getParent();
+        auto fail_bb = llvm::BasicBlock::Create(*the_context, "bounds.fail", the_function);
+        auto ok_bb = llvm::BasicBlock::Create(*the_context, "bounds.ok", the_function);
+
+        index = builder->CreateSExtOrTrunc(index, I64_TY);
+        auto len_v = llvm::ConstantInt::get(I64_TY, len);
+        auto in_bounds = builder->CreateICmpULT(index, len_v, "bounds");
+        builder->CreateCondBr(in_bounds, ok_bb, fail_bb,
+                              llvm::MDBuilder(*the_context).createBranchWeights(1 << 20, 1));
+
+        builder->SetInsertPoint(fail_bb);
+        builder->CreateCall(fail, {
+                index, len_v,
+                builder->CreateConstInBoundsGEP2_32(file->getValueType(), file, 0, 0),
+                llvm::ConstantInt::get(I32_TY, line),
+                llvm::ConstantInt::get(I32_TY, column + 1)
+        });
+        builder->CreateUnreachable();
+
+        builder->SetInsertPoint(ok_bb);
+    }
+
     /**
      * @description:    get offset address of variable
      * @param:          base: base address
@@ -1002,7 +1450,14 @@ namespace AVSI {
 
             if (index->getType()->isFloatingPointTy()) {
                 index = builder->CreateFPToSI(index, I32_TY);
-            } else if (index->getType() != I32_TY) {
+            }
+            if (opt_bounds_check && builder->GetInsertBlock()) {
+                uint64_t len = current_ty->isArrayTy()
+                               ? current_ty->getArrayNumElements()
+                               : llvm::cast<llvm::FixedVectorType>(current_ty)->getNumElements();
+                llvm_bounds_check(index, len, offset->getToken().line, offset->getToken().column);
+            }
+            if (index->getType() != I32_TY) {
                 index = builder->CreateSExtOrTrunc(index, I32_TY);
             }
             offset_list.push_back(index);
@@ -1027,19 +1482,15 @@ namespace AVSI {
                 auto struct_ty = current_ty;
                 if (current_ty->isPtrOrPtrVectorTy()) struct_ty = current_ty->getPointerElementType();
 
-                for (auto iter: struct_types) {
-                    if (iter.second->Ty == struct_ty) {
-                        if (iter.second->members.find(member_name) == iter.second->members.end()) {
-                            break;
-                        }
-
-                        auto index = iter.second->members[member_name];
+                StructDef *def = findStructDef(struct_ty);
+                if (def) {
+                    auto member = def->members.find(member_name);
+                    if (member != def->members.end()) {
                         offset_list.push_back(llvm::ConstantInt::get(
                                 I32_TY,
-                                index,
+                                member->second.index,
                                 true));
                         find_flag = true;
-                        break;
                     }
                 }
 
@@ -1079,21 +1530,10 @@ namespace AVSI {
                 index = builder->CreateSExtOrTrunc(index, MACHINE_WIDTH_TY);
             }
 
-            index = builder->CreateMul(
-                    index,
-                    llvm::ConstantInt::get(
-                            MACHINE_WIDTH_TY,
-                            current_ty->getPointerElementType()->isPtrOrPtrVectorTy()
-                            ? PTR_SIZE
-                            : type_size[current_ty->getPointerElementType()]
-                    )
-
-            );
-
+            // gep keeps the pointer visible to alias analysis and scev,
+            // so loops over the memory can be vectorized
             base = builder->CreateLoad(current_ty, base);
-            base = builder->CreatePtrToInt(base, ISIZE_TY, "idx_ptr_conv");
-            base = builder->CreateAdd(base, index, "idx_ptr_conv");
-            base = builder->CreateIntToPtr(base, current_ty, "idx_ptr_conv");
+            base = builder->CreateInBoundsGEP(current_ty->getPointerElementType(), base, index, "idx_ptr");
         } else {
             throw ExceptionFactory<TypeException>(
                     "subscripted value is not an array, pointer, or structure",
@@ -1240,8 +1680,8 @@ namespace AVSI {
                             )
                             ) {
                         // get struct path to locate function
-                        auto struct_name = type_name[left_ty->isPtrOrPtrVectorTy() ? left_ty->getPointerElementType()
-                                                                                   : left_ty];
+                        auto struct_name = type_table.name(left_ty->isPtrOrPtrVectorTy() ? left_ty->getPointerElementType()
+                                                                                   : left_ty);
                         auto index = struct_name.find('{');
                         string part = struct_name.substr(0, index);
                         auto struct_path = getpathUnresolvedToList(part);
@@ -1288,6 +1728,54 @@ namespace AVSI {
         return v;
     }
 
+    /**
+     * @description:    store an array value without loading it as a whole.
+     *                  array values are loads of their address, so they are
+     *                  copied by memcpy, zero constants by memset
+     * @param:          v: array value
+     * @param:          addr: address to store
+     * @return:         none
+     */
+    void storeAggregate(llvm::Value *v, llvm::Value *addr) {
+        llvm::Type *Ty = v->getType();
+        uint64_t size = type_table.size(Ty);
+
+        if (auto load = llvm::dyn_cast<llvm::LoadInst>(v)) {
+            builder->CreateMemCpy(addr, load->getAlign(), load->getPointerOperand(), load->getAlign(), size);
+        } else if (auto cons = llvm::dyn_cast<llvm::Constant>(v)) {
+            if (cons->isNullValue()) {
+                builder->CreateMemSet(addr, llvm::ConstantInt::get(I8_TY, 0), size, llvm::MaybeAlign());
+            } else {
+                auto data = new llvm::GlobalVariable(
+                        *the_module, Ty, true,
+                        llvm::GlobalValue::PrivateLinkage,
+                        cons, "__constant.arr");
+                data->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+                builder->CreateMemCpy(addr, llvm::MaybeAlign(), data, llvm::MaybeAlign(), size);
+            }
+        } else {
+            builder->CreateStore(v, addr);
+        }
+    }
+
+    /**
+     * @description:    erase loads of whole arrays and objs which are not
+     *                  used. such a load stands for the value of array, but
+     *                  users mostly take its address instead
+     * @param:          fun: function generated
+     * @return:         none
+     */
+    void eraseDeadAggregateLoads(llvm::Function *fun) {
+        for (auto &BB: *fun) {
+            for (auto iter = BB.begin(); iter != BB.end();) {
+                auto load = llvm::dyn_cast<llvm::LoadInst>(&*iter++);
+                if (load && load->getType()->isAggregateType() && load->use_empty() && !load->isVolatile()) {
+                    load->eraseFromParent();
+                }
+            }
+        }
+    }
+
     /**
      * @description:    perform a stored action, including automatic type conversion
      * @param:          ast: AST of assignment, just for debug message
@@ -1348,13 +1836,10 @@ namespace AVSI {
          * function definition
          */
         auto assign_err = [&](llvm::Type *l, llvm::Type *r) -> void {
-            registerType(l);
-            registerType(r);
-
             throw ExceptionFactory<TypeException>(
                     "failed to store value, except type '" +
-                    type_name[l] +
-                    "', offered '" + type_name[r] + "'",
+                    type_table.name(l) +
+                    "', offered '" + type_table.name(r) + "'",
                     ast->getToken().line, ast->getToken().column);
         };
 
@@ -1372,18 +1857,15 @@ namespace AVSI {
                         ast->getToken().line, ast->getToken().column);
             }
 
-            builder->CreateStore(v, addr);
+            llvm_vector_access_align(builder->CreateStore(v, addr), addr);
             if (create_new_space) {
                 if (l_is_single_value && assignment) {
                     symbol_table->insert(l_base_name, addr, true);
                 } else {
-                    if (l_alloca_content_type) registerType(l_alloca_content_type);
-                    registerType(v->getType());
-
                     throw ExceptionFactory<SysErrException>(
                             "failed to store value, left: " +
-                            (l_alloca_content_type ? type_name[l_alloca_content_type] : string("null")) + " right: " +
-                            type_name[v->getType()],
+                            (l_alloca_content_type ? type_table.name(l_alloca_content_type) : string("null")) + " right: " +
+                            type_table.name(v->getType()),
                             ast->getToken().line, ast->getToken().column);
                 }
             }
@@ -1412,23 +1894,17 @@ namespace AVSI {
                         ast->getToken().line, ast->getToken().column);
             }
 
-            if (type_size.find(l_type) != type_size.end()) registerType(l_type);
-            if (type_size.find(r_type) != type_size.end()) registerType(r_type);
-
-            auto size = min(type_size[l_type], type_size[r_type]);
+            auto size = min(type_table.size(l_type), type_table.size(r_type));
             builder->CreateMemCpy(l_addr, llvm::MaybeAlign(), r_addr, llvm::MaybeAlign(), size);
 
             if (create_new_space) {
                 if (l_is_single_value && assignment) {
                     symbol_table->insert(l_base_name, addr, true);
                 } else {
-                    if (l_alloca_content_type) registerType(l_alloca_content_type);
-                    registerType(r_addr->getType()->getPointerElementType());
-
                     throw ExceptionFactory<SysErrException>(
                             "failed to store value, left: " +
-                            (l_alloca_content_type ? type_name[l_alloca_content_type] : string("null")) + " right: " +
-                            type_name[r_addr->getType()->getPointerElementType()],
+                            (l_alloca_content_type ? type_table.name(l_alloca_content_type) : string("null")) + " right: " +
+                            type_table.name(r_addr->getType()->getPointerElementType()),
                             ast->getToken().line, ast->getToken().column);
                 }
             }
@@ -1436,6 +1912,14 @@ namespace AVSI {
             return !create_new_space;
         };
 
+        // a number stored to a vector is broadcast to every element
+        llvm::Type *l_vector_type = l_except_type_is_offered ? l_except_type : l_alloca_content_type;
+        if (l_vector_type && l_vector_type->isVectorTy() && simple_types.find(r_type) != simple_types.end()) {
+            create_new_space = l_vector_type != l_alloca_content_type;
+            r_value = type_conv(ast, r_value, r_type, l_vector_type);
+            return assign(r_value, create_new_space ? nullptr : l_alloca_addr, l_vector_type);
+        }
+
         if (simple_types.find(r_type) != simple_types.end()) {
             if (l_alloca_content_type && simple_types.find(l_alloca_content_type) != simple_types.end() &&
                 l_alloca_content_type != VOID_TY) {
@@ -1478,7 +1962,7 @@ namespace AVSI {
                     r_value = builder->CreateTrunc(r_value, store_type, "conv.si.trunc");
                 }
                 Warning(
-                    "implicit conversion from '" + type_name[r_type] + "' to '" + type_name[store_type] + "'",
+                    "implicit conversion from '" + type_table.name(r_type) + "' to '" + type_table.name(store_type) + "'",
                     ast->getToken().line,
                     ast->getToken().column
                 );
@@ -1489,7 +1973,14 @@ namespace AVSI {
             llvm::Function *the_scope = builder->GetInsertBlock()->getParent();
             if (!r_alloca_addr) {
                 r_alloca_addr = allocaBlockEntry(the_scope, "arr.init", r_type);
-                builder->CreateStore(r_value, r_alloca_addr);
+                storeAggregate(r_value, r_alloca_addr);
+            }
+
+            if (!assignment && l_alloca_addr && l_alloca_content_type->isArrayTy() &&
+                l_alloca_content_type->getArrayElementType() == r_type->getArrayElementType()) {
+                // member of obj is initialized by a copy
+                create_new_space = false;
+                return memcp(l_alloca_addr, r_alloca_addr, l_alloca_content_type, r_type);
             }
 
             if (!l_except_type_is_offered) {
@@ -1537,56 +2028,32 @@ namespace AVSI {
                 }
             }
         } else if (r_type->isVectorTy()) {
-            llvm::Function *the_scope = builder->GetInsertBlock()->getParent();
-            if (!r_alloca_addr) {
-                r_alloca_addr = allocaBlockEntry(the_scope, "vec.init", r_type);
-                builder->CreateStore(r_value, r_alloca_addr);
-            }
+            // vectors are values like numbers, they are converted and stored
+            // to the variable instead of binding it
+            llvm::Type *l_type = l_except_type_is_offered ? l_except_type : l_alloca_content_type;
 
-            if (!l_except_type_is_offered) {
-                if (!l_alloca_addr) {
-                    bind(r_alloca_addr);
-                    return false;
-                } else {
-                    if (l_alloca_content_type->isVectorTy() && l_alloca_content_type->getScalarType() == r_type->getArrayElementType()) {
-                        bind(r_alloca_addr);
-                        return false;
-                    } else if (l_alloca_content_type->isArrayTy() && l_alloca_content_type->getArrayElementType() == r_type->getArrayElementType()) {
-                        create_new_space = false;
-                        return memcp(l_alloca_addr, r_alloca_addr, l_alloca_content_type, r_type);
-                    } else {
-                        bind(r_alloca_addr);
-                        return false;
-                    }
-                }
-            } else {
-                if (!l_alloca_addr) {
-                    if (l_except_type->isArrayTy() && l_except_type->getArrayElementType() == r_type->getArrayElementType()) {
-                        create_new_space = true;
-                        return memcp(nullptr, r_alloca_addr, l_except_type, r_type);
-                    } else if (l_except_type->isVectorTy() && l_except_type->getScalarType() == r_type->getArrayElementType()) {
-                        bind(r_alloca_addr);
-                        return false;
-                    } else {
-                        assign_err(l_except_type, r_type);
-                    }
-                } else {
-                    if (l_except_type == l_alloca_content_type) {
-                        bind(r_alloca_addr);
-                        return false;
-                    } else {
-                        if (l_except_type->isArrayTy() && l_except_type->getArrayElementType() == r_type->getArrayElementType()) {
-                            create_new_space = true;
-                            return memcp(nullptr, r_alloca_addr, l_except_type, r_type);
-                        } else if (l_except_type->isVectorTy() && l_except_type->getScalarType() == r_type->getArrayElementType()) {
-                            bind(r_alloca_addr);
-                            return false;
-                        } else {
-                            assign_err(l_except_type, r_type);
-                        }
-                    }
+            if (l_type && l_type->isArrayTy() &&
+                l_type->getArrayElementType() == r_type->getScalarType()) {
+                if (!r_alloca_addr) {
+                    llvm::Function *the_scope = builder->GetInsertBlock()->getParent();
+                    r_alloca_addr = allocaBlockEntry(the_scope, "vec.init", r_type);
+                    builder->CreateStore(r_value, r_alloca_addr);
                 }
+                create_new_space = l_type != l_alloca_content_type;
+                return memcp(create_new_space ? nullptr : l_alloca_addr, r_alloca_addr, l_type, r_type);
+            }
+
+            if (l_type && l_type->isVectorTy() &&
+                llvm::cast<llvm::FixedVectorType>(l_type)->getNumElements() ==
+                llvm::cast<llvm::FixedVectorType>(r_type)->getNumElements()) {
+                store_type = l_type;
+                create_new_space = l_type != l_alloca_content_type;
+                r_value = type_conv(ast, r_value, r_type, store_type);
+            } else if (l_except_type_is_offered) {
+                assign_err(l_except_type, r_type);
             }
+
+            return assign(r_value, create_new_space ? nullptr : l_alloca_addr, store_type);
         } else if (r_type->isPtrOrPtrVectorTy()) {
             if (l_alloca_content_type && l_alloca_content_type == r_type) {
                 store_type = r_type;
@@ -1636,6 +2103,35 @@ namespace AVSI {
         bool is_v_simple = simple_types.find(vtype) != simple_types.end();
         bool is_e_simple = simple_types.find(etype) != simple_types.end();
 
+        // vectors convert element by element, a scalar is broadcast
+        if (etype->isVectorTy()) {
+            auto count = llvm::cast<llvm::FixedVectorType>(etype)->getNumElements();
+            auto e_elem = etype->getScalarType();
+            if (is_v_simple) {
+                v = type_conv(ast, v, vtype, e_elem, AllowPtrConv);
+                return builder->CreateVectorSplat(count, v, "splat");
+            }
+
+            if (vtype->isVectorTy() && llvm::cast<llvm::FixedVectorType>(vtype)->getNumElements() == count) {
+                auto v_elem = vtype->getScalarType();
+                bool is_v_fp = v_elem->isFloatingPointTy();
+                bool is_e_fp = e_elem->isFloatingPointTy();
+                if (is_v_fp && is_e_fp) {
+                    return builder->CreateFPCast(v, etype, "conv.fp");
+                } else if (!is_v_fp && is_e_fp) {
+                    return v_elem == I1_TY
+                           ? builder->CreateUIToFP(v, etype, "conv.zi.fp")
+                           : builder->CreateSIToFP(v, etype, "conv.si.fp");
+                } else if (is_v_fp && !is_e_fp) {
+                    return builder->CreateFPToSI(v, etype, "conv.fp.si");
+                } else if (v_elem == I1_TY) {
+                    return builder->CreateZExt(v, etype, "conv.zi.ext");
+                } else {
+                    return builder->CreateSExtOrTrunc(v, etype, "conv.si");
+                }
+            }
+        }
+
         if (is_v_simple && is_e_simple) {
             bool is_v_fp = vtype->isFloatingPointTy();
             bool is_e_fp = etype->isFloatingPointTy();
@@ -1674,7 +2170,7 @@ namespace AVSI {
                 return builder->CreatePointerBitCastOrAddrSpaceCast(v, etype, "conv.ptr");
             } else if (is_v_ptr && is_e_arr) {
                 throw ExceptionFactory<SyntaxException>(
-                        "undefined C-like cast '" + type_name[vtype] + "' to '" + type_name[etype] +
+                        "undefined C-like cast '" + type_table.name(vtype) + "' to '" + type_table.name(etype) +
                         "'. cast from pointer to array is not allowed",
                         ast->getToken().line, ast->getToken().column);
             } else if (is_v_arr && is_e_ptr) {
@@ -1693,7 +2189,7 @@ namespace AVSI {
             }
 
             throw ExceptionFactory<TypeException>(
-                    "undefined cast '" + type_name[vtype] + "' to '" + type_name[etype] + "'",
+                    "undefined cast '" + type_table.name(vtype) + "' to '" + type_table.name(etype) + "'",
                     ast->getToken().line, ast->getToken().column);
         } else {
             bool is_v_ptr = vtype->isPtrOrPtrVectorTy();
@@ -1708,7 +2204,7 @@ namespace AVSI {
             }
 
             throw ExceptionFactory<TypeException>(
-                    "undefined cast '" + type_name[vtype] + "' to '" + type_name[etype] + "'",
+                    "undefined cast '" + type_table.name(vtype) + "' to '" + type_table.name(etype) + "'",
                     ast->getToken().line, ast->getToken().column);
         }
     }
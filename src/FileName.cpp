@@ -35,7 +35,11 @@ std::string compiler_command_line;
 std::string compiler_exec_path;
 std::string output_root_path;
 std::vector<std::string> include_path;
+// where libavsi.a is searched by --run
+std::vector<std::string> library_path;
 std::vector<std::string> package_path;
+// source files of modules which are importing this one, outermost first
+std::vector<std::string> import_chain;
 
 std::string input_file_name_raw;
 std::string input_file_name;
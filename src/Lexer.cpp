@@ -29,6 +29,7 @@
  */
 
 #include "../inc/Lexer.h"
+#include "../inc/TimeReport.h"
 #include "Exception.h"
 #include <cstring>
 
@@ -44,7 +45,7 @@ namespace AVSI {
     Lexer::Lexer(void) {
     }
 
-    Lexer::Lexer(ifstream *file) {
+    Lexer::Lexer(istream *file) {
         this->file = file;
         this->linenum = 1;
         this->cur = 0;
@@ -83,6 +84,7 @@ namespace AVSI {
                     getline(*this->file, this->line);
                     this->line += " ";
                     this->currentChar = this->line[this->cur];
+                    if (this->recording) this->record += "\n" + this->line;
                 } else {
                     this->currentChar = EOF;
                     return;
@@ -98,6 +100,8 @@ namespace AVSI {
      * @return:         a token for parser
      */
     Token Lexer::getNextToken() {
+        TimeScope t("lex");
+
         while (this->currentChar != EOF) {
             int line = this->linenum, column = this->cur;
             if (this->currentChar == ' ') {
@@ -540,6 +544,7 @@ namespace AVSI {
         backup->line = this->line;
         backup->currentChar = this->currentChar;
         backup->file_state_backup = file->tellg();
+        backup->record_size_backup = this->record.size();
     }
 
     void Lexer::restore(Lexer *backup) {
@@ -548,6 +553,31 @@ namespace AVSI {
         this->line = backup->line;
         this->currentChar = backup->currentChar;
         file->seekg(backup->file_state_backup);
+        this->record.resize(backup->record_size_backup);
+    }
+
+    /**
+     * @description:    record source text from the current character
+     * @return:         None
+     */
+    void Lexer::startRecord() {
+        this->recording = true;
+        this->record = this->line.substr(this->cur);
+    }
+
+    /**
+     * @description:    stop recording
+     * @return:         source text from startRecord to the current
+     *                  character, excluded
+     */
+    string Lexer::stopRecord() {
+        this->recording = false;
+        string text = this->record;
+        if (this->currentChar != EOF) {
+            text.resize(text.size() - (this->line.size() - this->cur));
+        }
+        this->record.clear();
+        return text;
     }
 
 } // namespace AVSI
\ No newline at end of file
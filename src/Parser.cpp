@@ -67,9 +67,10 @@ namespace AVSI {
     extern vector<string> module_path_with_module_name;
 
     extern map<string, StructDef *> struct_types;
+    extern map<string, GenericTemplate *> function_templates;
+    extern map<string, GenericTemplate *> object_templates;
 
-    extern map<llvm::Type *, string> type_name;
-    extern map<llvm::Type *, uint32_t> type_size;
+    extern TypeTable type_table;
 
     extern map<string, string> module_name_alias;
 
@@ -83,8 +84,6 @@ namespace AVSI {
     extern llvm::Type *I1_TY;
     extern llvm::Type *VOID_TY;
 
-    extern map<llvm::Type *, string> type_name;
-
     extern set<llvm::Type *> simple_types;
     extern map<TokenType, llvm::Type *> token_to_simple_types;
 
@@ -108,17 +107,30 @@ namespace AVSI {
 #endif
     }
 
+    Parser::Parser(Lexer *lexer, map<string, Type> type_params) : Parser(lexer) {
+        this->type_params = type_params;
+    }
+
     Parser::~Parser() {}
 
     /*******************************************************
      *                         parser                      *
      *******************************************************/
-    pair<map<string, StructDef *>::iterator, string> find_struct(vector<string> modinfo, string &name) {
+    /**
+     * @description:    find a name defined in a module, like a struct
+     * @param:          table: names with module path
+     * @param:          modinfo: module path written before name
+     * @param:          name: name without module path
+     * @return:         iterator of table and the name with module path
+     */
+    template<typename T>
+    static pair<typename map<string, T>::iterator, string>
+    find_in_module(map<string, T> &table, vector<string> modinfo, string &name) {
         string id = name;
         // try no mangle
-        auto ty = struct_types.find(id);
+        auto ty = table.find(id);
 
-        if (ty == struct_types.end()) {
+        if (ty == table.end()) {
             if (modinfo.empty()) {
                 // try local
                 id.clear();
@@ -126,7 +138,7 @@ namespace AVSI {
                     id.append(i + "::");
                 }
                 id.append(name);
-                ty = struct_types.find(id);
+                ty = table.find(id);
             } else if (modinfo[0] == "root") {
                 // try external, absolute path
                 id.clear();
@@ -139,10 +151,10 @@ namespace AVSI {
                     id.append(i + "::");
                 }
                 id.append(name);
-                ty = struct_types.find(id);
+                ty = table.find(id);
             } else {
                 // try alias
-                if (ty == struct_types.end()) {
+                if (ty == table.end()) {
                     string head = modinfo[0];
                     if (module_name_alias.find(head) != module_name_alias.end()) {
                         auto path_cut = modinfo;
@@ -158,12 +170,12 @@ namespace AVSI {
                             id.append(i + "::");
                         }
                         id.append(name);
-                        ty = struct_types.find(id);
+                        ty = table.find(id);
                     }
                 }
 
                 // try external, relative path
-                if (ty == struct_types.end()) {
+                if (ty == table.end()) {
                     id.clear();
                     for (auto i: module_path) {
                         id.append(i + "::");
@@ -173,12 +185,28 @@ namespace AVSI {
                     }
                     id.append(name);
 
-                    ty = struct_types.find(id);
+                    ty = table.find(id);
                 }
             }
         }
 
-        return pair<map<string, StructDef *>::iterator, string>(ty, id);
+        return pair<typename map<string, T>::iterator, string>(ty, id);
+    }
+
+    pair<map<string, StructDef *>::iterator, string> find_struct(vector<string> modinfo, string &name) {
+        return find_in_module(struct_types, modinfo, name);
+    }
+
+    pair<map<string, GenericTemplate *>::iterator, string> find_object_template(vector<string> modinfo, string &name) {
+        return find_in_module(object_templates, modinfo, name);
+    }
+
+    GenericTemplate *find_function_template(vector<string> modinfo, string &name) {
+        for (auto &i: getFunctionNameCandidates(modinfo, name)) {
+            auto gt = function_templates.find(i);
+            if (gt != function_templates.end()) return gt->second;
+        }
+        return nullptr;
     }
 
 
@@ -281,6 +309,7 @@ namespace AVSI {
         bool is_noinline = false;
         bool is_pure = false;
         bool is_const = false;
+        vector<string> target_clones;
 
         auto token_is_function_attr = [](Token t) -> bool {
             for (TokenType i: FUNCTION_ATTR) {
@@ -329,19 +358,43 @@ namespace AVSI {
                 is_const = true;
                 eat(CONST);
             }
+
+            if (this->currentToken.getType() == TARGET_CLONES) {
+                eat(TARGET_CLONES);
+                eat(LPAR);
+                while (true) {
+                    Token target = this->currentToken;
+                    eat(STRING);
+                    target_clones.push_back(target.getValue().any_cast<string>());
+                    if (this->currentToken.getType() != COMMA) break;
+                    eat(COMMA);
+                }
+                eat(RPAR);
+            }
         }
 
         TokenType token_type = this->currentToken.getType();
 
         if (token_type == FUNCTION) {
             PARSE_LOG(STATEMENT);
-            shared_ptr<FunctionDecl> function = static_pointer_cast<FunctionDecl>(functionDecl());
+            shared_ptr<AST> decl = functionDecl();
+            if (decl == ASTEmptyNotEnd) {
+                // generic function, attributes are given to its instances
+                this->last_template->is_inline = is_inline;
+                this->last_template->is_always_inline = is_always_inline;
+                this->last_template->is_noinline = is_noinline;
+                this->last_template->is_pure = is_pure;
+                llvm_register_template(this->last_template);
+                return decl;
+            }
+            shared_ptr<FunctionDecl> function = static_pointer_cast<FunctionDecl>(decl);
             function->is_export = is_export;
             function->is_mangle = is_mangle;
             function->is_inline = is_inline;
             function->is_always_inline = is_always_inline;
             function->is_noinline = is_noinline;
             function->is_pure = is_pure;
+            function->target_clones = target_clones;
             return function;
         } else if (token_type == RETURN) {
             PARSE_LOG(STATEMENT);
@@ -358,6 +411,9 @@ namespace AVSI {
         } else if (token_type == WHILE) {
             PARSE_LOG(STATEMENT);
             return WhileStatement();
+        } else if (find(begin(LOOP_HINT), end(LOOP_HINT), token_type) != end(LOOP_HINT)) {
+            PARSE_LOG(STATEMENT);
+            return loopStatement();
         } else if (token_type == GENERIC) {
             PARSE_LOG(STATEMENT);
             shared_ptr<Generic> gen = static_pointer_cast<Generic>(generic());
@@ -372,7 +428,12 @@ namespace AVSI {
             return glb;
         } else if (token_type == OBJ) {
             PARSE_LOG(STATEMENT);
-            shared_ptr<Object> obj = static_pointer_cast<Object>(object(is_mangle));
+            shared_ptr<AST> decl = object(is_mangle);
+            if (decl == ASTEmptyNotEnd) {
+                llvm_register_template(this->last_template);
+                return decl;
+            }
+            shared_ptr<Object> obj = static_pointer_cast<Object>(decl);
             obj->is_export = is_export;
             obj->is_mangle = is_mangle;
             return obj;
@@ -493,6 +554,136 @@ namespace AVSI {
         return make_shared<For>(For(initList, condition, adjustment, compound, noCondition, token));
     }
 
+    void Parser::loopHint(LoopHint &hint) {
+        if (hint.empty()) {
+            hint.line = this->currentToken.line;
+            hint.column = this->currentToken.column;
+        }
+
+        // count in parentheses is optional, 0 if it is not written
+        auto count = [&]() -> int {
+            if (this->currentToken.getType() != LPAR) return 0;
+            eat(LPAR);
+            Token num = this->currentToken;
+            eat(INTEGER);
+            eat(RPAR);
+            int n = num.getValue().any_cast<int>();
+            if (n < 1) {
+                throw ExceptionFactory<SyntaxException>(
+                        "count of loop hint must be positive",
+                        num.line, num.column);
+            }
+            return n;
+        };
+
+        TokenType type = this->currentToken.getType();
+        eat(type);
+        if (type == UNROLL) {
+            hint.unroll = count();
+        } else if (type == VECTORIZE) {
+            hint.vectorize = count();
+        } else if (type == INTERLEAVE) {
+            hint.interleave = count();
+        } else {
+            hint.no_alias = true;
+        }
+    }
+
+    void Parser::parallelClause(ParallelLoop &parallel) {
+        if (this->currentToken.getType() == PARALLEL) {
+            // parallel, parallel(dynamic) or parallel(guided, 16)
+            parallel.enabled = true;
+            eat(PARALLEL);
+            if (this->currentToken.getType() != LPAR) return;
+
+            eat(LPAR);
+            Token schedule = this->currentToken;
+            eat(ID);
+            string name = schedule.getValue().any_cast<string>();
+            if (name == "static") {
+                parallel.schedule = ParallelLoop::STATIC;
+            } else if (name == "dynamic") {
+                parallel.schedule = ParallelLoop::DYNAMIC;
+            } else if (name == "guided") {
+                parallel.schedule = ParallelLoop::GUIDED;
+            } else {
+                throw ExceptionFactory<SyntaxException>(
+                        "unknown schedule '" + name + "', expected static, dynamic or guided",
+                        schedule.line, schedule.column);
+            }
+            if (this->currentToken.getType() == COMMA) {
+                eat(COMMA);
+                parallel.chunk = expr();
+            }
+            eat(RPAR);
+            return;
+        }
+
+        // reduce(+: sum, max: top)
+        eat(REDUCE);
+        eat(LPAR);
+        while (true) {
+            Token op = this->currentToken;
+            string name;
+            if (op.getType() == PLUS) {
+                name = "+";
+            } else if (op.getType() == STAR) {
+                name = "*";
+            } else if (op.getType() == ID) {
+                name = op.getValue().any_cast<string>();
+            }
+            if (name != "+" && name != "*" && name != "min" && name != "max") {
+                throw ExceptionFactory<SyntaxException>(
+                        "reduction operator must be +, *, min or max",
+                        op.line, op.column);
+            }
+            eat(op.getType());
+            eat(COLON);
+            Token var = this->currentToken;
+            eat(ID);
+            parallel.reductions.emplace_back(name, var);
+            if (this->currentToken.getType() != COMMA) break;
+            eat(COMMA);
+        }
+        eat(RPAR);
+    }
+
+    shared_ptr<AST> Parser::loopStatement() {
+        LoopHint hint;
+        ParallelLoop parallel;
+        Token first = this->currentToken;
+
+        while (find(begin(LOOP_HINT), end(LOOP_HINT), this->currentToken.getType()) != end(LOOP_HINT)) {
+            TokenType type = this->currentToken.getType();
+            if (type == PARALLEL || type == REDUCE) {
+                parallelClause(parallel);
+            } else {
+                loopHint(hint);
+            }
+        }
+
+        if (!parallel.enabled && !parallel.reductions.empty()) {
+            throw ExceptionFactory<SyntaxException>(
+                    "reduce must be used with parallel",
+                    first.line, first.column);
+        }
+
+        if (this->currentToken.getType() == FOR) {
+            shared_ptr<For> loop = static_pointer_cast<For>(forStatement());
+            loop->hint = hint;
+            loop->parallel = parallel;
+            return loop;
+        } else if (this->currentToken.getType() == WHILE && !parallel.enabled) {
+            shared_ptr<While> loop = static_pointer_cast<While>(WhileStatement());
+            loop->hint = hint;
+            return loop;
+        }
+
+        throw ExceptionFactory<SyntaxException>(
+                parallel.enabled ? "parallel must be followed by for" : "loop hints must be followed by for or while",
+                this->currentToken.line, this->currentToken.column);
+    }
+
     shared_ptr<AST> Parser::functionDecl() {
         PARSE_LOG(FUNCTIONDECL);
 
@@ -503,6 +694,28 @@ namespace AVSI {
         token.setModInfo(struct_info);
         eat(ID);
 
+        if (this->currentToken.getType() == LT) {
+            if (!struct_info.empty()) {
+                throw ExceptionFactory<SyntaxException>(
+                        "member function can't be generic",
+                        token.line, token.column
+                );
+            }
+            genericTemplate(id);
+            return ASTEmptyNotEnd;
+        }
+
+        return functionTail(token, id);
+    }
+
+    /**
+     * @description:    parse function after its name, from the parameters
+     *                  to the end of body
+     * @param:          token: token of keyword 'function'
+     * @param:          id: name of function
+     * @return:         FunctionDecl
+     */
+    shared_ptr<AST> Parser::functionTail(Token token, string id) {
         eat(LPAR);
         shared_ptr<Param> paramList = static_pointer_cast<Param>(param());
         // check types
@@ -545,6 +758,11 @@ namespace AVSI {
         string id_clone = id;
         eat(ID);
 
+        vector<Type> type_args;
+        if (this->currentToken.getType() == LT) {
+            type_args = eatTypeArgs();
+        }
+
         vector<shared_ptr<AST> > paramList;
         eat(LPAR);
         if (this->currentToken.getType() != RPAR) {
@@ -556,6 +774,14 @@ namespace AVSI {
         }
         eat(RPAR);
 
+        if (!type_args.empty()) {
+            auto gt = find_object_template(token.getModInfo(), id_clone);
+            if (gt.first != object_templates.end()) {
+                Type ty = instantiateObject(gt.first->second, type_args, token);
+                return make_shared<StructInit>(StructInit(ty.second, paramList, token));
+            }
+        }
+
         auto ty = find_struct(token.getModInfo(), id_clone);
 
         if (ty.first != struct_types.end()) {
@@ -564,9 +790,160 @@ namespace AVSI {
         }
 
         shared_ptr<FunctionCall> fun = make_shared<FunctionCall>(FunctionCall(id, paramList, token));
+        fun->type_args = type_args;
         return fun;
     }
 
+    /**
+     * @description:    parse type parameters of generic function or obj and
+     *                  keep the rest of its source, which is parsed again for
+     *                  every instance
+     * @param:          name: name of function or obj
+     * @return:         template, it's registered by statement
+     */
+    GenericTemplate *Parser::genericTemplate(string name) {
+        PARSE_LOG(GENERICTEMPLATE);
+
+        auto gt = new GenericTemplate();
+        gt->name = name;
+        gt->module_path = module_path;
+        gt->module_path_with_module_name = module_path_with_module_name;
+        gt->id = getpathListToUnresolved(module_path_with_module_name) + "::" + name;
+
+        eat(LT);
+        while (true) {
+            Token param = this->currentToken;
+            eat(ID);
+            string param_name = param.getValue().any_cast<string>();
+            if (find(gt->params.begin(), gt->params.end(), param_name) != gt->params.end()) {
+                throw ExceptionFactory<SyntaxException>(
+                        "duplicate type parameter '" + param_name + "'",
+                        param.line, param.column
+                );
+            }
+            gt->params.push_back(param_name);
+
+            if (this->currentToken.getType() != COMMA) break;
+            eat(COMMA);
+        }
+
+        if (this->currentToken.getType() == GT) {
+            gt->line = this->lexer->linenum;
+            gt->column = this->lexer->cur;
+            this->lexer->startRecord();
+        }
+        eat(GT);
+
+        // skip to the end of body, braces are matched
+        int depth = 0;
+        while (true) {
+            TokenType type = this->currentToken.getType();
+            if (type == END) {
+                throw ExceptionFactory<SyntaxException>(
+                        "missing body of generic '" + name + "'",
+                        this->currentToken.line, this->currentToken.column
+                );
+            }
+            if (type == LBRACE) depth++;
+            if (type == RBRACE && --depth == 0) break;
+            eat(type);
+        }
+        gt->source = this->lexer->stopRecord();
+        eat(RBRACE);
+
+        this->last_template = gt;
+        return gt;
+    }
+
+    /**
+     * @description:    check if current ID names a generic function or obj,
+     *                  then '<' after it starts type arguments
+     * @return:         true if it's generic
+     */
+    bool Parser::isGenericName() {
+        string id = this->currentToken.getValue().any_cast<string>();
+        auto modinfo = this->currentToken.getModInfo();
+        return find_function_template(modinfo, id) != nullptr ||
+               find_object_template(modinfo, id).first != object_templates.end();
+    }
+
+    /**
+     * @description:    parse type arguments in '<' and '>'
+     * @return:         types
+     */
+    vector<Type> Parser::eatTypeArgs() {
+        vector<Type> args;
+
+        eat(LT);
+        while (true) {
+            args.push_back(eatType());
+            if (this->currentToken.getType() != COMMA) break;
+            eat(COMMA);
+        }
+
+        // '>>' closes two lists, the second '>' is left to outer list
+        Token token = this->currentToken;
+        if (token.getType() == SHR) {
+            this->lastToken = token;
+            this->currentToken = Token(GT, '>', token.line, token.column + 1);
+        } else if (token.getType() == SHRU) {
+            this->lastToken = token;
+            this->currentToken = Token(SHR, string(">>"), token.line, token.column + 1);
+        } else {
+            eat(GT);
+        }
+
+        return args;
+    }
+
+    /**
+     * @description:    get instance of generic obj, the obj is parsed with
+     *                  type parameters bound to arguments the first time
+     * @param:          gt: template of obj
+     * @param:          args: type arguments
+     * @param:          token: where the instance is used
+     * @return:         type of instance
+     */
+    Type Parser::instantiateObject(GenericTemplate *gt, vector<Type> args, Token token) {
+        if (args.size() != gt->params.size()) {
+            throw ExceptionFactory<TypeException>(
+                    "'" + gt->id + "' takes " + to_string(gt->params.size()) +
+                    " type arguments but " + to_string(args.size()) + " are given",
+                    token.line, token.column
+            );
+        }
+
+        vector<llvm::Type *> tys;
+        for (auto &i: args) {
+            if (i.first == nullptr || i.first->isVoidTy()) {
+                throw ExceptionFactory<TypeException>(
+                        "invalid type argument of '" + gt->id + "'",
+                        token.line, token.column
+                );
+            }
+            tys.push_back(i.first);
+        }
+
+        string id = llvm_instance_name(gt, tys);
+
+        // type parameters of a generic function, it's a pattern to infer them
+        llvm::Type *pattern = llvm_object_pattern(gt, tys);
+        if (pattern) return Type(pattern, id);
+
+        auto inst = gt->object_instances.find(tys);
+        if (inst != gt->object_instances.end()) return Type(inst->second, id);
+
+        // instance from other module
+        auto def = struct_types.find(id);
+        if (def == struct_types.end()) {
+            llvm_parse_instance(gt, args, id);
+            def = struct_types.find(id);
+        }
+
+        llvm_object_instance(def->second->Ty, gt, tys);
+        return Type(def->second->Ty, id);
+    }
+
     shared_ptr<AST> Parser::generic() {
         PARSE_LOG(GENERIC);
 
@@ -799,16 +1176,33 @@ namespace AVSI {
                 id.append(i + "::");
             }
         }
-        id.append(this->currentToken.getValue().any_cast<string>());
+        string name = this->currentToken.getValue().any_cast<string>();
+        id.append(name);
         eat(ID);
+
+        if (this->currentToken.getType() == LT) {
+            GenericTemplate *gt = genericTemplate(name);
+            gt->id = id;
+            gt->is_object = true;
+            return ASTEmptyNotEnd;
+        }
+
+        return objectTail(token, id);
+    }
+
+    /**
+     * @description:    parse obj after its name, from '{' to '}'
+     * @param:          token: token of keyword 'obj'
+     * @param:          id: name of obj with module path
+     * @return:         Object
+     */
+    shared_ptr<AST> Parser::objectTail(Token token, string id) {
         eat(LBRACE);
 
         shared_ptr<Param> members_list = static_pointer_cast<Param>(param());
         vector<Variable *> &li = members_list->paramList;
         vector<llvm::Type *> member_types;
-        map<string, int> member_index;
-        int index = 0;
-        uint32_t struct_size = 0;
+        vector<string> member_names;
 
         llvm::NamedMDNode *meta = the_module->getOrInsertNamedMetadata("struct." + id);
         vector<llvm::Metadata *> mdlist;
@@ -830,7 +1224,8 @@ namespace AVSI {
                 );
             }
 
-            if (simple_types.find(i->Ty.first) == simple_types.end() && i->Ty.second != "arr") {
+            if (simple_types.find(i->Ty.first) == simple_types.end() && i->Ty.second != "arr" &&
+                !i->Ty.first->isPointerTy()) {
                 if (struct_types.find(i->Ty.second) == struct_types.end()) {
                     throw ExceptionFactory<MissingException>(
                             "missing type '" + i->Ty.second + "'",
@@ -840,8 +1235,7 @@ namespace AVSI {
             }
 
             member_types.push_back(i->Ty.first);
-            struct_size += i->Ty.first->isPtrOrPtrVectorTy() ? PTR_SIZE : type_size[i->Ty.first];
-            member_index[i->id] = index++;
+            member_names.push_back(i->id);
             auto mdnode = llvm::MDNode::get(*the_context, {llvm::MDString::get(*the_context, i->id),
                                                            llvm::MDString::get(*the_context, "struct_member")});
             meta->addOperand(mdnode);
@@ -865,25 +1259,10 @@ namespace AVSI {
                 });
 
 
-        StructDef *sd = new StructDef(Ty);
-        sd->members = member_index;
-        struct_types[id] = sd;
-
-        // generate type name
-        string struct_type_name = id + "{";
-        bool first_flag = true;
-        for (auto i: member_types) {
-            if (!first_flag) {
-                struct_type_name += ",";
-            }
-            first_flag = false;
-            struct_type_name += type_name[i];
-        }
-        struct_type_name += "}";
-        type_name[Ty] = struct_type_name;
-        type_size[Ty] = struct_size;
+        registerStruct(id, Ty, member_names);
 
-        auto meta_size = llvm::MDNode::get(*the_context, {llvm::MDString::get(*the_context, to_string(struct_size)),
+        string struct_type_name = type_table.name(Ty);
+        auto meta_size = llvm::MDNode::get(*the_context, {llvm::MDString::get(*the_context, to_string(type_table.size(Ty))),
                                                           llvm::MDString::get(*the_context, "struct_size")});
         meta->addOperand(meta_size);
         auto meta_name = llvm::MDNode::get(*the_context, {llvm::MDString::get(*the_context, struct_type_name),
@@ -1216,13 +1595,15 @@ namespace AVSI {
                 eat(ty);
                 ret = make_shared<UnaryOp>(UnaryOp(token, factor()));
                 break;
-            case ID:
-                if (this->lexer->peekNextToken().getType() == LPAR) {
+            case ID: {
+                TokenType follow = this->lexer->peekNextToken().getType();
+                if (follow == LPAR || (follow == LT && isGenericName())) {
                     ret = functionCall();
                 } else {
                     ret = variable();
                 }
                 break;
+            }
             case DOLLAR:
                 ret = variable();
                 break;
@@ -1436,7 +1817,7 @@ namespace AVSI {
     shared_ptr<AST> Parser::IDHead() {
         Token token = this->currentToken;
         Token follow = this->lexer->peekNextToken();
-        if (follow.getType() == LPAR) {
+        if (follow.getType() == LPAR || (follow.getType() == LT && isGenericName())) {
             return functionCall();
         } else {
             /*
@@ -1475,7 +1856,7 @@ namespace AVSI {
             TokenType token = this->currentToken.getType();
             eat(token);
             auto ty = token_to_simple_types[token];
-            ret = Type(ty, type_name[ty]);
+            ret = Type(ty, type_table.name(ty));
         } else if (this->currentToken.getType() == ARR) {
             eat(ARR);
             eat(LSQB);
@@ -1501,17 +1882,9 @@ namespace AVSI {
                 eat(RSQB);
                 if (array_size != 0) {
                     llvm::Type *Ty = llvm::ArrayType::get(nest.first, array_size);
-                    type_name[Ty] = "arr[" + type_name[nest.first] + ":" + to_string(array_size) + "]";
-                    type_name[Ty->getPointerTo()] = type_name[Ty] + "*";
-                    type_size[Ty] = type_size[nest.first] * array_size;
-                    type_name[Ty->getPointerTo()] = PTR_SIZE;
                     ret = Type(Ty, "arr");
                 } else {
                     llvm::Type *Ty = nest.first->getPointerTo();
-                    type_name[Ty] = type_name[nest.first] + "*";
-                    type_name[Ty->getPointerTo()] = type_name[Ty] + "*";
-                    type_size[Ty] = PTR_SIZE;
-                    type_name[Ty->getPointerTo()] = PTR_SIZE;
                     ret = Type(Ty, "arr");
                 }
             } else {
@@ -1522,7 +1895,7 @@ namespace AVSI {
                 );
             }
         } else if (this->currentToken.getType() == VEC) {
-            eat(ARR);
+            eat(VEC);
             eat(LSQB);
             if (this->currentToken.getType() != RSQB) {
                 // Type can be any types, even another vector
@@ -1555,10 +1928,6 @@ namespace AVSI {
                 eat(RSQB);
                 if (array_size != 0) {
                     llvm::Type *Ty = llvm::VectorType::get(nest.first, array_size, false);
-                    type_name[Ty] = "vec[" + type_name[nest.first] + ":" + to_string(array_size) + "]";
-                    type_name[Ty->getPointerTo()] = type_name[Ty] + "*";
-                    type_size[Ty] = type_size[nest.first] * array_size;
-                    type_name[Ty->getPointerTo()] = PTR_SIZE;
                     ret = Type(Ty, "vec");
                 } else {
                     throw ExceptionFactory<LogicException>(
@@ -1577,20 +1946,40 @@ namespace AVSI {
         } else if (this->currentToken.getType() == ID) {
             string id = this->currentToken.getValue().any_cast<string>();
             auto modinfo = this->currentToken.getModInfo();
+            Token token = this->currentToken;
 
-            auto ty = find_struct(modinfo, id);
+            if (modinfo.empty() && this->type_params.find(id) != this->type_params.end()) {
+                // type parameter of generic
+                eat(ID);
+                ret = this->type_params[id];
+            } else if (this->lexer->peekNextToken().getType() == LT && isGenericName()) {
+                // instance of generic obj
+                auto gt = find_object_template(modinfo, id);
+                if (gt.first == object_templates.end()) {
+                    throw ExceptionFactory<TypeException>(
+                            "'" + id + "' is not a type",
+                            token.line,
+                            token.column
+                    );
+                }
 
-            if (ty.first == struct_types.end()) {
-                throw ExceptionFactory<MissingException>(
-                        "missing type '" + id + "'",
-                        this->currentToken.line,
-                        this->currentToken.column
-                );
-            }
+                eat(ID);
+                ret = instantiateObject(gt.first->second, eatTypeArgs(), token);
+            } else {
+                auto ty = find_struct(modinfo, id);
 
-            Type Ty = Type(ty.first->second->Ty, ty.second);
-            eat(ID);
-            ret = Ty;
+                if (ty.first == struct_types.end()) {
+                    throw ExceptionFactory<MissingException>(
+                            "missing type '" + id + "'",
+                            token.line,
+                            token.column
+                    );
+                }
+
+                Type Ty = Type(ty.first->second->Ty, ty.second);
+                eat(ID);
+                ret = Ty;
+            }
         } else if (this->currentToken.getType() == DEFAULT) {
             eat(DEFAULT);
             Type Ty = Type(nullptr, "default");
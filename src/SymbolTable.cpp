@@ -34,65 +34,57 @@
 namespace AVSI {
     extern std::string module_name;
 
-    llvm::BasicBlock *SymbolMap::getBasicBlock() const {
-        return this->BB;
-    }
-
     /**
-     * @description:    get allocated space of variable
+     * @description:    find symbol of a name
      * @param:          name: variable name
-     * @return:         pointer point to variable. if not exist, it will
-     *                  return nullptr
+     * @return:         symbol, nullptr if the name is never seen
      */
-    llvm::AllocaInst *SymbolMap::find(string &name) {
-        if (this->named_values.find(name) != this->named_values.end()) {
-            return this->named_values[name.c_str()];
+    Symbol *SymbolTable::lookup(const string &name) {
+        size_t hash = std::hash<string>()(name);
+        size_t mask = this->slots.size() - 1;
+        for (size_t i = hash & mask; this->slots[i] != 0; i = (i + 1) & mask) {
+            Symbol &symbol = this->symbols[this->slots[i] - 1];
+            if (symbol.hash == hash && symbol.name == name) {
+                return &symbol;
+            }
         }
         return nullptr;
     }
 
     /**
-     * @description:    insert a variable to symbol map
+     * @description:    get index of symbol, a new symbol is created for
+     *                  an unseen name
      * @param:          name: variable name
-     * @param:          addr: pointer to allocated space
-     * @return:         none
-     */
-    void SymbolMap::insert(string &name, llvm::AllocaInst *addr) {
-        this->named_values[name] = addr;
-    }
-
-    /**
-     * @description:    get all variables
-     * @return:         list of allocated spaces
+     * @return:         index of symbol
      */
-    vector<llvm::AllocaInst *> SymbolMap::getAllocaList() {
-        vector<llvm::AllocaInst *> addrs;
-        for (const auto &iter: this->named_values) {
-            addrs.push_back(iter.second);
+    uint32_t SymbolTable::intern(const string &name) {
+        size_t hash = std::hash<string>()(name);
+        size_t mask = this->slots.size() - 1;
+        size_t i = hash & mask;
+        for (; this->slots[i] != 0; i = (i + 1) & mask) {
+            Symbol &symbol = this->symbols[this->slots[i] - 1];
+            if (symbol.hash == hash && symbol.name == name) {
+                return this->slots[i] - 1;
+            }
         }
-        return addrs;
-    }
 
-    /**
-     * @description:    insert assignment ast for variable
-     * @param:          name: variable name
-     * @param:          ast: pointer to AST
-     * @return:         none
-     */
-    void SymbolMap::insertAssingedAst(string &name, shared_ptr<AST> ast) {
-        this->assigned_ast[name] = ast;
+        this->symbols.emplace_back(name, hash);
+        this->slots[i] = this->symbols.size();
+        // keep load factor under 1/2
+        if (this->symbols.size() * 2 > this->slots.size()) {
+            this->rehash(this->slots.size() * 2);
+        }
+        return this->symbols.size() - 1;
     }
 
-    /**
-     * @description:    get assignment AST
-     * @param:          name: variable name
-     * @return:         pointer to AST
-     */
-    shared_ptr<AST> SymbolMap::getAssignedAST(string &name) {
-        if (this->assigned_ast.find(name) != this->assigned_ast.end()) {
-            return this->assigned_ast[name];
+    void SymbolTable::rehash(size_t size) {
+        this->slots.assign(size, 0);
+        size_t mask = size - 1;
+        for (uint32_t idx = 0; idx < this->symbols.size(); idx++) {
+            size_t i = this->symbols[idx].hash & mask;
+            while (this->slots[i] != 0) i = (i + 1) & mask;
+            this->slots[i] = idx + 1;
         }
-        return nullptr;
     }
 
     /**
@@ -100,39 +92,53 @@ namespace AVSI {
      * @return:         none
      */
     void SymbolTable::push(llvm::BasicBlock *BB) {
-        llvm::BasicBlock *last_breake_to = nullptr;
-        llvm::BasicBlock *last_continue_to = nullptr;
-        if (!this->maps.empty()) {
-            last_breake_to = this->maps.back()->loop_exit;
-            last_continue_to = this->maps.back()->loop_entry;
+        SymbolScope scope{BB, nullptr, nullptr, nullptr, this->undo_log.size()};
+        if (!this->scopes.empty()) {
+            scope.loop_exit = this->scopes.back().loop_exit;
+            scope.loop_entry = this->scopes.back().loop_entry;
         }
+        scope.di_scope = llvm_debug_lexical_block(this->scopes.empty() ? nullptr : this->scopes.back().di_scope);
 
-        auto *symbol_map = new SymbolMap(BB);
-        symbol_map->loop_exit = last_breake_to;
-        symbol_map->loop_entry = last_continue_to;
-
-        this->maps.push_back(symbol_map);
+        this->scopes.push_back(scope);
     }
 
     /**
-     * @description:    pop a scope
+     * @description:    pop a scope, bindings of the scope are replaced by
+     *                  those of outer scopes
      * @return:         none
      */
-    vector<llvm::AllocaInst *> SymbolTable::pop() {
-        if (this->maps.empty()) {
-            return {};
+    void SymbolTable::pop() {
+        if (this->scopes.empty()) {
+            return;
         }
 
-        SymbolMap *old = this->maps.back();
-        this->maps.pop_back();
-        vector<llvm::AllocaInst *> addrs = old->getAllocaList();
-        delete old;
-
-        return addrs;
+        size_t mark = this->scopes.back().undo_mark;
+        this->scopes.pop_back();
+
+        while (this->undo_log.size() > mark) {
+            SymbolUndo &undo = this->undo_log.back();
+            Symbol &symbol = this->symbols[undo.symbol];
+            if (undo.is_ast) {
+                symbol.assigned_ast = std::move(undo.assigned_ast);
+                symbol.ast_depth = undo.depth;
+            } else {
+                symbol.addr = undo.addr;
+                symbol.addr_depth = undo.depth;
+            }
+            this->undo_log.pop_back();
+        }
     }
 
     llvm::BasicBlock *SymbolTable::getBasicBlock() const {
-        return this->maps.back()->getBasicBlock();
+        return this->scopes.back().BB;
+    }
+
+    /**
+     * @description:    number of scopes, 0 at global level
+     * @return:         depth
+     */
+    size_t SymbolTable::depth() const {
+        return this->scopes.size();
     }
 
     /**
@@ -142,69 +148,97 @@ namespace AVSI {
      *                  return nullptr
      */
     llvm::AllocaInst *SymbolTable::find(string &name) {
-        for (auto iter = this->maps.rbegin(); iter != this->maps.rend(); iter++) {
-            auto ret = (*iter)->find(name);
-            if (ret != nullptr) {
-                return ret;
-            }
-        }
-        return nullptr;
+        Symbol *symbol = this->lookup(name);
+        return symbol ? symbol->addr : nullptr;
     }
 
     /**
      * @description:    insert a variable to current scope
      * @param:          name: variable name
      * @param:          addr: pointer to allocated space
+     * @param:          current_scope: if false, a variable of outer scope
+     *                  with the same name is replaced
+     * @param:          arg_no: number of parameter from 1 in debug information,
+     *                  0 for local variable
      * @return:         none
      */
-    void SymbolTable::insert(basic_string<char> name, llvm::AllocaInst *addr, bool current_scope) {
-        if (!current_scope) {
-            for (auto iter = this->maps.rbegin(); iter != this->maps.rend(); iter++) {
-                auto ret = (*iter)->find(name);
-                if (ret != nullptr) {
-                    (*iter)->insert(name, addr);
-                    return;
-                }
-            }
+    void SymbolTable::insert(basic_string<char> name, llvm::AllocaInst *addr, bool current_scope, unsigned arg_no) {
+        uint32_t idx = this->intern(name);
+        Symbol &symbol = this->symbols[idx];
+
+        uint32_t depth = this->scopes.size();
+        if (!current_scope && symbol.addr) {
+            depth = symbol.addr_depth;
         }
-        this->maps.back()->insert(name, addr);
+
+        if ((symbol.addr_depth == depth ? symbol.addr : nullptr) != addr) {
+            llvm_debug_variable(name, addr, this->scopes[depth - 1].di_scope, arg_no);
+        }
+        if (symbol.addr_depth != depth) {
+            this->undo_log.push_back({idx, false, symbol.addr, nullptr, symbol.addr_depth});
+            symbol.addr_depth = depth;
+        }
+        symbol.addr = addr;
+    }
+
+    llvm::DIScope *SymbolTable::getDebugScope() {
+        return this->scopes.empty() ? nullptr : this->scopes.back().di_scope;
+    }
+
+    void SymbolTable::setDebugScope(llvm::DIScope *scope) {
+        this->scopes.back().di_scope = scope;
     }
 
     llvm::BasicBlock *SymbolTable::getLoopExit() {
-        return this->maps.back()->loop_exit;
+        return this->scopes.back().loop_exit;
     }
 
     llvm::BasicBlock *SymbolTable::getLoopEntry() {
-        return this->maps.back()->loop_entry;
+        return this->scopes.back().loop_entry;
     }
 
     void SymbolTable::setLoopExit(llvm::BasicBlock *BB) {
-        this->maps.back()->loop_exit = BB;
+        this->scopes.back().loop_exit = BB;
     }
 
     void SymbolTable::setLoopEntry(llvm::BasicBlock *BB) {
-        this->maps.back()->loop_entry = BB;
+        this->scopes.back().loop_entry = BB;
     }
 
+    /**
+     * @description:    insert assignment ast for variable
+     * @param:          name: variable name
+     * @param:          ast: pointer to AST
+     * @param:          current_scope: if false, it belongs to the scope
+     *                  where the variable is
+     * @return:         none
+     */
     void SymbolTable::insertAssingedAst(string &name, shared_ptr<AST> ast, bool current_scope) {
-        if (!current_scope) {
-            for (auto iter = this->maps.rbegin(); iter != this->maps.rend(); iter++) {
-                auto ret = (*iter)->find(name);
-                if (ret != nullptr) {
-                    (*iter)->insertAssingedAst(name, ast);
-                    return;
-                }
-            }
+        uint32_t idx = this->intern(name);
+        Symbol &symbol = this->symbols[idx];
+
+        uint32_t depth = this->scopes.size();
+        if (!current_scope && symbol.addr) {
+            depth = symbol.addr_depth;
         }
-        this->maps.back()->insertAssingedAst(name, ast);
+
+        // an assignment in an inner scope is seen until that scope is popped
+        if (symbol.ast_depth < depth) {
+            this->undo_log.push_back({idx, true, nullptr, symbol.assigned_ast, symbol.ast_depth});
+            symbol.ast_depth = depth;
+        }
+        symbol.assigned_ast = ast;
     }
 
+    /**
+     * @description:    get assignment AST
+     * @param:          name: variable name
+     * @return:         pointer to AST
+     */
     shared_ptr<AST> SymbolTable::getAssignedAST(string &name) {
-        for (auto iter = this->maps.rbegin(); iter != this->maps.rend(); iter++) {
-            auto ret = (*iter)->getAssignedAST(name);
-            if (ret != nullptr) {
-                return ret;
-            }
+        Symbol *symbol = this->lookup(name);
+        if (symbol && symbol->ast_depth != 0) {
+            return symbol->assigned_ast;
         }
         return make_shared<NoneAST>(NoneAST());
     }
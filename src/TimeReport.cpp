@@ -0,0 +1,228 @@
+/*
+ * TimeReport.cpp 2025
+ *
+ * compile time report
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <sys/resource.h>
+
+#include "../inc/TimeReport.h"
+#include "../inc/FileName.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+extern bool opt_verbose;
+extern bool opt_time_report;
+extern bool opt_time_report_json;
+extern std::string time_report_output;
+
+namespace AVSI {
+    using namespace std;
+
+    static TimeRecord *root = nullptr;
+    static TimeRecord *current = nullptr;
+    static double root_wall_start = 0;
+    static double root_cpu_start = 0;
+
+    static double wall_now() {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @description:    cpu time of compiler and finished child compilers
+     * @param:          rss: output peak rss of compiler in KiB
+     * @return:         seconds
+     */
+    static double cpu_now(long *rss = nullptr) {
+        struct rusage self{}, children{};
+        getrusage(RUSAGE_SELF, &self);
+        getrusage(RUSAGE_CHILDREN, &children);
+        if (rss) *rss = self.ru_maxrss;
+
+        auto seconds = [](const struct timeval &t) { return (double) t.tv_sec + (double) t.tv_usec / 1e6; };
+        return seconds(self.ru_utime) + seconds(self.ru_stime) +
+               seconds(children.ru_utime) + seconds(children.ru_stime);
+    }
+
+    TimeRecord *TimeRecord::child(const string &name) {
+        for (auto &i: this->children) {
+            if (i->name == name) return i.get();
+        }
+        this->children.push_back(make_unique<TimeRecord>(name));
+        return this->children.back().get();
+    }
+
+    TimeScope::TimeScope(const string &name) : record(nullptr), parent(nullptr), wall_start(0), cpu_start(0) {
+        if (!current) return;
+
+        this->parent = current;
+        this->record = current->child(name);
+        current = this->record;
+        this->wall_start = wall_now();
+        this->cpu_start = cpu_now();
+    }
+
+    TimeScope::~TimeScope() {
+        if (!this->record) return;
+
+        long rss = 0;
+        this->record->cpu += cpu_now(&rss) - this->cpu_start;
+        this->record->wall += wall_now() - this->wall_start;
+        this->record->peak_rss = max(this->record->peak_rss, rss);
+        this->record->count++;
+        current = this->parent;
+    }
+
+    static llvm::json::Value toJSON(const TimeRecord *r) {
+        llvm::json::Array children;
+        for (auto &i: r->children) {
+            children.push_back(toJSON(i.get()));
+        }
+        return llvm::json::Object{
+                {"name",     r->name},
+                {"wall",     r->wall},
+                {"cpu",      r->cpu},
+                {"peak_rss", (int64_t) r->peak_rss},
+                {"count",    (int64_t) r->count},
+                {"children", std::move(children)}
+        };
+    }
+
+    static unique_ptr<TimeRecord> fromJSON(const llvm::json::Object *o) {
+        auto name = o->getString("name");
+        auto r = make_unique<TimeRecord>(name ? name->str() : string("?"));
+        r->wall = o->getNumber("wall").getValueOr(0);
+        r->cpu = o->getNumber("cpu").getValueOr(0);
+        r->peak_rss = (long) o->getInteger("peak_rss").getValueOr(0);
+        r->count = (uint64_t) o->getInteger("count").getValueOr(0);
+        if (auto children = o->getArray("children")) {
+            for (auto &i: *children) {
+                if (auto c = i.getAsObject()) r->children.push_back(fromJSON(c));
+            }
+        }
+        return r;
+    }
+
+    static void printText(llvm::raw_ostream &os, const TimeRecord *r, int depth) {
+        os << llvm::format("%10.4fs %10.4fs %10ld KiB  ", r->wall, r->cpu, r->peak_rss)
+           << string(depth * 2, ' ') << r->name;
+        if (r->count > 1) os << " (x" << r->count << ")";
+        os << "\n";
+        for (auto &i: r->children) {
+            printText(os, i.get(), depth + 1);
+        }
+    }
+
+    /**
+     * @description:    start recording, the whole compile is the root phase
+     * @param:          name: name of root phase
+     * @return:         none
+     */
+    void time_report_init(const string &name) {
+        if (!opt_time_report) return;
+
+        root = new TimeRecord(name);
+        current = root;
+        root_wall_start = wall_now();
+        root_cpu_start = cpu_now();
+    }
+
+    /**
+     * @description:    attach report of a child compiler to current phase
+     * @param:          file: json report written by child compiler
+     * @return:         none
+     */
+    void time_report_attach(const string &file) {
+        if (!current) return;
+
+        auto mbuf = llvm::MemoryBuffer::getFile(file);
+        if (!mbuf) return;
+        auto value = llvm::json::parse((*mbuf)->getBuffer());
+        std::filesystem::remove(file);
+        if (!value) {
+            llvm::consumeError(value.takeError());
+            return;
+        }
+
+        if (auto o = value->getAsObject()) {
+            auto r = fromJSON(o);
+            current->peak_rss = max(current->peak_rss, r->peak_rss);
+            current->children.push_back(std::move(r));
+        }
+    }
+
+    /**
+     * @description:    finish recording. child compiler writes json to the
+     *                  file given by parent, root compiler prints the tree
+     *                  or writes time-report.json to output folder
+     * @return:         none
+     */
+    void time_report_emit() {
+        if (!root) return;
+
+        long rss = 0;
+        root->cpu = cpu_now(&rss) - root_cpu_start;
+        root->wall = wall_now() - root_wall_start;
+        root->peak_rss = max(root->peak_rss, rss);
+        root->count = 1;
+
+        string filename;
+        if (!time_report_output.empty()) {
+            filename = time_report_output;
+        } else if (opt_time_report_json) {
+            filename = output_root_path + SYSTEM_PATH_DIVIDER + "time-report.json";
+        }
+
+        if (filename.empty()) {
+            llvm::errs() << "===" << string(60, '-') << "===\n"
+                         << "  time report\n"
+                         << "===" << string(60, '-') << "===\n"
+                         << llvm::format("%11s %11s %14s  %s\n", (const char *) "wall", (const char *) "cpu",
+                                      (const char *) "peak rss", (const char *) "phase");
+            printText(llvm::errs(), root, 0);
+        } else {
+            std::error_code EC;
+            llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+            if (EC) {
+                llvm::errs() << "Could not open file: " << EC.message();
+                return;
+            }
+            dest << llvm::formatv("{0:2}", toJSON(root)) << "\n";
+            if (opt_verbose && time_report_output.empty())
+                llvm::outs() << "Wrote " << std::filesystem::absolute(std::filesystem::path(filename)) << "\n";
+        }
+
+        delete root;
+        root = nullptr;
+        current = nullptr;
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * TypeTable.cpp 2025
+ *
+ * descriptors of llvm types used by compiler
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Chipen Hsiao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../inc/TypeTable.h"
+#include "../inc/AST.h"
+#include <string>
+
+namespace AVSI {
+    extern llvm::Module *the_module;
+
+    /**
+     * @description:    get descriptor of a type, a new descriptor is
+     *                  created for an unseen type
+     * @param:          Ty: llvm type, nullptr for "default"
+     * @return:         descriptor of type
+     */
+    TypeDesc &TypeTable::get(llvm::Type *Ty) {
+        auto it = this->index.find(Ty);
+        if (it != this->index.end()) {
+            return this->descs[it->second];
+        }
+
+        uint64_t size = Ty->isSized() ? the_module->getDataLayout().getTypeAllocSize(Ty).getFixedSize() : 0;
+        uint32_t id = this->descs.size();
+        this->descs.emplace_back(id, Ty, size);
+        this->index[Ty] = id;
+        return this->descs.back();
+    }
+
+    /**
+     * @description:    get name of a type, it is built once and cached
+     * @param:          Ty: llvm type
+     * @return:         name of type
+     */
+    const string &TypeTable::name(llvm::Type *Ty) {
+        TypeDesc &desc = get(Ty);
+        if (!desc.name.empty()) {
+            return desc.name;
+        }
+        return buildName(desc);
+    }
+
+    const string &TypeTable::buildName(TypeDesc &desc) {
+        llvm::Type *Ty = desc.Ty;
+        string name;
+
+        if (Ty->isIntegerTy()) {
+            unsigned width = Ty->getIntegerBitWidth();
+            name = width == 1 ? "bool" : "i" + std::to_string(width);
+        } else if (Ty->isFloatTy()) {
+            name = "f32";
+        } else if (Ty->isDoubleTy()) {
+            name = "f64";
+        } else if (Ty->isVoidTy()) {
+            name = "void";
+        } else if (Ty->isArrayTy()) {
+            name = "arr[" + this->name(Ty->getArrayElementType()) + ":"
+                   + std::to_string(Ty->getArrayNumElements()) + "]";
+        } else if (Ty->isVectorTy()) {
+            name = "vec[" + this->name(Ty->getScalarType()) + ":"
+                   + std::to_string(((llvm::VectorType *) Ty)->getElementCount().getKnownMinValue()) + "]";
+        } else if (Ty->isPointerTy()) {
+            name = this->name(Ty->getPointerElementType()) + "*";
+        } else if (Ty->isStructTy()) {
+            StructDef *sd = findStructDef(Ty);
+            name = sd ? sd->id + "{" : "AnonymousObj{";
+            for (unsigned i = 0; i < Ty->getStructNumElements(); i++) {
+                if (i != 0) {
+                    name += ",";
+                }
+                name += this->name(Ty->getStructElementType(i));
+            }
+            name += "}";
+        } else {
+            name = "unnamedType";
+        }
+
+        // names of element types may have grown descs, desc is still valid
+        desc.name = name;
+        return desc.name;
+    }
+
+    /**
+     * @description:    drop all descriptors, only "default" is left
+     * @return:         none
+     */
+    void TypeTable::clear() {
+        this->descs.clear();
+        this->index.clear();
+        this->descs.emplace_back(0, nullptr, 0);
+        this->descs.back().name = "default";
+        this->index[nullptr] = 0;
+    }
+}